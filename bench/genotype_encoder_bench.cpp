@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+//Benchmark of the per-type kernels of genotype_encoder.h against the per-sample loop of bcf2binary they
+//replaced [type tested for every sample]. Outputs of both are first compared on random records, then each
+//record type is timed on a record of rare variants.
+//
+//	make bench && bin/bench_genotype_encoder [#samples] [#iterations]
+
+#define _DECLARE_TOOLBOX_HERE
+#include <utils/otools.h>
+#include <utils/bitvector.h>
+#include <modes/genotype_encoder.h>
+
+using namespace std;
+
+//PER-SAMPLE LOOP OF BCF2BINARY BEFORE THE KERNELS [missing data check of phased types left out]
+uint32_t encode_loop(int32_t target_type, const int32_t * input_buffer, const float * probs, uint32_t nsamples, bool minor, int32_t * sparse, float * sparse_probs, bitvector & binary) {
+	uint32_t n_sparse = 0;
+	for (uint32_t i = 0 ; i < nsamples ; i++) {
+		bool a0 = (bcf_gt_allele(input_buffer[2*i+0])==1);
+		bool a1 = (bcf_gt_allele(input_buffer[2*i+1])==1);
+		bool mi = (input_buffer[2*i+0] == bcf_gt_missing || input_buffer[2*i+1] == bcf_gt_missing);
+		bool phased = (bcf_gt_is_phased(input_buffer[2*i+0]) || bcf_gt_is_phased(input_buffer[2*i+1])) && !mi;
+
+		if (target_type == RECORD_SPARSE_PHASEPROBS) {
+			if (a0 == minor || a1 == minor || mi) {
+				sparse_probs[n_sparse] = probs[i];
+				sparse[n_sparse++] = sparse_genotype::pack(i, (a0!=a1), mi, a0, a1, phased);
+			}
+		}
+
+		if (target_type == RECORD_SPARSE_GENOTYPE) {
+			if (a0 == minor || a1 == minor || mi) sparse[n_sparse++] = sparse_genotype::pack(i, (a0!=a1), mi, a0, a1, phased);
+		}
+
+		if (target_type == RECORD_SPARSE_HAPLOTYPE) {
+			if (a0 == minor) sparse[n_sparse++] = 2*i+0;
+			if (a1 == minor) sparse[n_sparse++] = 2*i+1;
+		}
+
+		if (target_type == RECORD_BINARY_HAPLOTYPE) {
+			binary.set(2*i+0, a0);
+			binary.set(2*i+1, a1);
+		}
+
+		if (target_type == RECORD_BINARY_GENOTYPE) {
+			if (mi) { binary.set(2*i+0, true); binary.set(2*i+1, false); }
+			else if (a0 == a1) { binary.set(2*i+0, a0); binary.set(2*i+1, a1); }
+			else { binary.set(2*i+0, false); binary.set(2*i+1, true); }
+		}
+	}
+	return n_sparse;
+}
+
+//KERNEL OF [target_type], dispatched once per record as in bcf2binary
+uint32_t encode_kernel(int32_t target_type, const int32_t * gt, const float * probs, uint32_t n, bool minor, int32_t * sparse, float * sparse_probs, bitvector & binary) {
+	switch (target_type) {
+	case RECORD_SPARSE_PHASEPROBS: return genotype_encoder::encode < RECORD_SPARSE_PHASEPROBS > (gt, probs, n, minor, sparse, sparse_probs, NULL).n_sparse;
+	case RECORD_SPARSE_GENOTYPE: return genotype_encoder::encode < RECORD_SPARSE_GENOTYPE > (gt, probs, n, minor, sparse, NULL, NULL).n_sparse;
+	case RECORD_SPARSE_HAPLOTYPE: return genotype_encoder::encode < RECORD_SPARSE_HAPLOTYPE > (gt, probs, n, minor, sparse, NULL, NULL).n_sparse;
+	case RECORD_BINARY_HAPLOTYPE: return genotype_encoder::encode < RECORD_BINARY_HAPLOTYPE > (gt, probs, n, minor, NULL, NULL, binary.bytes).n_sparse;
+	default: return genotype_encoder::encode < RECORD_BINARY_GENOTYPE > (gt, probs, n, minor, NULL, NULL, binary.bytes).n_sparse;
+	}
+}
+
+int main(int argc, char ** argv) {
+	const uint32_t nsamples = (argc > 1) ? atoi(argv[1]) : 100000;
+	const uint32_t niterations = (argc > 2) ? atoi(argv[2]) : 200;
+	const vector < int32_t > types = { RECORD_SPARSE_PHASEPROBS, RECORD_SPARSE_GENOTYPE, RECORD_SPARSE_HAPLOTYPE, RECORD_BINARY_HAPLOTYPE, RECORD_BINARY_GENOTYPE };
+	const vector < string > names = { "sparse/phaseprobs", "sparse/genotype", "sparse/haplotype", "binary/haplotype", "binary/genotype" };
+	rng.setSeed(15052011);
+
+	//Same outputs on random records [missing, phased and unphased alleles]
+	uint32_t n_errors = 0;
+	for (uint32_t n : { 1, 2, 3, 5, 17, 100, 1001 }) for (uint32_t r = 0 ; r < 50 ; r ++) for (int32_t type : types) for (bool minor : { false, true }) {
+		vector < int32_t > gt (2 * n), sparse0 (2 * n), sparse1 (2 * n);
+		vector < float > probs (n), probs0 (2 * n), probs1 (2 * n);
+		bitvector binary0 (2 * n), binary1 (2 * n);
+		for (uint32_t k = 0 ; k < 2 * n ; k ++) {
+			const int v = rng.getInt(5);
+			gt[k] = (v == 4) ? bcf_gt_missing : ((v >= 2) ? bcf_gt_phased(v - 2) : bcf_gt_unphased(v));
+		}
+		for (uint32_t i = 0 ; i < n ; i ++) probs[i] = rng.getDouble();
+		const uint32_t n0 = encode_loop(type, gt.data(), probs.data(), n, minor, sparse0.data(), probs0.data(), binary0);
+		const uint32_t n1 = encode_kernel(type, gt.data(), probs.data(), n, minor, sparse1.data(), probs1.data(), binary1);
+		bool same = (n0 == n1) && equal(sparse0.begin(), sparse0.begin() + n0, sparse1.begin()) && !memcmp(binary0.bytes, binary1.bytes, binary0.n_bytes);
+		if (type == RECORD_SPARSE_PHASEPROBS) same = same && equal(probs0.begin(), probs0.begin() + n0, probs1.begin());
+		n_errors += !same;
+	}
+	cout << "Kernels vs loop on random records: " << (n_errors ? (stb.str(n_errors) + " mismatches") : "identical") << endl;
+
+	//Throughput on a record with 3% of carriers of the minor allele
+	vector < int32_t > gt (2 * nsamples), sparse (2 * nsamples);
+	vector < float > probs (nsamples, 0.5f), sparse_probs (2 * nsamples);
+	bitvector binary (2 * nsamples);
+	for (uint32_t k = 0 ; k < 2 * nsamples ; k ++) gt[k] = bcf_gt_unphased(rng.getInt(100) < 3);
+	for (uint32_t t = 0 ; t < types.size() ; t ++) {
+		uint64_t checksum = 0;
+		auto t0 = chrono::steady_clock::now();
+		for (uint32_t r = 0 ; r < niterations ; r ++) checksum += encode_loop(types[t], gt.data(), probs.data(), nsamples, true, sparse.data(), sparse_probs.data(), binary);
+		auto t1 = chrono::steady_clock::now();
+		for (uint32_t r = 0 ; r < niterations ; r ++) checksum += encode_kernel(types[t], gt.data(), probs.data(), nsamples, true, sparse.data(), sparse_probs.data(), binary);
+		auto t2 = chrono::steady_clock::now();
+		const double s_loop = chrono::duration < double > (t1 - t0).count(), s_kernel = chrono::duration < double > (t2 - t1).count();
+		cout << names[t] << "\tloop " << stb.str(niterations * 1e-6 * nsamples / s_loop, 1) << " Msamples/s\tkernel " << stb.str(niterations * 1e-6 * nsamples / s_kernel, 1) << " Msamples/s\tx" << stb.str(s_loop / s_kernel, 2) << "\t[" << checksum << "]" << endl;
+	}
+	return n_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
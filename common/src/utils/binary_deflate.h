@@ -0,0 +1,269 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _BINARY_DEFLATE_H
+#define _BINARY_DEFLATE_H
+
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libdeflate.h>
+
+#include "otools.h"
+
+#define BINZ_MAGIC			"XCFBINZ1"			//Last 8 bytes of block compressed binary files
+#define BINZ_BLOCK_SIZE		(1024*1024)			//Target of uncompressed bytes per block
+#define BINZ_LEVEL			6					//libdeflate compression level
+#define BINZ_MAX_BLOCK		0x40000000			//Uncompressed blocks have to fit the 30 bits in-block offset of SEEK
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_DEFLATE								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Block compressed binary file. Records are grouped in blocks of ~BINZ_BLOCK_SIZE uncompressed bytes, each
+//block being compressed independently with raw deflate. Records never span two blocks.
+//
+//	[Blocks]	compressed block 0 | compressed block 1 | ...
+//	[Index]		for each block: file offset (u64) | compressed size (u32) | uncompressed size (u32)
+//	[Footer]	n_blocks (u64) | index offset (u64) | magic (8 bytes)
+//
+//SEEK of a record is virtual: block number * MOD30BITS + offset in the uncompressed block, so that the two
+//30 bits integers of INFO/SEEK hold the block number and the in-block offset. Region queries only
+//decompress the blocks they touch.
+
+namespace binary_deflate
+{
+	//CHECK THE FOOTER OF A BINARY FILE
+	inline bool isCompressed(std::string fname) {
+		std::ifstream fd (fname.c_str(), std::ios::in | std::ios::binary);
+		if (!fd) return false;
+		fd.seekg(0, fd.end);
+		if ((uint64_t)fd.tellg() < 24) return false;
+		char magic[8];
+		fd.seekg(-8, fd.end);
+		fd.read(magic, 8);
+		return fd && !memcmp(magic, BINZ_MAGIC, 8);
+	}
+}
+
+class binary_deflate_writer {
+public:
+	uint32_t nthreads;
+	uint64_t block_id;							//Number of the block being filled
+	std::vector < char > block;					//Block being filled
+	std::vector < std::vector < char > > pending;	//Blocks waiting for compression
+	std::vector < std::vector < char > > ready;	//Compressed output to be written, in order
+	std::vector < libdeflate_compressor * > compressors;
+
+	//Index
+	uint64_t offset;							//Compressed bytes produced so far
+	std::vector < uint64_t > idx_offset;
+	std::vector < uint32_t > idx_csize;
+	std::vector < uint32_t > idx_rsize;
+
+	//Statistics
+	uint64_t bytes_in;
+
+	binary_deflate_writer() : nthreads(1), block_id(0), offset(0), bytes_in(0) {
+	}
+
+	~binary_deflate_writer() {
+		for (uint32_t t = 0 ; t < compressors.size() ; t ++) libdeflate_free_compressor(compressors[t]);
+	}
+
+	bool isOpen() const {
+		return !compressors.empty();
+	}
+
+	void open(uint32_t _nthreads) {
+		nthreads = std::max(1u, _nthreads);
+		for (uint32_t t = 0 ; t < nthreads ; t ++) compressors.push_back(libdeflate_alloc_compressor(BINZ_LEVEL));
+		block.reserve(BINZ_BLOCK_SIZE);
+	}
+
+	//VIRTUAL SEEK THE NEXT RECORD OF [nbytes] WILL GET
+	uint64_t tell(uint32_t nbytes) const {
+		if (!block.empty() && block.size() + nbytes > BINZ_BLOCK_SIZE) return (block_id + 1) * MOD30BITS;
+		return block_id * MOD30BITS + block.size();
+	}
+
+	//ADD A RECORD / Returns its virtual SEEK
+	uint64_t push(const char * buffer, uint32_t nbytes) {
+		if (nbytes >= BINZ_MAX_BLOCK) vrb.error("Binary record too large for a compressed block");
+		if (!block.empty() && block.size() + nbytes > BINZ_BLOCK_SIZE) cut();
+		uint64_t seek = tell(nbytes);
+		block.insert(block.end(), buffer, buffer + nbytes);
+		bytes_in += nbytes;
+		return seek;
+	}
+
+	//CLOSE THE CURRENT BLOCK, COMPRESS PENDING BLOCKS ONCE THERE IS ONE PER THREAD
+	void cut() {
+		if (block.empty()) return;
+		pending.push_back(std::move(block));
+		block = std::vector < char > ();
+		block.reserve(BINZ_BLOCK_SIZE);
+		block_id ++;
+		if (pending.size() >= nthreads) compress();
+	}
+
+	void compressOne(uint32_t t, std::vector < char > & raw, std::vector < char > & out) {
+		out.resize(libdeflate_deflate_compress_bound(compressors[t], raw.size()));
+		size_t n = libdeflate_deflate_compress(compressors[t], raw.data(), raw.size(), out.data(), out.size());
+		if (n == 0) vrb.error("Compression of binary block failed");
+		out.resize(n);
+	}
+
+	//COMPRESS PENDING BLOCKS IN PARALLEL, APPEND THEM TO THE OUTPUT IN ORDER
+	void compress() {
+		uint32_t n = pending.size(), first = ready.size();
+		ready.resize(first + n);
+		if (n == 1) compressOne(0, pending[0], ready[first]);
+		else {
+			std::vector < std::thread > workers;
+			for (uint32_t t = 0 ; t < n ; t ++) workers.emplace_back(&binary_deflate_writer::compressOne, this, t, std::ref(pending[t]), std::ref(ready[first + t]));
+			for (uint32_t t = 0 ; t < n ; t ++) workers[t].join();
+		}
+		for (uint32_t b = 0 ; b < n ; b ++) {
+			idx_offset.push_back(offset);
+			idx_csize.push_back(ready[first + b].size());
+			idx_rsize.push_back(pending[b].size());
+			offset += ready[first + b].size();
+		}
+		pending.clear();
+	}
+
+	//FLUSH ALL BLOCKS AND APPEND INDEX AND FOOTER TO THE OUTPUT
+	void finish() {
+		cut();
+		if (!pending.empty()) compress();
+		std::vector < char > tail;
+		auto put = [&](const void * src, size_t n) { tail.insert(tail.end(), (const char *)src, (const char *)src + n); };
+		uint64_t n_blocks = idx_offset.size(), idx_start = offset;
+		for (uint64_t b = 0 ; b < n_blocks ; b ++) {
+			put(&idx_offset[b], sizeof(uint64_t));
+			put(&idx_csize[b], sizeof(uint32_t));
+			put(&idx_rsize[b], sizeof(uint32_t));
+		}
+		put(&n_blocks, sizeof(uint64_t));
+		put(&idx_start, sizeof(uint64_t));
+		put(BINZ_MAGIC, 8);
+		offset += tail.size();
+		ready.push_back(std::move(tail));
+	}
+};
+
+class binary_deflate_reader {
+public:
+	int fd;
+	libdeflate_decompressor * decompressor;
+	std::vector < uint64_t > idx_offset;
+	std::vector < uint32_t > idx_csize;
+	std::vector < uint32_t > idx_rsize;
+
+	//Last decompressed block
+	int64_t cached;
+	std::vector < char > raw;
+	std::vector < char > compressed;
+
+	//Statistics
+	uint64_t n_inflated;
+
+	binary_deflate_reader() : fd(-1), decompressor(NULL), cached(-1), n_inflated(0) {
+	}
+
+	~binary_deflate_reader() {
+		close();
+	}
+
+	bool readFully(char * dst, uint64_t off, uint64_t len) {
+		while (len > 0) {
+			ssize_t n = pread(fd, dst, len, off);
+			if (n <= 0) return false;
+			dst += n; off += n; len -= n;
+		}
+		return true;
+	}
+
+	//OPEN AND LOAD THE BLOCK INDEX / Returns false if the file is not a compressed binary file
+	bool open(std::string fname) {
+		fd = ::open(fname.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size < 24) return false;
+		char footer[24];
+		if (!readFully(footer, st.st_size - 24, 24) || memcmp(footer + 16, BINZ_MAGIC, 8)) return false;
+		uint64_t n_blocks, idx_start;
+		memcpy(&n_blocks, footer, sizeof(uint64_t));
+		memcpy(&idx_start, footer + 8, sizeof(uint64_t));
+		std::vector < char > idx (n_blocks * 16);
+		if (!readFully(idx.data(), idx_start, idx.size())) return false;
+		idx_offset.resize(n_blocks);
+		idx_csize.resize(n_blocks);
+		idx_rsize.resize(n_blocks);
+		for (uint64_t b = 0 ; b < n_blocks ; b ++) {
+			memcpy(&idx_offset[b], idx.data() + 16 * b, sizeof(uint64_t));
+			memcpy(&idx_csize[b], idx.data() + 16 * b + 8, sizeof(uint32_t));
+			memcpy(&idx_rsize[b], idx.data() + 16 * b + 12, sizeof(uint32_t));
+		}
+		decompressor = libdeflate_alloc_decompressor();
+		return decompressor != NULL;
+	}
+
+	//VIEW ON RECORD AT VIRTUAL [seek] / NULL if the record cannot be read
+	//The pointer is valid until the next call.
+	const char * view(uint64_t seek, uint64_t nbytes) {
+		static const char empty = 0;
+		if (nbytes == 0) return &empty;
+		uint64_t b = seek / MOD30BITS, off = seek % MOD30BITS;
+		if (b >= idx_offset.size() || off + nbytes > idx_rsize[b]) return NULL;
+		if ((int64_t)b != cached) {
+			compressed.resize(idx_csize[b]);
+			raw.resize(idx_rsize[b]);
+			size_t n = 0;
+			if (!readFully(compressed.data(), idx_offset[b], idx_csize[b])) return NULL;
+			if (libdeflate_deflate_decompress(decompressor, compressed.data(), idx_csize[b], raw.data(), idx_rsize[b], &n) != LIBDEFLATE_SUCCESS || n != idx_rsize[b]) return NULL;
+			cached = b;
+			n_inflated ++;
+		}
+		return raw.data() + off;
+	}
+
+	void close() {
+		if (decompressor) libdeflate_free_decompressor(decompressor);
+		if (fd >= 0) ::close(fd);
+		decompressor = NULL;
+		fd = -1;
+		cached = -1;
+	}
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _BINARY_INDEX_H
+#define _BINARY_INDEX_H
+
+#include <fstream>
+#include <cstring>
+
+#include "otools.h"
+
+#define BINIDX_MAGIC		"XCFBIDX1"			//Magic string of .bin.idx files
+#define BINIDX_VERSION		1
+#define BINIDX_BLOCK_SIZE	65536				//Number of variants per block
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_INDEX								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Sidecar of a binary file (.bin.idx) holding per-variant metadata as packed little-endian columns.
+//
+//	[Header]	magic (8 bytes) | version (u32) | block size (u32)
+//	[Blocks]	n (u32) | rid (i32 x n) | pos (u32 x n) | seek (u64 x n) | size (u32 x n) | AC (u32 x n) | AN (u32 x n) | type (u8 x n)
+//	[Footer]	n_contigs (u32) | for each contig: length (u32), name | n_variants (u64) | n_blocks (u64) | footer offset (u64)
+//
+//Blocks store columns contiguously so that a scan only touching a few columns reads them as flat arrays.
+//Contig IDs [rid] refer to the contig table of the footer, which follows the order of the BCF header.
+
+namespace binary_index
+{
+	inline bool little_endian() {
+		return (std::endian::native == std::endian::little);
+	}
+
+	inline std::string filename(std::string bin_fname) {
+		return bin_fname + ".idx";
+	}
+}
+
+class binary_index_writer {
+public:
+	std::ofstream fd;
+	std::string fname;
+	uint64_t n_variants;
+	uint64_t n_blocks;
+
+	//Columns of the current block
+	std::vector < int32_t > rid;
+	std::vector < uint32_t > pos;
+	std::vector < uint64_t > seek;
+	std::vector < uint32_t > size;
+	std::vector < uint32_t > AC;
+	std::vector < uint32_t > AN;
+	std::vector < uint8_t > type;
+
+	binary_index_writer() : n_variants(0), n_blocks(0) {
+	}
+
+	~binary_index_writer() {
+	}
+
+	bool open(std::string _fname) {
+		if (!binary_index::little_endian()) return false;
+		fname = _fname;
+		fd.open(fname.c_str(), std::ios::out | std::ios::binary);
+		if (!fd) return false;
+		uint32_t version = BINIDX_VERSION, block_size = BINIDX_BLOCK_SIZE;
+		fd.write(BINIDX_MAGIC, 8);
+		fd.write((char*)&version, sizeof(uint32_t));
+		fd.write((char*)&block_size, sizeof(uint32_t));
+		return true;
+	}
+
+	bool isOpen() const {
+		return fd.is_open();
+	}
+
+	void push(int32_t _rid, uint32_t _pos, uint64_t _seek, uint32_t _size, uint32_t _AC, uint32_t _AN, uint8_t _type) {
+		rid.push_back(_rid);
+		pos.push_back(_pos);
+		seek.push_back(_seek);
+		size.push_back(_size);
+		AC.push_back(_AC);
+		AN.push_back(_AN);
+		type.push_back(_type);
+		n_variants ++;
+		if (rid.size() == BINIDX_BLOCK_SIZE) flush();
+	}
+
+	template < class T >
+	void writeColumn(const std::vector < T > & col) {
+		fd.write((const char*)col.data(), col.size() * sizeof(T));
+	}
+
+	void flush() {
+		uint32_t n = rid.size();
+		if (n == 0) return;
+		fd.write((char*)&n, sizeof(uint32_t));
+		writeColumn(rid); writeColumn(pos); writeColumn(seek); writeColumn(size); writeColumn(AC); writeColumn(AN); writeColumn(type);
+		rid.clear(); pos.clear(); seek.clear(); size.clear(); AC.clear(); AN.clear(); type.clear();
+		n_blocks ++;
+	}
+
+	//Write remaining variants and the footer with contig names
+	bool close(const std::vector < std::string > & contigs) {
+		flush();
+		uint64_t footer = fd.tellp();
+		uint32_t zero = 0, n_contigs = contigs.size();
+		fd.write((char*)&zero, sizeof(uint32_t));					//Empty block marks the end of blocks
+		fd.write((char*)&n_contigs, sizeof(uint32_t));
+		for (uint32_t c = 0 ; c < n_contigs ; c ++) {
+			uint32_t len = contigs[c].size();
+			fd.write((char*)&len, sizeof(uint32_t));
+			fd.write(contigs[c].c_str(), len);
+		}
+		fd.write((char*)&n_variants, sizeof(uint64_t));
+		fd.write((char*)&n_blocks, sizeof(uint64_t));
+		fd.write((char*)&footer, sizeof(uint64_t));
+		bool ok = fd.good();
+		fd.close();
+		return ok;
+	}
+};
+
+#endif
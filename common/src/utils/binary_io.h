@@ -0,0 +1,535 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _BINARY_IO_H
+#define _BINARY_IO_H
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef __LIBURING__
+#include <liburing.h>
+#endif
+
+#include "otools.h"
+
+#define BINIO_STREAM	0					//Binary records read with std::ifstream (seekg + read)
+#define BINIO_MMAP		1					//Binary file memory mapped / records served as views in the mapping
+#define BINIO_PREFETCH	2					//Binary file read ahead by a background thread into a ring of chunks
+#define BINIO_BLOCK		3					//Binary file read in large aligned blocks, records served from the block
+#define BINIO_DIRECT	4					//Same as BINIO_BLOCK, bypassing the page cache with O_DIRECT
+#define BINIO_URING		5					//Positional reads batched across files with io_uring [pread without __LIBURING__]
+
+#define PREFETCH_CHUNK_SIZE		(4*1024*1024)	//Bytes per read-ahead chunk
+#define PREFETCH_CHUNK_NUMBER	8				//Chunks in the ring / read-ahead window of 32Mb per file
+
+#define BLOCK_ALIGN				4096			//Alignment of block offsets, lengths and buffers [O_DIRECT requirement]
+#define BLOCK_SIZE_DEFAULT		16				//Block size in Mb
+
+#define URING_DEPTH				64				//Submission queue entries
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_IO									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+namespace binary_io
+{
+	//Block size in Mb used by BINIO_BLOCK and BINIO_DIRECT [set with "block:N" or "direct:N"]
+	inline uint32_t block_size = BLOCK_SIZE_DEFAULT;
+
+	//PARSE THE --bin-io COMMAND LINE VALUE
+	inline int32_t parse_mode(std::string mode) {
+		if (mode == "stream") return BINIO_STREAM;
+		if (mode == "mmap") return BINIO_MMAP;
+		if (mode == "prefetch") return BINIO_PREFETCH;
+		if (mode == "uring") return BINIO_URING;
+		size_t colon = mode.find(':');
+		std::string name = mode.substr(0, colon);
+		if (name != "block" && name != "direct") return -1;
+		if (colon != std::string::npos) {
+			std::string mb = mode.substr(colon + 1);
+			if (mb.empty() || mb.size() > 4 || mb.find_first_not_of("0123456789") != std::string::npos) return -1;
+			block_size = std::stoul(mb);
+			if (block_size == 0) return -1;
+		}
+		return (name == "block") ? BINIO_BLOCK : BINIO_DIRECT;
+	}
+
+	inline std::string name_mode(int32_t mode) {
+		switch (mode) {
+		case BINIO_STREAM: return "stream";
+		case BINIO_MMAP: return "mmap";
+		case BINIO_PREFETCH: return "prefetch";
+		case BINIO_BLOCK: return "block / " + std::to_string(block_size) + "Mb";
+		case BINIO_DIRECT: return "direct / " + std::to_string(block_size) + "Mb";
+#ifdef __LIBURING__
+		case BINIO_URING: return "uring";
+#else
+		case BINIO_URING: return "uring / pread fallback";
+#endif
+		}
+		return "unknown";
+	}
+}
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_MMAP									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Read-only mapping of a whole binary file. Records are accessed as [seek, seek+size) views.
+class binary_mmap {
+public:
+	int fd;
+	char * data;
+	uint64_t size;
+
+	binary_mmap() : fd(-1), data(NULL), size(0) {
+	}
+
+	~binary_mmap() {
+	}
+
+	//OPEN AND MAP THE FILE / Returns false if the file cannot be opened or mapped
+	bool open(std::string fname, bool sequential) {
+		fd = ::open(fname.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0) { ::close(fd); fd = -1; return false; }
+		size = st.st_size;
+		//Empty binary files (e.g. no variant) cannot be mapped but are still valid
+		if (size == 0) { data = NULL; return true; }
+		void * ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) { ::close(fd); fd = -1; size = 0; return false; }
+		data = (char*)ptr;
+		advise(sequential);
+		return true;
+	}
+
+	//TELL THE KERNEL HOW THE MAPPING IS GOING TO BE ACCESSED
+	//	sequential=true : full file scan, aggressive read-ahead
+	//	sequential=false: region queries and jumps, no read-ahead beyond the touched pages
+	void advise(bool sequential) {
+		if (data == NULL) return;
+		madvise(data, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+	}
+
+	//VIEW INTO THE MAPPING / NULL if the record lies outside the file
+	inline const char * view(uint64_t seek, uint32_t nbytes) const {
+		if (seek + nbytes > size) return NULL;
+		return data + seek;
+	}
+
+	void close() {
+		if (data != NULL) munmap(data, size);
+		if (fd >= 0) ::close(fd);
+		data = NULL;
+		fd = -1;
+		size = 0;
+	}
+};
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_PREFETCH								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Read-ahead of a binary file by a background thread.
+//Records of a sorted XCF are laid out contiguously in the binary file, so reading the bytes that follow
+//the current record is the same as fetching the next records. The file is cut in chunks of [chunk_size]
+//bytes starting at [start]; chunk number [seq] lives in slot [seq % nchunks] of the ring. The worker keeps
+//the window [head, head + nchunks) filled, the consumer moves [head] forward as it reads records.
+//Backward or far jumps restart the window at the requested record.
+class binary_prefetch {
+public:
+	int fd;
+	uint64_t size;
+	uint32_t chunk_size;
+	uint32_t nchunks;
+
+	//Ring of chunks
+	std::vector < std::vector < char > > chunks;
+	uint64_t start;								//File offset of chunk 0 in current window
+	uint64_t head;								//Oldest chunk still needed by the consumer
+	uint64_t filled;							//Chunks [0, filled) are ready
+	uint64_t generation;						//Incremented at each restart, invalidates in-flight reads
+	bool stop;
+
+	//Records spanning two chunks or larger than the window
+	std::vector < char > record;
+
+	//Worker
+	std::thread worker;
+	std::mutex mtx;
+	std::condition_variable cv_work;
+	std::condition_variable cv_ready;
+
+	//Statistics
+	uint64_t n_stalls;
+	uint64_t n_restarts;
+
+	binary_prefetch() : fd(-1), size(0), chunk_size(PREFETCH_CHUNK_SIZE), nchunks(PREFETCH_CHUNK_NUMBER), start(0), head(0), filled(0), generation(0), stop(false), n_stalls(0), n_restarts(0) {
+	}
+
+	~binary_prefetch() {
+		close();
+	}
+
+	bool open(std::string fname) {
+		fd = ::open(fname.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0) { ::close(fd); fd = -1; return false; }
+		size = st.st_size;
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		chunks = std::vector < std::vector < char > > (nchunks, std::vector < char > (chunk_size));
+		stop = false;
+		worker = std::thread(&binary_prefetch::run, this);
+		return true;
+	}
+
+	//BACKGROUND LOOP: fill the next missing chunk of the window
+	void run() {
+		std::unique_lock < std::mutex > lock(mtx);
+		while (!stop) {
+			uint64_t offset = start + filled * chunk_size;
+			if (filled < head + nchunks && offset < size) {
+				uint64_t seq = filled, gen = generation;
+				uint32_t len = std::min((uint64_t)chunk_size, size - offset);
+				char * dst = chunks[seq % nchunks].data();
+				lock.unlock();
+				bool ok = readFully(dst, offset, len);
+				lock.lock();
+				if (gen == generation) {
+					if (!ok) { stop = true; cv_ready.notify_all(); break; }
+					filled = seq + 1;
+					cv_ready.notify_all();
+				}
+			} else cv_work.wait(lock);
+		}
+	}
+
+	bool readFully(char * dst, uint64_t offset, uint64_t len) {
+		while (len > 0) {
+			ssize_t n = pread(fd, dst, len, offset);
+			if (n <= 0) return false;
+			dst += n; offset += n; len -= n;
+		}
+		return true;
+	}
+
+	//VIEW ON RECORD [seek, seek+nbytes) / NULL if the record cannot be read
+	//The pointer is valid until the next call.
+	const char * view(uint64_t seek, uint32_t nbytes) {
+		if (seek + nbytes > size) return NULL;
+		//Empty record, nothing to wait for
+		static const char empty = 0;
+		if (nbytes == 0) return &empty;
+
+		//Records larger than the window are read directly
+		if (nbytes > (uint64_t)(nchunks - 1) * chunk_size) {
+			if (record.size() < nbytes) record.resize(nbytes);
+			return readFully(record.data(), seek, nbytes) ? record.data() : NULL;
+		}
+
+		std::unique_lock < std::mutex > lock(mtx);
+		if (stop) return NULL;
+
+		//Restart the window on backward or far jumps
+		if (seek < start || (seek - start) / chunk_size < head || (seek - start) / chunk_size >= head + nchunks) {
+			start = seek;
+			head = filled = 0;
+			generation++;
+			n_restarts++;
+		}
+
+		//Release chunks before the record and wake up the worker
+		uint64_t seq_first = (seek - start) / chunk_size;
+		uint64_t seq_last = (seek + nbytes - 1 - start) / chunk_size;
+		if (seq_first != head || filled == 0) { head = seq_first; cv_work.notify_one(); }
+
+		//Wait for the chunks holding the record
+		if (filled <= seq_last) {
+			n_stalls++;
+			cv_ready.wait(lock, [&] { return stop || filled > seq_last; });
+			if (stop) return NULL;
+		}
+
+		//Record in a single chunk, no copy
+		uint64_t off_first = (seek - start) % chunk_size;
+		if (seq_first == seq_last) return chunks[seq_first % nchunks].data() + off_first;
+
+		//Record spanning chunks, assemble it
+		if (record.size() < nbytes) record.resize(nbytes);
+		for (uint64_t seq = seq_first, done = 0 ; seq <= seq_last ; seq ++) {
+			uint64_t off = (seq == seq_first) ? off_first : 0;
+			uint64_t len = std::min((uint64_t)chunk_size - off, nbytes - done);
+			memcpy(record.data() + done, chunks[seq % nchunks].data() + off, len);
+			done += len;
+		}
+		return record.data();
+	}
+
+	void close() {
+		if (worker.joinable()) {
+			{
+				std::lock_guard < std::mutex > lock(mtx);
+				stop = true;
+			}
+			cv_work.notify_all();
+			worker.join();
+		}
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+		size = 0;
+		chunks.clear();
+	}
+};
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_BLOCK								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Synchronous reads of a binary file in large aligned blocks, for filesystems where small reads are
+//expensive (e.g. Lustre, GPFS). A record inside the current block is served from it; otherwise the block
+//is reloaded at the record, which covers sequential scans as well as backward or far jumps. Records
+//larger than a block are read on their own. With O_DIRECT, offsets, lengths and buffers are aligned.
+class binary_block {
+public:
+	int fd;
+	uint64_t size;
+	uint64_t block_size;
+	bool direct;
+
+	char * buffer;								//Current block
+	uint64_t buffer_start;						//File offset of the current block
+	uint64_t buffer_length;						//Valid bytes in the current block
+	char * large;								//Records larger than a block
+	uint64_t large_capacity;
+
+	//Statistics
+	uint64_t bytes_read;						//Read from the file
+	uint64_t bytes_used;						//Served as records
+	uint64_t n_blocks;							//Block loads
+
+	binary_block() : fd(-1), size(0), block_size(0), direct(false), buffer(NULL), buffer_start(0), buffer_length(0), large(NULL), large_capacity(0), bytes_read(0), bytes_used(0), n_blocks(0) {
+	}
+
+	~binary_block() {
+	}
+
+	static uint64_t alignUp(uint64_t n) {
+		return (n + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+	}
+
+	//OPEN THE FILE / [_direct] is dropped when the filesystem does not support O_DIRECT
+	bool open(std::string fname, uint64_t _block_size, bool _direct) {
+		block_size = alignUp(_block_size);
+		direct = _direct;
+#ifdef O_DIRECT
+		if (direct) fd = ::open(fname.c_str(), O_RDONLY | O_DIRECT);
+		if (fd < 0)
+#endif
+		{
+			direct = false;
+			fd = ::open(fname.c_str(), O_RDONLY);
+		}
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0) { ::close(fd); fd = -1; return false; }
+		size = st.st_size;
+		if (!direct) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		if (posix_memalign((void**)&buffer, BLOCK_ALIGN, block_size)) { buffer = NULL; ::close(fd); fd = -1; return false; }
+		buffer_start = buffer_length = 0;
+		return true;
+	}
+
+	//READ [len] BYTES AT [offset] [both aligned] / Returns the number of bytes read, short at the end of the file
+	int64_t readAligned(char * dst, uint64_t offset, uint64_t len) {
+		uint64_t done = 0;
+		while (done < len) {
+			ssize_t n = pread(fd, dst + done, len - done, offset + done);
+			if (n < 0) return -1;
+			if (n == 0) break;
+			done += n;
+		}
+		bytes_read += done;
+		return done;
+	}
+
+	//VIEW ON RECORD [seek, seek+nbytes) / NULL if the record cannot be read
+	//The pointer is valid until the next call.
+	const char * view(uint64_t seek, uint64_t nbytes) {
+		if (seek + nbytes > size) return NULL;
+		static const char empty = 0;
+		if (nbytes == 0) return &empty;
+		bytes_used += nbytes;
+
+		//Record in current block
+		if (seek >= buffer_start && seek + nbytes <= buffer_start + buffer_length) return buffer + (seek - buffer_start);
+
+		//Record larger than a block
+		uint64_t offset = seek / BLOCK_ALIGN * BLOCK_ALIGN;
+		if (seek + nbytes - offset > block_size) {
+			uint64_t len = alignUp(seek + nbytes) - offset;
+			if (len > large_capacity) {
+				free(large);
+				if (posix_memalign((void**)&large, BLOCK_ALIGN, len)) { large = NULL; large_capacity = 0; return NULL; }
+				large_capacity = len;
+			}
+			int64_t n = readAligned(large, offset, len);
+			if (n < 0 || (uint64_t)n < seek + nbytes - offset) return NULL;
+			return large + (seek - offset);
+		}
+
+		//Load the block starting at the record
+		int64_t n = readAligned(buffer, offset, block_size);
+		if (n < 0 || (uint64_t)n < seek + nbytes - offset) { buffer_length = 0; return NULL; }
+		buffer_start = offset;
+		buffer_length = n;
+		n_blocks ++;
+		return buffer + (seek - offset);
+	}
+
+	void close() {
+		if (fd >= 0) ::close(fd);
+		free(buffer);
+		free(large);
+		fd = -1;
+		size = 0;
+		buffer = large = NULL;
+		buffer_start = buffer_length = large_capacity = 0;
+	}
+};
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						BINARY_URING								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Queue of positional reads, possibly on different files, completed together.
+//With io_uring, all queued reads are submitted in a single system call and run concurrently; otherwise
+//(library not compiled in, or ring setup refused by the kernel) each read is a pread. Short reads are
+//completed with pread in both cases.
+class binary_uring {
+public:
+	struct request {
+		int fd;
+		char * dst;
+		uint64_t offset;
+		uint32_t nbytes;
+	};
+
+	std::vector < request > pending;
+	bool active;								//io_uring ring available
+
+#ifdef __LIBURING__
+	struct io_uring ring;
+#endif
+
+	//Statistics
+	uint64_t n_submits;							//Batches completed
+	uint64_t n_reads;							//Reads completed
+
+	binary_uring() : active(false), n_submits(0), n_reads(0) {
+	}
+
+	~binary_uring() {
+	}
+
+	//SET UP THE RING / Returns false when reads fall back to pread
+	bool open() {
+#ifdef __LIBURING__
+		if (!active) active = (io_uring_queue_init(URING_DEPTH, &ring, 0) == 0);
+#endif
+		return active;
+	}
+
+	inline void push(int fd, char * dst, uint64_t offset, uint32_t nbytes) {
+		if (nbytes > 0) pending.push_back(request { fd, dst, offset, nbytes });
+	}
+
+	//COMPLETE [nbytes] OF REQUEST [r] FROM [done] WITH PREAD
+	static bool finish(const request & r, uint64_t done) {
+		while (done < r.nbytes) {
+			ssize_t n = pread(r.fd, r.dst + done, r.nbytes - done, r.offset + done);
+			if (n <= 0) return false;
+			done += n;
+		}
+		return true;
+	}
+
+	//RUN ALL QUEUED READS / Returns false if one of them failed
+	bool run() {
+		bool ok = true;
+#ifdef __LIBURING__
+		for (uint32_t first = 0 ; active && first < pending.size() ; first += URING_DEPTH) {
+			uint32_t last = std::min((uint32_t)pending.size(), first + URING_DEPTH);
+			for (uint32_t i = first ; i < last ; i ++) {
+				struct io_uring_sqe * sqe = io_uring_get_sqe(&ring);
+				io_uring_prep_read(sqe, pending[i].fd, pending[i].dst, pending[i].nbytes, pending[i].offset);
+				io_uring_sqe_set_data64(sqe, i);
+			}
+			io_uring_submit_and_wait(&ring, last - first);
+			for (uint32_t i = first ; i < last ; i ++) {
+				struct io_uring_cqe * cqe;
+				if (io_uring_wait_cqe(&ring, &cqe) < 0) { ok = false; break; }
+				const request & r = pending[io_uring_cqe_get_data64(cqe)];
+				ok = ok && (cqe->res >= 0) && finish(r, cqe->res);
+				io_uring_cqe_seen(&ring, cqe);
+			}
+		}
+#endif
+		if (!active) for (uint32_t i = 0 ; i < pending.size() ; i ++) ok = ok && finish(pending[i], 0);
+		n_reads += pending.size();
+		n_submits += !pending.empty();
+		pending.clear();
+		return ok;
+	}
+
+	void close() {
+#ifdef __LIBURING__
+		if (active) io_uring_queue_exit(&ring);
+#endif
+		active = false;
+		pending.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _DOSAGE_CODEC_H
+#define _DOSAGE_CODEC_H
+
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "otools.h"
+
+extern "C" {
+	#include <htslib/vcf.h>
+}
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						DOSAGE_CODEC								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Payload of dosage records. Dosages (expected ALT allele count, 0 to 2) are stored in fixed point on
+//8 or 16 bits, the largest code being kept for missing values:
+//
+//	[Header]	u8 bits per value (8 or 16), u8 dosage of unlisted samples (0 or 2), u16 reserved
+//	[Dense]		one value per sample
+//	[Sparse]	u32 count, count u32 sample indexes, count values [samples whose code differs from the
+//				one of the unlisted dosage, missing ones included]
+//
+//Resolution is 1/127 on 8 bits and 1/32767 on 16 bits, so that 0, 1 and 2 are represented exactly.
+//Quantization kernels take the upper bound of the values [range], so that they also serve the
+//probabilities of the phase probability records (see phaseprob_codec.h).
+
+#define DOSAGE_HEADER	4
+#define DOSAGE_RANGE	2.0f
+
+namespace dosage_codec
+{
+	inline uint32_t missing(uint32_t bits) {
+		return (bits == 8) ? 0xFF : 0xFFFF;
+	}
+
+	//CODES PER UNIT [largest non-missing code mapped onto range]
+	inline float scale(uint32_t bits, float range = DOSAGE_RANGE) {
+		return (missing(bits) - 1) / range;
+	}
+
+	inline uint32_t width(uint32_t bits) {
+		return bits / 8;
+	}
+
+	//MAXIMUM NUMBER OF BYTES NEEDED TO ENCODE N DOSAGES [dense scratch area included]
+	inline uint32_t bound(uint32_t n, uint32_t bits) {
+		return DOSAGE_HEADER + sizeof(uint32_t) + n * (sizeof(uint32_t) + 2 * width(bits));
+	}
+
+	inline uint32_t quantize(float x, uint32_t bits, float range = DOSAGE_RANGE) {
+		if (x != x) return missing(bits);
+		return (uint32_t)lrintf(std::min(std::max(x, 0.0f), range) * scale(bits, range));
+	}
+
+#if defined(__AVX2__)
+	//8 DOSAGES TO 32 BITS CODES [NaN, i.e. bcf missing or vector end, to the missing code]
+	inline __m256i quantize8(const float * in, __m256 vs, __m256 vr, __m256i vm) {
+		__m256 x = _mm256_loadu_ps(in);
+		__m256 ok = _mm256_cmp_ps(x, x, _CMP_ORD_Q);
+		x = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), vr), vs);
+		return _mm256_blendv_epi8(vm, _mm256_cvtps_epi32(x), _mm256_castps_si256(ok));
+	}
+#endif
+
+	//QUANTIZE N DOSAGES INTO OUT [n values of bits/8 bytes]
+	inline void quantize(const float * in, uint32_t n, uint32_t bits, void * out, float range = DOSAGE_RANGE) {
+		uint32_t i = 0;
+#if defined(__AVX2__)
+		const __m256 vs = _mm256_set1_ps(scale(bits, range));
+		const __m256 vr = _mm256_set1_ps(range);
+		const __m256i vm = _mm256_set1_epi32(missing(bits));
+		if (bits == 8) {
+			//4x8 codes packed with unsigned saturation, then dwords put back in order across lanes
+			const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+			for (; i + 32 <= n ; i += 32) {
+				__m256i p01 = _mm256_packus_epi32(quantize8(in + i, vs, vr, vm), quantize8(in + i + 8, vs, vr, vm));
+				__m256i p23 = _mm256_packus_epi32(quantize8(in + i + 16, vs, vr, vm), quantize8(in + i + 24, vs, vr, vm));
+				__m256i b = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(p01, p23), order);
+				_mm256_storeu_si256(reinterpret_cast < __m256i * > (static_cast < uint8_t * > (out) + i), b);
+			}
+		} else {
+			for (; i + 16 <= n ; i += 16) {
+				__m256i w = _mm256_packus_epi32(quantize8(in + i, vs, vr, vm), quantize8(in + i + 8, vs, vr, vm));
+				_mm256_storeu_si256(reinterpret_cast < __m256i * > (static_cast < uint16_t * > (out) + i), _mm256_permute4x64_epi64(w, 0xD8));
+			}
+		}
+#endif
+		//Scalar tail
+		if (bits == 8) for (; i < n ; i ++) static_cast < uint8_t * > (out)[i] = quantize(in[i], bits, range);
+		else for (; i < n ; i ++) static_cast < uint16_t * > (out)[i] = quantize(in[i], bits, range);
+	}
+
+	//DEQUANTIZE N CODES INTO OUT [missing code to bcf_float_missing]
+	inline void dequantize(const void * in, uint32_t n, uint32_t bits, float * out, float range = DOSAGE_RANGE) {
+		const float inv = 1.0f / scale(bits, range);
+		const uint32_t mis = missing(bits);
+		uint32_t i = 0;
+#if defined(__AVX2__)
+		const __m256 vinv = _mm256_set1_ps(inv);
+		const __m256i vm = _mm256_set1_epi32(mis);
+		const __m256 vmis = _mm256_castsi256_ps(_mm256_set1_epi32(bcf_float_missing));
+		for (; i + 8 <= n ; i += 8) {
+			__m256i q = (bits == 8) ?
+				_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast < const __m128i * > (static_cast < const uint8_t * > (in) + i))) :
+				_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast < const __m128i * > (static_cast < const uint16_t * > (in) + i)));
+			__m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(q), vinv);
+			_mm256_storeu_ps(out + i, _mm256_blendv_ps(x, vmis, _mm256_castsi256_ps(_mm256_cmpeq_epi32(q, vm))));
+		}
+#endif
+		//Scalar tail
+		for (; i < n ; i ++) {
+			uint32_t q = (bits == 8) ? static_cast < const uint8_t * > (in)[i] : static_cast < const uint16_t * > (in)[i];
+			if (q == mis) bcf_float_set_missing(out[i]);
+			else out[i] = q * inv;
+		}
+	}
+
+	//ENCODE N DOSAGES INTO OUT, RETURNS THE NUMBER OF BYTES USED [major: dosage of unlisted samples when sparse, 0 or 2]
+	inline uint32_t encode(const float * in, uint32_t n, uint32_t bits, bool sparse, uint32_t major, std::vector < char > & out) {
+		const uint32_t w = width(bits);
+		if (out.size() < bound(n, bits)) out.resize(bound(n, bits));
+		out[0] = (char)bits;
+		out[1] = (char)major;
+		out[2] = out[3] = 0;
+		if (!sparse) {
+			quantize(in, n, bits, out.data() + DOSAGE_HEADER);
+			return DOSAGE_HEADER + n * w;
+		}
+
+		//Dense codes in the scratch area at the end of the buffer, listed ones moved to the front
+		char * dense = out.data() + bound(n, bits) - n * w;
+		quantize(in, n, bits, dense);
+		const uint32_t def = major * (uint32_t)scale(bits);
+		uint32_t count = 0;
+		for (uint32_t i = 0 ; i < n ; i ++) {
+			uint32_t q = (w == 1) ? (uint8_t)dense[i] : reinterpret_cast < const uint16_t * > (dense)[i];
+			count += (q != def);
+		}
+		char * idx = out.data() + DOSAGE_HEADER + sizeof(uint32_t);
+		char * val = idx + count * sizeof(uint32_t);
+		memcpy(out.data() + DOSAGE_HEADER, &count, sizeof(uint32_t));
+		for (uint32_t i = 0, c = 0 ; i < n ; i ++) {
+			uint32_t q = (w == 1) ? (uint8_t)dense[i] : reinterpret_cast < const uint16_t * > (dense)[i];
+			if (q == def) continue;
+			memcpy(idx + c * sizeof(uint32_t), &i, sizeof(uint32_t));
+			memcpy(val + c * w, dense + i * w, w);
+			c ++;
+		}
+		return DOSAGE_HEADER + sizeof(uint32_t) + count * (sizeof(uint32_t) + w);
+	}
+
+	//DECODE A PAYLOAD INTO N DOSAGES [sparse: payload of a RECORD_SPARSE_DOSAGE]
+	inline void decode(const char * in, uint32_t nbytes, uint32_t n, bool sparse, float * out) {
+		if (nbytes < DOSAGE_HEADER) vrb.error("Truncated dosage record [" + stb.str(nbytes) + " bytes]");
+		const uint32_t bits = (uint8_t)in[0];
+		const uint32_t w = width(bits);
+		if (bits != 8 && bits != 16) vrb.error("Dosage record with unsupported precision [" + stb.str(bits) + " bits]");
+		if (!sparse) {
+			if (nbytes < DOSAGE_HEADER + n * w) vrb.error("Truncated dosage record [" + stb.str(nbytes) + " bytes for " + stb.str(n) + " samples]");
+			dequantize(in + DOSAGE_HEADER, n, bits, out);
+			return;
+		}
+		uint32_t count = 0;
+		memcpy(&count, in + DOSAGE_HEADER, sizeof(uint32_t));
+		if (nbytes < DOSAGE_HEADER + sizeof(uint32_t) + count * (sizeof(uint32_t) + w)) vrb.error("Truncated dosage record [" + stb.str(nbytes) + " bytes for " + stb.str(count) + " values]");
+		const float major = (float)(uint8_t)in[1];
+		for (uint32_t i = 0 ; i < n ; i ++) out[i] = major;
+		const char * idx = in + DOSAGE_HEADER + sizeof(uint32_t);
+		const char * val = idx + count * sizeof(uint32_t);
+		for (uint32_t c = 0 ; c < count ; c ++) {
+			uint32_t i;
+			memcpy(&i, idx + c * sizeof(uint32_t), sizeof(uint32_t));
+			if (i >= n) vrb.error("Dosage record with sample index out of range [" + stb.str(i) + "]");
+			dequantize(val + c * w, 1, bits, out + i);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _GT_KERNEL_H
+#define _GT_KERNEL_H
+
+#include <cstring>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "otools.h"
+
+extern "C" {
+	#include <htslib/vcf.h>
+}
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						GT_KERNEL									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Packing of diploid FORMAT/GT fields straight from their int8 storage in the bcf1_t, without the int32
+//expansion of bcf_get_genotypes. A GT byte is (allele+1)<<1|phased, 0 when missing, bcf_int8_vector_end
+//for the second allele of a haploid genotype. Bits follow the bitvector layout [haplotype h at bit 7-h%8
+//of byte h/8] and the values tested are the ones of bcf2binary on the int32 buffer: ALT is allele 1,
+//missing is the unphased missing value only.
+
+namespace gt_kernel
+{
+	//RAW GT BYTES OF [line] WHEN DIPLOID AND STORED ON 8 BITS, NULL OTHERWISE
+	inline const int8_t * raw(const bcf_hdr_t * hdr, bcf1_t * line, uint32_t n_samples) {
+		bcf_fmt_t * fmt = bcf_get_fmt(hdr, line, "GT");
+		if (fmt == NULL || fmt->type != BCF_BT_INT8 || fmt->n != 2 || line->n_sample != n_samples) return NULL;
+		return reinterpret_cast < const int8_t * > (fmt->p);
+	}
+
+	//NUMBER OF VALUES PER SAMPLE OF FORMAT/[tag] IN [line], 0 WHEN ABSENT
+	inline int32_t count(const bcf_hdr_t * hdr, bcf1_t * line, const char * tag) {
+		bcf_fmt_t * fmt = bcf_get_fmt(hdr, line, tag);
+		return fmt ? fmt->n : 0;
+	}
+
+	//8 GT BYTES TO ONE BYTE OF BITS PER TEST
+	inline void pack8(const int8_t * gt, char & alt, char & mis, char & pha) {
+		uint8_t a = 0, m = 0, p = 0;
+		for (uint32_t j = 0 ; j < 8 ; j ++) {
+			a |= (((gt[j] & 0xFE) == 4) << (7 - j));
+			m |= ((gt[j] == 0) << (7 - j));
+			p |= ((gt[j] & 1) << (7 - j));
+		}
+		alt = a; mis = m; pha = p;
+	}
+
+	//PACK [n_haps] GT BYTES INTO ALT ALLELE, MISSING AND PHASED BITS [pha can be NULL], RETURNS THE NUMBER OF MISSING ALLELES
+	//Bits past [n_haps] in the last byte are zeroed.
+	inline uint32_t pack(const int8_t * gt, uint32_t n_haps, char * alt, char * mis, char * pha) {
+		uint32_t h = 0, n_missing = 0;
+#if defined(__AVX2__)
+		//Bytes reversed within groups of 8, so that movemask gives bits in bitvector order
+		const __m256i rev = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+		const __m256i allele = _mm256_set1_epi8((char)0xFE), one = _mm256_set1_epi8(1), alt1 = _mm256_set1_epi8(4), zero = _mm256_setzero_si256();
+		for (; h + 32 <= n_haps ; h += 32) {
+			__m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast < const __m256i * > (gt + h)), rev);
+			uint32_t a = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, allele), alt1));
+			uint32_t m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+			memcpy(alt + h / 8, &a, sizeof(uint32_t));
+			memcpy(mis + h / 8, &m, sizeof(uint32_t));
+			if (pha) {
+				uint32_t p = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, one), one));
+				memcpy(pha + h / 8, &p, sizeof(uint32_t));
+			}
+			n_missing += __builtin_popcount(m);
+		}
+#endif
+		//Scalar tail [whole bytes, then the last partial one]
+		char p;
+		for (; h + 8 <= n_haps ; h += 8) {
+			pack8(gt + h, alt[h / 8], mis[h / 8], pha ? pha[h / 8] : p);
+			n_missing += __builtin_popcount((uint8_t)mis[h / 8]);
+		}
+		if (h < n_haps) {
+			int8_t last [8] = { 2, 2, 2, 2, 2, 2, 2, 2 };
+			memcpy(last, gt + h, n_haps - h);
+			pack8(last, alt[h / 8], mis[h / 8], pha ? pha[h / 8] : p);
+			if (pha) pha[h / 8] &= (char)(0xFF << (8 - (n_haps - h)));
+			n_missing += __builtin_popcount((uint8_t)mis[h / 8]);
+		}
+		return n_missing;
+	}
+
+	//BINARY GENOTYPES FROM ALT AND MISSING BITS OF [n_bytes] [2 bits per sample: missing 10, hom a0a1, het 01]
+	inline void genotypes(const char * alt, const char * mis, uint32_t n_bytes, char * out) {
+		const uint64_t lo = 0x5555555555555555ULL;
+		uint32_t b = 0;
+		for (; b + 8 <= n_bytes ; b += 8) {
+			uint64_t x, y, g;
+			memcpy(&x, alt + b, sizeof(uint64_t));
+			memcpy(&y, mis + b, sizeof(uint64_t));
+			const uint64_t m = ((y >> 1) | y) & lo;
+			g = ((m | ((x >> 1) & x & lo)) << 1) | (~m & ((x >> 1) | x) & lo);
+			memcpy(out + b, &g, sizeof(uint64_t));
+		}
+		for (; b < n_bytes ; b ++) {
+			const uint8_t x = alt[b], y = mis[b];
+			const uint8_t m = ((y >> 1) | y) & 0x55;
+			out[b] = (char)(((m | ((x >> 1) & x & 0x55)) << 1) | (~m & ((x >> 1) | x) & 0x55));
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _ORDINAL_INDEX_H
+#define _ORDINAL_INDEX_H
+
+#include <fstream>
+#include <cstring>
+
+#include "otools.h"
+
+#define ORDIDX_MAGIC		"XCFOIDX1"			//Magic string of .oidx files
+#define ORDIDX_VERSION		2
+#define ORDIDX_STEP			1024				//One checkpoint every ORDIDX_STEP variants of a contig
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						ORDINAL_INDEX								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Maps the k-th variant of a contig to a genomic location, written next to the .csi of BCF/XCF files.
+//
+//	[Header]	magic (8 bytes) | version (u32) | step (u32) | file size (u64) | n_contigs (u32)
+//	[Contigs]	length (u32), name | n_variants (u64) | n_checkpoints (u32) | pos (u32 x n_checkpoints) | dup (u32 x n_checkpoints)
+//
+//Checkpoint c locates variant c*step: [pos] is its 1-based position and [dup] the number of variants of the
+//contig sharing that position before it. Jumping to variant k therefore means querying the .csi at the
+//position of checkpoint k/step, then skipping [dup] + k%step records. Contigs follow the order of the BCF header.
+//The size of the indexed file is kept so that an index left over from another version of the file is not used.
+
+class ordinal_index {
+public:
+	uint32_t step;
+	uint64_t hts_size;										//Size in bytes of the indexed file
+	std::vector < std::string > contigs;
+	std::vector < uint64_t > counts;						//Variants per contig
+	std::vector < std::vector < uint32_t > > cp_pos;		//Checkpoint positions per contig
+	std::vector < std::vector < uint32_t > > cp_dup;		//Variants at the same position before each checkpoint
+
+	//Building state
+	int32_t last_rid;
+	uint32_t last_pos;
+	uint32_t last_dup;
+
+	ordinal_index() : step(ORDIDX_STEP), hts_size(0), last_rid(-1), last_pos(0), last_dup(0) {
+	}
+
+	~ordinal_index() {
+	}
+
+	static std::string filename(std::string hts_fname) {
+		return hts_fname + ".oidx";
+	}
+
+	static uint64_t fileSize(std::string hts_fname) {
+		std::ifstream fd (hts_fname.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+		return fd ? (uint64_t)fd.tellg() : 0;
+	}
+
+	bool empty() const {
+		return contigs.empty();
+	}
+
+	void clear() {
+		contigs.clear(); counts.clear(); cp_pos.clear(); cp_dup.clear();
+		hts_size = 0;
+		last_rid = -1; last_pos = last_dup = 0;
+	}
+
+	//Add next variant of a sorted file [rid from the BCF header, 1-based pos]
+	void push(int32_t rid, uint32_t pos) {
+		if (rid < 0) return;
+		if ((uint32_t)rid >= counts.size()) {
+			counts.resize(rid + 1, 0);
+			cp_pos.resize(rid + 1);
+			cp_dup.resize(rid + 1);
+		}
+		last_dup = (rid == last_rid && pos == last_pos) ? last_dup + 1 : 0;
+		last_rid = rid;
+		last_pos = pos;
+		if (counts[rid] % step == 0) {
+			cp_pos[rid].push_back(pos);
+			cp_dup[rid].push_back(last_dup);
+		}
+		counts[rid] ++;
+	}
+
+	//Contig names of the BCF header [to be set before saving]
+	void setContigs(const bcf_hdr_t * hdr) {
+		contigs.clear();
+		for (int c = 0 ; c < hdr->n[BCF_DT_CTG] ; c ++) contigs.push_back(std::string(hdr->id[BCF_DT_CTG][c].key));
+		counts.resize(contigs.size(), 0);
+		cp_pos.resize(contigs.size());
+		cp_dup.resize(contigs.size());
+	}
+
+	//Build by scanning all records of a BCF/VCF file [slow path for files written without .oidx]
+	bool build(std::string hts_fname) {
+		clear();
+		htsFile * fp = hts_open(hts_fname.c_str(), "r");
+		if (!fp) return false;
+		bcf_hdr_t * hdr = bcf_hdr_read(fp);
+		if (!hdr) { hts_close(fp); return false; }
+		bcf1_t * line = bcf_init();
+		int32_t ret;
+		while ((ret = bcf_read(fp, hdr, line)) == 0) push(line->rid, line->pos + 1);
+		setContigs(hdr);
+		bcf_destroy(line);
+		bcf_hdr_destroy(hdr);
+		hts_close(fp);
+		hts_size = fileSize(hts_fname);
+		return (ret == -1);
+	}
+
+	bool save(std::string fname) const {
+		std::ofstream fd (fname.c_str(), std::ios::out | std::ios::binary);
+		if (!fd) return false;
+		uint32_t version = ORDIDX_VERSION, n_contigs = contigs.size();
+		fd.write(ORDIDX_MAGIC, 8);
+		fd.write((char*)&version, sizeof(uint32_t));
+		fd.write((char*)&step, sizeof(uint32_t));
+		fd.write((char*)&hts_size, sizeof(uint64_t));
+		fd.write((char*)&n_contigs, sizeof(uint32_t));
+		for (uint32_t c = 0 ; c < n_contigs ; c ++) {
+			uint32_t len = contigs[c].size(), n_cp = cp_pos[c].size();
+			fd.write((char*)&len, sizeof(uint32_t));
+			fd.write(contigs[c].c_str(), len);
+			fd.write((char*)&counts[c], sizeof(uint64_t));
+			fd.write((char*)&n_cp, sizeof(uint32_t));
+			fd.write((char*)cp_pos[c].data(), n_cp * sizeof(uint32_t));
+			fd.write((char*)cp_dup[c].data(), n_cp * sizeof(uint32_t));
+		}
+		return fd.good();
+	}
+
+	//Load the .oidx of [hts_fname] / Returns false when missing, unreadable or stale [file size differs]
+	bool load(std::string hts_fname) {
+		clear();
+		std::ifstream fd (filename(hts_fname).c_str(), std::ios::in | std::ios::binary);
+		if (!fd) return false;
+		char magic[8];
+		uint32_t version = 0, n_contigs = 0;
+		fd.read(magic, 8);
+		fd.read((char*)&version, sizeof(uint32_t));
+		fd.read((char*)&step, sizeof(uint32_t));
+		fd.read((char*)&hts_size, sizeof(uint64_t));
+		fd.read((char*)&n_contigs, sizeof(uint32_t));
+		if (!fd || memcmp(magic, ORDIDX_MAGIC, 8) || version != ORDIDX_VERSION || step == 0 || hts_size != fileSize(hts_fname)) { clear(); return false; }
+		counts.resize(n_contigs);
+		cp_pos.resize(n_contigs);
+		cp_dup.resize(n_contigs);
+		for (uint32_t c = 0 ; c < n_contigs && fd ; c ++) {
+			uint32_t len = 0, n_cp = 0;
+			fd.read((char*)&len, sizeof(uint32_t));
+			std::string name (len, ' ');
+			fd.read(name.data(), len);
+			contigs.push_back(name);
+			fd.read((char*)&counts[c], sizeof(uint64_t));
+			fd.read((char*)&n_cp, sizeof(uint32_t));
+			cp_pos[c].resize(n_cp);
+			cp_dup[c].resize(n_cp);
+			fd.read((char*)cp_pos[c].data(), n_cp * sizeof(uint32_t));
+			fd.read((char*)cp_dup[c].data(), n_cp * sizeof(uint32_t));
+		}
+		if (!fd) { clear(); return false; }
+		return true;
+	}
+
+	int32_t contig(const std::string & name) const {
+		for (uint32_t c = 0 ; c < contigs.size() ; c ++) if (contigs[c] == name) return c;
+		return -1;
+	}
+
+	uint64_t count(const std::string & name) const {
+		int32_t c = contig(name);
+		return (c < 0) ? 0 : counts[c];
+	}
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _PBWT_CODEC_H
+#define _PBWT_CODEC_H
+
+#include <cstring>
+#include <vector>
+#include <numeric>
+
+#include "otools.h"
+
+#define PBWT_CHECKPOINT		1024			//Records per chain: the order is reset to identity every PBWT_CHECKPOINT records
+#define PBWT_HEADER			17				//Bytes of the record header
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						PBWT_CODEC									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Haplotype records coded in positional BWT order. Haplotypes are sorted by their reversed prefixes,
+//so haplotypes sharing the same recent history sit next to each other and the alleles of a record
+//form long runs in that order. A record stores these runs, and the order of the next record is
+//obtained by a stable partition of the current order on the alleles [0s first, then 1s].
+//
+//	[Header]	first allele (u8) | position in chain (u32) | distance back to the previous record (u64) | size of previous record (u32)
+//	[Runs]		LEB128 varint run lengths, alleles alternating from the first one
+//
+//Records of a chromosome form chains of at most PBWT_CHECKPOINT records. The first record of a chain
+//[position 0] starts from the identity order. A reader landing in the middle of a chain [region
+//query, skipped records] walks back the links to the start of the chain and replays it. Links are
+//SEEK differences, so chains survive binary files being concatenated.
+//Allele bits use the bitvector layout [most significant bit first].
+
+class pbwt_codec {
+public:
+	uint32_t n_haps;
+	std::vector < int32_t > order;				//Current PBWT order
+	std::vector < int32_t > zeros, ones;		//Partition buffers
+	bool valid;									//Is the order in sync with the chain
+	int32_t rid;								//Chromosome of the chain [writer]
+	uint32_t position;							//Position in chain of the last record
+	uint64_t last_seek;							//SEEK of the last record
+	uint32_t last_size;							//Size of the last record
+
+	struct header {
+		bool first;
+		uint32_t position;
+		uint64_t prev_seek;
+		uint32_t prev_size;
+	};
+
+	pbwt_codec() : n_haps(0), valid(false), rid(-1), position(0), last_seek(0), last_size(0) {
+	}
+
+	void init(uint32_t _n_haps) {
+		n_haps = _n_haps;
+		order.resize(n_haps);
+		zeros.reserve(n_haps);
+		ones.reserve(n_haps);
+		valid = false;
+		rid = -1;
+	}
+
+	void reset() {
+		std::iota(order.begin(), order.end(), 0);
+		position = 0;
+		valid = true;
+	}
+
+	static inline bool getBit(const char * bits, uint32_t idx) {
+		return (bits[idx / 8] >> (7 - (idx % 8))) & 1;
+	}
+
+	static inline void setBit(char * bits, uint32_t idx) {
+		bits[idx / 8] |= (1 << (7 - (idx % 8)));
+	}
+
+	//Header of the record at [seek]
+	static header parse(const char * in, uint64_t seek) {
+		header h;
+		uint64_t back;
+		h.first = in[0];
+		memcpy(&h.position, in + 1, sizeof(uint32_t));
+		memcpy(&back, in + 5, sizeof(uint64_t));
+		memcpy(&h.prev_size, in + 13, sizeof(uint32_t));
+		h.prev_seek = seek - back;
+		return h;
+	}
+
+	//Writer: code the allele bits of chromosome [_rid] into [out], returns the number of bytes
+	//The record has to be linked once its SEEK is known
+	uint32_t encode(const char * bits, int32_t _rid, std::vector < char > & out) {
+		if (!valid || _rid != rid || position + 1 >= PBWT_CHECKPOINT) reset();
+		else position ++;
+		rid = _rid;
+
+		if (out.size() < PBWT_HEADER + 5 * (uint64_t)n_haps) out.resize(PBWT_HEADER + 5 * (uint64_t)n_haps);
+		unsigned char * ptr = reinterpret_cast < unsigned char * > (out.data());
+		bool curr = n_haps ? getBit(bits, order[0]) : false;
+		ptr[0] = curr;
+		memcpy(ptr + 1, &position, sizeof(uint32_t));
+		memset(ptr + 5, 0, sizeof(uint64_t) + sizeof(uint32_t));
+		ptr += PBWT_HEADER;
+
+		zeros.clear(); ones.clear();
+		uint32_t run = 0;
+		for (uint32_t j = 0 ; j < n_haps ; j ++) {
+			const int32_t h = order[j];
+			const bool a = getBit(bits, h);
+			if (a) ones.push_back(h); else zeros.push_back(h);
+			if (a != curr) { ptr = putVarint(ptr, run); curr = a; run = 0; }
+			run ++;
+		}
+		if (n_haps) ptr = putVarint(ptr, run);
+		merge();
+		return ptr - reinterpret_cast < unsigned char * > (out.data());
+	}
+
+	//Writer: link the record about to be written at [seek] to the previous one
+	void link(char * record, uint64_t seek, uint32_t size) {
+		if (position > 0) {
+			uint64_t back = seek - last_seek;
+			memcpy(record + 5, &back, sizeof(uint64_t));
+			memcpy(record + 13, &last_size, sizeof(uint32_t));
+		}
+		last_seek = seek;
+		last_size = size;
+	}
+
+	//Reader: is the order ready to decode a record with header [h]
+	bool follows(const header & h) const {
+		return h.position == 0 || (valid && h.position == position + 1 && h.prev_seek == last_seek);
+	}
+
+	//Reader: decode the record at [seek] into [bits] [NULL to only update the order]
+	//Returns false when the order is not in sync with the chain, the caller has to replay it first.
+	bool decode(const char * in, uint32_t nbytes, uint64_t seek, char * bits) {
+		if (nbytes < PBWT_HEADER) vrb.error("Truncated PBWT record [" + stb.str(nbytes) + " bytes]");
+		header h = parse(in, seek);
+		if (!follows(h)) return false;
+		if (h.position == 0) reset();
+
+		if (bits) memset(bits, 0, (n_haps + 7) / 8);
+		zeros.clear(); ones.clear();
+		const unsigned char * ptr = reinterpret_cast < const unsigned char * > (in) + PBWT_HEADER;
+		const unsigned char * end = reinterpret_cast < const unsigned char * > (in) + nbytes;
+		bool curr = h.first;
+		uint32_t j = 0;
+		while (ptr < end) {
+			uint32_t run = 0;
+			ptr = getVarint(ptr, end, run);
+			if (j + run > n_haps) vrb.error("Corrupted PBWT record [runs over " + stb.str(n_haps) + " haplotypes]");
+			std::vector < int32_t > & part = curr ? ones : zeros;
+			for (uint32_t r = 0 ; r < run ; r ++, j ++) {
+				if (curr && bits) setBit(bits, order[j]);
+				part.push_back(order[j]);
+			}
+			curr = !curr;
+		}
+		if (j != n_haps) vrb.error("Corrupted PBWT record [" + stb.str(j) + " / " + stb.str(n_haps) + " haplotypes]");
+		merge();
+		position = h.position;
+		last_seek = seek;
+		last_size = nbytes;
+		return true;
+	}
+
+private:
+	//Next order: stable partition on the alleles of the last record
+	void merge() {
+		std::copy(zeros.begin(), zeros.end(), order.begin());
+		std::copy(ones.begin(), ones.end(), order.begin() + zeros.size());
+	}
+
+	static unsigned char * putVarint(unsigned char * ptr, uint32_t v) {
+		while (v >= 0x80) { *(ptr++) = (v & 0x7F) | 0x80; v >>= 7; }
+		*(ptr++) = v;
+		return ptr;
+	}
+
+	static const unsigned char * getVarint(const unsigned char * ptr, const unsigned char * end, uint32_t & v) {
+		v = 0;
+		for (uint32_t shift = 0 ; ptr < end && shift < 35 ; shift += 7) {
+			const unsigned char b = *(ptr++);
+			v |= (uint32_t)(b & 0x7F) << shift;
+			if (!(b & 0x80)) return ptr;
+		}
+		vrb.error("Corrupted PBWT record [unterminated run length]");
+		return ptr;
+	}
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _PHASEPROB_CODEC_H
+#define _PHASEPROB_CODEC_H
+
+#include <cstring>
+#include <vector>
+
+#include "otools.h"
+#include "dosage_codec.h"
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						PHASEPROB_CODEC								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Payload of fixed point phase probability records [RECORD_SPARSE_PHASEPROBS_FP]. Same sparse genotypes
+//as RECORD_SPARSE_PHASEPROBS, but probabilities follow in 8 or 16 bits fixed point instead of float:
+//
+//	[Header]	u8 bits per probability (8 or 16), u8 and u16 reserved
+//	[Sparse]	count sparse genotypes (see sparse_genotype.h), then count probabilities
+//
+//Probabilities in [0,1] are coded as round(p * (2^bits - 2)), the largest code being kept for missing
+//values. The absolute error is at most 1/508 on 8 bits and 1/131068 on 16 bits, so that 16 bits codes
+//give back the 3 decimals written in BCF output. Kernels are the ones of dosage_codec.h.
+
+#define PHASEPROB_HEADER	4
+#define PHASEPROB_RANGE		1.0f
+
+namespace phaseprob_codec
+{
+	//MAXIMUM ABSOLUTE ERROR ON A PROBABILITY
+	inline float error(uint32_t bits) {
+		return 0.5f / dosage_codec::scale(bits, PHASEPROB_RANGE);
+	}
+
+	//ENCODE N SPARSE GENOTYPES AND THEIR PROBABILITIES INTO OUT, RETURNS THE NUMBER OF BYTES USED
+	inline uint32_t encode(const int32_t * gts, const float * probs, uint32_t n, uint32_t bits, std::vector < char > & out) {
+		const uint32_t n_bytes = PHASEPROB_HEADER + n * (sizeof(int32_t) + dosage_codec::width(bits));
+		if (out.size() < n_bytes) out.resize(n_bytes);
+		out[0] = (char)bits;
+		out[1] = out[2] = out[3] = 0;
+		memcpy(out.data() + PHASEPROB_HEADER, gts, n * sizeof(int32_t));
+		dosage_codec::quantize(probs, n, bits, out.data() + PHASEPROB_HEADER + n * sizeof(int32_t), PHASEPROB_RANGE);
+		return n_bytes;
+	}
+
+	//DECODE A PAYLOAD INTO ITS SPARSE GENOTYPES AND PROBABILITIES [missing code to bcf_float_missing], RETURNS THEIR NUMBER
+	inline uint32_t decode(const char * in, uint32_t nbytes, std::vector < int32_t > & gts, std::vector < float > & probs) {
+		if (nbytes < PHASEPROB_HEADER) vrb.error("Truncated phase probability record [" + stb.str(nbytes) + " bytes]");
+		const uint32_t bits = (uint8_t)in[0];
+		if (bits != 8 && bits != 16) vrb.error("Phase probability record with unsupported precision [" + stb.str(bits) + " bits]");
+		const uint32_t stride = sizeof(int32_t) + dosage_codec::width(bits);
+		if ((nbytes - PHASEPROB_HEADER) % stride) vrb.error("Truncated phase probability record [" + stb.str(nbytes) + " bytes]");
+		const uint32_t n = (nbytes - PHASEPROB_HEADER) / stride;
+		gts.resize(n);
+		probs.resize(n);
+		memcpy(gts.data(), in + PHASEPROB_HEADER, n * sizeof(int32_t));
+		dosage_codec::dequantize(in + PHASEPROB_HEADER + n * sizeof(int32_t), n, bits, probs.data(), PHASEPROB_RANGE);
+		return n;
+	}
+}
+
+#endif
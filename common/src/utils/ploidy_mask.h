@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _PLOIDY_MASK_H
+#define _PLOIDY_MASK_H
+
+#include <cstring>
+#include <vector>
+
+#include "otools.h"
+
+extern "C" {
+	#include <htslib/vcf.h>
+}
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						PLOIDY_MASK									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Haploid-aware records [chrX/chrY/MT]. The ploidy of each sample (1 or 2) is given by the 5th column
+//of the .fam file and defines a compact haplotype layout: sample i owns 1 or 2 consecutive haplotypes.
+//Genotypes are exchanged in the usual diploid GT layout (2 values per sample), haploid samples having
+//bcf_int32_vector_end as second value. Two payloads are defined on the compact layout:
+//
+//	[Binary]	1 bit per haplotype, MSB first as in bitvector; no missing allele, diploid genotypes
+//				phased or homozygous (same semantic as binary haplotypes)
+//	[Sparse]	u32 flags followed by one u32 per listed haplotype: index in the compact layout plus
+//				PLOIDY_SPARSE_MIS (missing allele) and PLOIDY_SPARSE_PHA (phased diploid genotype).
+//				Haplotypes carrying the minor allele and missing ones are listed, in increasing order.
+
+#define PLOIDY_SPARSE_MIS		0x80000000u		//Missing allele
+#define PLOIDY_SPARSE_PHA		0x40000000u		//Phased diploid genotype
+#define PLOIDY_SPARSE_IDX		0x3FFFFFFFu		//Haplotype index in the compact layout
+#define PLOIDY_SPARSE_PHASED	1u				//Flag: unlisted diploid genotypes are phased
+
+class ploidy_mask {
+public:
+	std::vector < uint8_t > ploidy;		//Ploidy of each sample [1 or 2]
+	std::vector < uint32_t > slot;		//Haplotype in the compact layout -> value in the diploid GT layout
+	uint32_t n_haploid;					//Number of haploid samples
+
+	ploidy_mask() : n_haploid(0) {
+	}
+
+	void set(const std::vector < uint8_t > & _ploidy) {
+		ploidy = _ploidy;
+		slot.clear();
+		n_haploid = 0;
+		for (uint32_t i = 0 ; i < ploidy.size() ; i ++) {
+			slot.push_back(2*i+0);
+			if (ploidy[i] == 1) n_haploid ++;
+			else slot.push_back(2*i+1);
+		}
+	}
+
+	//Mask restricted to some samples [in the given order]
+	ploidy_mask subset(const std::vector < int32_t > & samples) const {
+		std::vector < uint8_t > sub;
+		for (uint32_t i = 0 ; i < samples.size() ; i ++) sub.push_back(ploidy[samples[i]]);
+		ploidy_mask m;
+		m.set(sub);
+		return m;
+	}
+
+	bool mixed() const { return n_haploid > 0; }
+	uint32_t size() const { return slot.size(); }
+	uint32_t n_bytes() const { return DIVU(slot.size(), 8); }
+
+	//PLOIDY OF SAMPLE [i] IN DIPLOID GT LAYOUT
+	static uint8_t ploidyOf(const int32_t * gt, uint32_t i) {
+		return (gt[2*i+1] == bcf_int32_vector_end) ? 1 : 2;
+	}
+
+	//DO THE PLOIDIES OF THE GENOTYPES MATCH THE MASK?
+	bool match(const int32_t * gt) const {
+		for (uint32_t i = 0 ; i < ploidy.size() ; i ++) if (ploidyOf(gt, i) != ploidy[i]) return false;
+		return true;
+	}
+
+	//CAN THE GENOTYPES GO IN A BINARY PAYLOAD? [no missing allele, diploid genotypes phased or homozygous]
+	bool binary(const int32_t * gt) const {
+		for (uint32_t i = 0 ; i < ploidy.size() ; i ++) {
+			if (bcf_gt_is_missing(gt[2*i+0])) return false;
+			if (ploidy[i] == 1) continue;
+			if (bcf_gt_is_missing(gt[2*i+1])) return false;
+			if (!bcf_gt_is_phased(gt[2*i+1]) && bcf_gt_allele(gt[2*i+0]) != bcf_gt_allele(gt[2*i+1])) return false;
+		}
+		return true;
+	}
+
+	//ENCODE INTO [bytes] [n_bytes() long]
+	void encodeBinary(const int32_t * gt, char * bytes) const {
+		memset(bytes, 0, n_bytes());
+		for (uint32_t h = 0 ; h < slot.size() ; h ++) if (bcf_gt_allele(gt[slot[h]]) == 1) bytes[h / 8] |= (1 << (7 - (h % 8)));
+	}
+
+	void decodeBinary(const char * bytes, int32_t * gt) const {
+		for (uint32_t i = 0 ; i < ploidy.size() ; i ++) gt[2*i+1] = bcf_int32_vector_end;
+		for (uint32_t h = 0 ; h < slot.size() ; h ++) gt[slot[h]] = bcf_gt_phased((bytes[h / 8] >> (7 - (h % 8))) & 1);
+	}
+
+	//ENCODE INTO [out], returns the number of u32 written [flags included]
+	uint32_t encodeSparse(const int32_t * gt, const bool minor, std::vector < int32_t > & out) const {
+		out.resize(slot.size() + 1);
+		uint32_t * sp = reinterpret_cast < uint32_t * > (out.data());
+		uint32_t n = 1, n_phased = 0, n_diploid = 0;
+		for (uint32_t i = 0, h = 0 ; i < ploidy.size() ; h += ploidy[i], i ++) {
+			if (ploidy[i] == 1) {
+				if (bcf_gt_is_missing(gt[2*i+0])) sp[n++] = h | PLOIDY_SPARSE_MIS;
+				else if (bcf_gt_allele(gt[2*i+0]) == minor) sp[n++] = h;
+				continue;
+			}
+			if (bcf_gt_is_missing(gt[2*i+0]) || bcf_gt_is_missing(gt[2*i+1])) {
+				sp[n++] = h | PLOIDY_SPARSE_MIS;
+				sp[n++] = (h + 1) | PLOIDY_SPARSE_MIS;
+				continue;
+			}
+			const uint32_t pha = bcf_gt_is_phased(gt[2*i+1]) ? PLOIDY_SPARSE_PHA : 0;
+			n_phased += (pha != 0);
+			n_diploid ++;
+			if (bcf_gt_allele(gt[2*i+0]) == minor) sp[n++] = h | pha;
+			if (bcf_gt_allele(gt[2*i+1]) == minor) sp[n++] = (h + 1) | pha;
+		}
+		sp[0] = (n_diploid > 0 && n_phased == n_diploid) ? PLOIDY_SPARSE_PHASED : 0;
+		return n;
+	}
+
+	void decodeSparse(const int32_t * payload, const uint32_t n, const bool major, int32_t * gt) const {
+		const uint32_t * sp = reinterpret_cast < const uint32_t * > (payload);
+		const bool phased = (n > 0) && (sp[0] & PLOIDY_SPARSE_PHASED);
+		for (uint32_t i = 0 ; i < ploidy.size() ; i ++) {
+			gt[2*i+0] = bcf_gt_unphased(major);
+			gt[2*i+1] = (ploidy[i] == 1) ? bcf_int32_vector_end : (phased ? bcf_gt_phased(major) : bcf_gt_unphased(major));
+		}
+		for (uint32_t r = 1 ; r < n ; r ++) {
+			const uint32_t h = sp[r] & PLOIDY_SPARSE_IDX;
+			const uint32_t s = slot[h];
+			if (sp[r] & PLOIDY_SPARSE_MIS) { gt[s] = bcf_gt_missing; continue; }
+			gt[s] = bcf_gt_unphased(!major);
+			//Phase is carried by the second allele of diploid genotypes
+			if (ploidy[s/2] == 2) gt[(s|1)] = (sp[r] & PLOIDY_SPARSE_PHA) ? (gt[(s|1)] | 1) : (gt[(s|1)] & ~1);
+		}
+	}
+};
+
+#endif
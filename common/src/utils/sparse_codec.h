@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+
+#ifndef _SPARSE_CODEC_H
+#define _SPARSE_CODEC_H
+
+#include <cstring>
+#include <vector>
+#include <array>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "otools.h"
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						SPARSE_CODEC								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Compact payload for sparse records. Sparse records hold sorted 32 bits values (haplotype indexes, or
+//sparse_genotype packed with the index in the high bits), so consecutive values are usually a few
+//units apart. Values are delta coded and each delta is stored on 1 to 4 bytes, with the byte lengths
+//kept apart in 2 bits control codes (stream vbyte layout):
+//
+//	[Count]		number of values (u32)
+//	[Control]	(count+3)/4 bytes, 2 bits per value giving its length minus one, low bits first
+//	[Data]		little endian deltas, first one relative to 0
+//
+//Keeping the lengths apart lets the decoder expand 4 deltas at a time with a single byte shuffle and
+//rebuild the values with a prefix sum. Deltas are computed modulo 2^32, unsorted input still round trips.
+
+namespace sparse_codec
+{
+	//MAXIMUM NUMBER OF BYTES NEEDED TO ENCODE N VALUES
+	inline uint32_t bound(uint32_t n) {
+		return sizeof(uint32_t) + (n + 3) / 4 + n * sizeof(uint32_t);
+	}
+
+	//NUMBER OF VALUES IN AN ENCODED PAYLOAD
+	inline uint32_t count(const char * in, uint32_t nbytes) {
+		if (nbytes < sizeof(uint32_t)) return 0;
+		uint32_t n;
+		memcpy(&n, in, sizeof(uint32_t));
+		return n;
+	}
+
+	inline uint32_t length(uint32_t v) {
+		return 1 + (v > 0xFF) + (v > 0xFFFF) + (v > 0xFFFFFF);
+	}
+
+	//ENCODE N VALUES INTO OUT, RETURNS THE NUMBER OF BYTES USED
+	inline uint32_t encode(const int32_t * in, uint32_t n, std::vector < char > & out) {
+		if (out.size() < bound(n)) out.resize(bound(n));
+		unsigned char * ctrl = reinterpret_cast < unsigned char * > (out.data()) + sizeof(uint32_t);
+		unsigned char * data = ctrl + (n + 3) / 4;
+		memcpy(out.data(), &n, sizeof(uint32_t));
+		memset(ctrl, 0, (n + 3) / 4);
+		uint32_t prev = 0;
+		for (uint32_t i = 0 ; i < n ; i ++) {
+			uint32_t delta = (uint32_t)in[i] - prev;
+			uint32_t len = length(delta);
+			ctrl[i >> 2] |= (len - 1) << ((i & 3) * 2);
+			memcpy(data, &delta, len);	//little endian: low bytes first
+			data += len;
+			prev = (uint32_t)in[i];
+		}
+		return data - reinterpret_cast < unsigned char * > (out.data());
+	}
+
+#if defined(__SSSE3__)
+	//SHUFFLE MASKS AND DATA LENGTHS FOR THE 256 POSSIBLE CONTROL BYTES
+	struct shuffle_table {
+		alignas(16) std::array < std::array < int8_t, 16 >, 256 > mask;
+		std::array < uint8_t, 256 > bytes;
+
+		shuffle_table() {
+			for (uint32_t c = 0 ; c < 256 ; c ++) {
+				uint32_t src = 0;
+				for (uint32_t v = 0 ; v < 4 ; v ++) {
+					uint32_t len = ((c >> (2 * v)) & 3) + 1;
+					for (uint32_t b = 0 ; b < 4 ; b ++) mask[c][4 * v + b] = (b < len) ? (int8_t)(src ++) : -1;
+				}
+				bytes[c] = src;
+			}
+		}
+	};
+
+	inline const shuffle_table & table() {
+		static const shuffle_table T;
+		return T;
+	}
+#endif
+
+	//DECODE A PAYLOAD OF NBYTES INTO OUT [ALLOCATED FOR COUNT VALUES], RETURNS THE NUMBER OF VALUES
+	inline uint32_t decode(const char * in, uint32_t nbytes, int32_t * out) {
+		uint32_t n = count(in, nbytes);
+		if (n == 0) return 0;
+		const unsigned char * ctrl = reinterpret_cast < const unsigned char * > (in) + sizeof(uint32_t);
+		const unsigned char * data = ctrl + (n + 3) / 4;
+		const unsigned char * end = reinterpret_cast < const unsigned char * > (in) + nbytes;
+		if (data + n > end) vrb.error("Truncated sparse record [" + stb.str(nbytes) + " bytes for " + stb.str(n) + " values]");
+		uint32_t i = 0, prev = 0;
+
+#if defined(__SSSE3__)
+		//Groups of 4 deltas: shuffle bytes into 4 lanes, then prefix sum across lanes. Each group reads
+		//16 bytes, so we stop while a full load still fits in the payload.
+		const shuffle_table & T = table();
+		__m128i carry = _mm_setzero_si128();
+		for (; i + 4 <= n && data + 16 <= end ; i += 4) {
+			const uint8_t c = ctrl[i >> 2];
+			__m128i v = _mm_loadu_si128(reinterpret_cast < const __m128i * > (data));
+			v = _mm_shuffle_epi8(v, _mm_load_si128(reinterpret_cast < const __m128i * > (T.mask[c].data())));
+			v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+			v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+			v = _mm_add_epi32(v, carry);
+			_mm_storeu_si128(reinterpret_cast < __m128i * > (out + i), v);
+			carry = _mm_shuffle_epi32(v, 0xFF);
+			data += T.bytes[c];
+		}
+		prev = (uint32_t)_mm_cvtsi128_si32(carry);
+#endif
+
+		//Scalar tail
+		for (; i < n ; i ++) {
+			uint32_t len = ((ctrl[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+			if (data + len > end) vrb.error("Truncated sparse record [" + stb.str(nbytes) + " bytes for " + stb.str(n) + " values]");
+			uint32_t delta = 0;
+			memcpy(&delta, data, len);
+			data += len;
+			prev += delta;
+			out[i] = (int32_t)prev;
+		}
+		return n;
+	}
+
+	//DECODE INTO A VECTOR, RESIZED TO AT LEAST COUNT VALUES
+	inline uint32_t decode(const char * in, uint32_t nbytes, std::vector < int32_t > & out) {
+		uint32_t n = count(in, nbytes);
+		if (out.size() < n) out.resize(n);
+		return decode(in, nbytes, out.data());
+	}
+}
+
+#endif
@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _TILED_BLOCK_H
+#define _TILED_BLOCK_H
+
+#include <cstring>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "otools.h"
+
+#define TILE_HAPLOTYPES		4096				//Default number of haplotypes per tile [multiple of 8]
+#define TILE_VARIANTS		256					//Number of binary records per block
+#define TILE_HEADER			16					//Fixed part of the block header
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						TILED_BLOCK									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//2D tiled layout of binary records in the .bin file [RECORD_BINARY_HAPLOTYPE_TILED / RECORD_BINARY_GENOTYPE_TILED].
+//Consecutive binary records of S bytes are gathered in blocks of up to TILE_VARIANTS records. Each block is
+//cut along the samples into tiles of T haplotypes (T/8 bytes of each record):
+//
+//	[Header]	n_variants (u32) | S (u32) | T (u32) | n_tiles (u32) | tile offsets from block start (u64 x n_tiles)
+//	[Tiles]		tile t holds bytes [t*T/8, min(S, (t+1)*T/8)) of the n_variants records, one after the other
+//
+//INFO/SEEK of a tiled record gives the offset of its block and, in place of the size, its index in the block.
+//A reader restricted to some samples only fetches the tiles holding them: one read per run of adjacent tiles
+//and per block, instead of full records.
+
+namespace tiled_block
+{
+	inline uint32_t count(uint32_t S, uint32_t T) {
+		return (S + T / 8 - 1) / (T / 8);
+	}
+
+	//BYTES OF EACH RECORD IN TILE [t]
+	inline uint32_t width(uint32_t t, uint32_t S, uint32_t T) {
+		return std::min(S, (t + 1) * (T / 8)) - t * (T / 8);
+	}
+
+	inline uint64_t headerBytes(uint32_t S, uint32_t T) {
+		return TILE_HEADER + count(S, T) * sizeof(uint64_t);
+	}
+
+	//BYTES OF A BLOCK OF [nv] RECORDS
+	inline uint64_t size(uint32_t nv, uint32_t S, uint32_t T) {
+		return headerBytes(S, T) + (uint64_t)nv * S;
+	}
+}
+
+class tiled_block_writer {
+public:
+	uint32_t tile_haps;							//Haplotypes per tile [0: tiling disabled]
+	uint32_t record_bytes;						//Bytes per record, same for all records of the file
+	uint32_t n;									//Records in the current block
+	uint64_t offset;							//Location of the current block in the binary file
+	uint64_t reserved;							//Room kept for the current block in the binary file
+	std::vector < char > records;				//Records of the current block, one after the other
+
+	tiled_block_writer() : tile_haps(0), record_bytes(0), n(0), offset(0), reserved(0) {
+	}
+
+	void init(uint32_t _tile_haps) {
+		if (_tile_haps == 0 || _tile_haps % 8) vrb.error("Number of haplotypes per tile must be a positive multiple of 8");
+		tile_haps = _tile_haps;
+	}
+
+	bool active() const {
+		return tile_haps > 0;
+	}
+
+	bool full() const {
+		return n == TILE_VARIANTS;
+	}
+
+	//ROOM OF A FULL BLOCK OF RECORDS OF [nbytes]
+	uint64_t reserve(uint32_t nbytes) {
+		if (record_bytes == 0) record_bytes = nbytes;
+		reserved = tiled_block::size(TILE_VARIANTS, record_bytes, tile_haps);
+		return reserved;
+	}
+
+	//ADD A RECORD TO THE CURRENT BLOCK, RETURNS ITS INDEX IN THE BLOCK
+	uint32_t push(const char * buffer, uint32_t nbytes) {
+		if (nbytes != record_bytes) vrb.error("Tiled binary records must all have the same size [" + stb.str(nbytes) + " vs " + stb.str(record_bytes) + " bytes]");
+		records.insert(records.end(), buffer, buffer + nbytes);
+		return n ++;
+	}
+
+	//SERIALIZE THE CURRENT BLOCK WITH ROOM FOR [nv] RECORDS [missing records zeroed]
+	void encode(uint32_t nv, std::vector < char > & out) const {
+		const uint32_t S = record_bytes, T = tile_haps, n_tiles = tiled_block::count(S, T);
+		out.assign(tiled_block::size(nv, S, T), 0);
+		uint32_t head [4] = { nv, S, T, n_tiles };
+		memcpy(out.data(), head, TILE_HEADER);
+		uint64_t o = tiled_block::headerBytes(S, T);
+		for (uint32_t t = 0 ; t < n_tiles ; t ++) {
+			const uint32_t w = tiled_block::width(t, S, T);
+			memcpy(out.data() + TILE_HEADER + t * sizeof(uint64_t), &o, sizeof(uint64_t));
+			for (uint32_t v = 0 ; v < n ; v ++) memcpy(out.data() + o + (uint64_t)v * w, records.data() + (uint64_t)v * S + t * (T / 8), w);
+			o += (uint64_t)nv * w;
+		}
+	}
+
+	void clear() {
+		n = 0;
+		records.clear();
+	}
+};
+
+class tiled_block_reader {
+public:
+	uint64_t offset;							//Location of the loaded block [max: none]
+	uint32_t n_variants;
+	uint32_t record_bytes;
+	uint32_t tile_haps;
+	uint32_t n_tiles;
+	std::vector < uint64_t > tile_offset;		//Location of the tiles from block start
+	std::vector < uint64_t > tile_pos;			//Location of the loaded tiles in [data] [max: not loaded]
+	std::vector < char > data;
+	std::vector < bool > projection;			//Haplotypes to fetch [empty: all]
+	uint64_t bytes_read, bytes_full;			//Bytes fetched versus bytes of the blocks
+
+	tiled_block_reader() : offset(std::numeric_limits < uint64_t >::max()), n_variants(0), record_bytes(0), tile_haps(0), n_tiles(0), bytes_read(0), bytes_full(0) {
+	}
+
+	//RESTRICT READS TO THE HAPLOTYPES OF [samples] [2 per sample]
+	void setProjection(uint32_t n_samples, const std::vector < int32_t > & samples) {
+		projection.assign(2 * n_samples, false);
+		for (auto i : samples) projection[2*i+0] = projection[2*i+1] = true;
+		offset = std::numeric_limits < uint64_t >::max();
+	}
+
+	bool needed(uint32_t t) const {
+		if (projection.empty()) return true;
+		const uint32_t h1 = std::min((uint64_t)(t + 1) * tile_haps, (uint64_t)projection.size());
+		for (uint32_t h = t * tile_haps ; h < h1 ; h ++) if (projection[h]) return true;
+		return false;
+	}
+
+	//PARSE THE FIXED PART OF A BLOCK HEADER, RETURNS THE BYTES OF THE TILE OFFSETS THAT FOLLOW
+	uint64_t parseHeader(const char * head) {
+		uint32_t h [4];
+		memcpy(h, head, TILE_HEADER);
+		n_variants = h[0]; record_bytes = h[1]; tile_haps = h[2]; n_tiles = h[3];
+		if (tile_haps == 0 || tile_haps % 8 || n_tiles != tiled_block::count(record_bytes, tile_haps)) vrb.error("Corrupted tiled block header");
+		return n_tiles * sizeof(uint64_t);
+	}
+
+	void parseOffsets(const char * offsets) {
+		tile_offset.resize(n_tiles);
+		memcpy(tile_offset.data(), offsets, n_tiles * sizeof(uint64_t));
+		tile_pos.assign(n_tiles, std::numeric_limits < uint64_t >::max());
+		data.clear();
+	}
+
+	//BYTES OF TILE [t] FOR ALL RECORDS OF THE BLOCK
+	uint64_t tileBytes(uint32_t t) const {
+		return (uint64_t)n_variants * tiled_block::width(t, record_bytes, tile_haps);
+	}
+
+	//APPEND TILES [t0, t1) READ IN ONE RANGE
+	void addTiles(uint32_t t0, uint32_t t1, const char * src) {
+		uint64_t o = data.size(), n_bytes = 0;
+		for (uint32_t t = t0 ; t < t1 ; t ++) { tile_pos[t] = o + n_bytes; n_bytes += tileBytes(t); }
+		data.insert(data.end(), src, src + n_bytes);
+		bytes_read += n_bytes;
+	}
+
+	//RECORD [index] OF THE LOADED BLOCK INTO [out], TILES NOT LOADED ARE ZEROED
+	void gather(uint32_t index, char * out) const {
+		if (index >= n_variants) vrb.error("Tiled record out of block [" + stb.str(index) + " >= " + stb.str(n_variants) + "]");
+		for (uint32_t t = 0 ; t < n_tiles ; t ++) {
+			const uint32_t w = tiled_block::width(t, record_bytes, tile_haps);
+			if (tile_pos[t] == std::numeric_limits < uint64_t >::max()) memset(out + t * (tile_haps / 8), 0, w);
+			else memcpy(out + t * (tile_haps / 8), data.data() + tile_pos[t] + (uint64_t)index * w, w);
+		}
+	}
+};
+
+#endif
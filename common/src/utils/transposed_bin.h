@@ -0,0 +1,333 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _TRANSPOSED_BIN_H
+#define _TRANSPOSED_BIN_H
+
+#include <fstream>
+#include <cstring>
+#include <vector>
+
+#include "otools.h"
+
+extern "C" {
+	#include <htslib/vcf.h>
+}
+
+#define TBIN_MAGIC			"XCFTBIN1"			//Magic string of .tbin files
+#define TBIN_VERSION		1
+#define TBIN_BLOCK			4096				//Default number of variants per tile [multiple of 64]
+#define TBIN_TILE_HAPS		64					//Number of haplotypes per tile
+
+#define TBIN_PHASED			1					//Variant flag: genotypes are phased
+#define TBIN_HAPLOID		2					//Variant flag: samples of ploidy 1 carry a single allele
+#define TBIN_NOGT			4					//Variant flag: no genotype available [e.g. dosage record]
+
+#define TBIN_TILE_MISSING	1					//Tile flag: a missing plane follows the allele plane
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						TRANSPOSED_BIN								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Sample-major companion of a XCF file (.tbin), built by [xcftools transpose]. Variants are those of the
+//BCF file of the XCF, in the same order, and are cut into blocks of [block] variants. Each block is cut
+//into tiles of 64 haplotypes (haplotypes 2i and 2i+1 belong to sample i) stored as bit-matrices where a
+//haplotype is contiguous across the variants of the block:
+//
+//	[Header]	magic (8 bytes) | version (u32) | n_samples (u32) | block (u32) | ploidy (u8 x n_samples)
+//	[Tiles]		for each variant block, for each haplotype block: allele plane, then missing plane if flagged.
+//				A plane is 64 rows of block/64 u64; bit b of word w in row h is variant 64w+b of the block
+//				for haplotype h of the tile. Rows and bits beyond the last haplotype / variant are zero.
+//	[Footer]	n_variants (u64) | variant flags (u8 x n_variants) | tile offsets (u64 x n_tiles) |
+//				tile flags (u8 x n_tiles) | footer offset (u64)
+//
+//Reading the genotypes of a sample therefore costs 2 rows per variant block, instead of a full record
+//per variant in the .bin file.
+
+namespace transposed_bin
+{
+	inline std::string filename(std::string xcf_fname) {
+		return stb.remove_extension(xcf_fname) + ".tbin";
+	}
+
+	//TRANSPOSE A 64x64 BIT-MATRIX IN PLACE [bit c of row r moves to bit r of row c]
+	inline void transpose64(uint64_t * a) {
+		uint64_t m = 0x00000000FFFFFFFFULL;
+		for (uint32_t j = 32 ; j != 0 ; j >>= 1, m ^= (m << j)) {
+			for (uint32_t k = 0 ; k < 64 ; k = ((k | j) + 1) & ~j) {
+				uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+				a[k] ^= (t << j);
+				a[k | j] ^= t;
+			}
+		}
+	}
+}
+
+class transposed_writer {
+public:
+	std::ofstream fd;
+	std::string fname;
+	uint32_t n_samples;
+	uint32_t n_hblocks;							//Number of haplotype blocks [tiles per variant block]
+	uint32_t block;								//Number of variants per tile
+	uint32_t n_words;							//Number of u64 per row [block/64]
+	uint64_t n_variants;
+	std::vector < uint8_t > flags;				//Variant flags
+	std::vector < uint64_t > tile_offset;
+	std::vector < uint8_t > tile_flags;
+
+	//Current group of 64 variants, variant-major [64 x n_hblocks words]
+	uint32_t n_group;
+	std::vector < uint64_t > group_allele;
+	std::vector < uint64_t > group_missing;
+
+	//Current variant block, haplotype-major [64 * n_hblocks rows of n_words]
+	uint32_t n_block;
+	std::vector < uint64_t > rows_allele;
+	std::vector < uint64_t > rows_missing;
+
+	transposed_writer() : n_samples(0), n_hblocks(0), block(TBIN_BLOCK), n_words(TBIN_BLOCK / 64), n_variants(0), n_group(0), n_block(0) {
+	}
+
+	~transposed_writer() {
+	}
+
+	bool open(std::string _fname, const std::vector < uint8_t > & ploidy, uint32_t _block = TBIN_BLOCK) {
+		if (std::endian::native != std::endian::little) return false;
+		if (_block == 0 || _block % 64) return false;
+		fname = _fname;
+		fd.open(fname.c_str(), std::ios::out | std::ios::binary);
+		if (!fd) return false;
+		n_samples = ploidy.size();
+		n_hblocks = (2 * n_samples + TBIN_TILE_HAPS - 1) / TBIN_TILE_HAPS;
+		block = _block;
+		n_words = block / 64;
+		group_allele = std::vector < uint64_t > (64 * n_hblocks, 0);
+		group_missing = std::vector < uint64_t > (64 * n_hblocks, 0);
+		rows_allele = std::vector < uint64_t > (TBIN_TILE_HAPS * n_hblocks * n_words, 0);
+		rows_missing = std::vector < uint64_t > (TBIN_TILE_HAPS * n_hblocks * n_words, 0);
+		uint32_t version = TBIN_VERSION;
+		fd.write(TBIN_MAGIC, 8);
+		fd.write((char*)&version, sizeof(uint32_t));
+		fd.write((char*)&n_samples, sizeof(uint32_t));
+		fd.write((char*)&block, sizeof(uint32_t));
+		fd.write((const char*)ploidy.data(), n_samples);
+		return fd.good();
+	}
+
+	bool isOpen() const {
+		return fd.is_open();
+	}
+
+	//ADD A VARIANT FROM ITS BCF GENOTYPES [2 values per sample, bcf_int32_vector_end for haploid ones]
+	void push(const int32_t * gt) {
+		uint8_t f = TBIN_PHASED;
+		uint64_t * allele = group_allele.data() + n_group * n_hblocks;
+		uint64_t * missing = group_missing.data() + n_group * n_hblocks;
+		for (uint32_t i = 0 ; i < n_samples ; i ++) {
+			if (gt[2*i+1] == bcf_int32_vector_end) {
+				f |= TBIN_HAPLOID;
+				if (bcf_gt_is_missing(gt[2*i+0])) missing[(2*i) / 64] |= 1ULL << ((2*i) % 64);
+				else if (bcf_gt_allele(gt[2*i+0])) allele[(2*i) / 64] |= 1ULL << ((2*i) % 64);
+				continue;
+			}
+			bool mi = bcf_gt_is_missing(gt[2*i+0]) || bcf_gt_is_missing(gt[2*i+1]);
+			if (!mi && !bcf_gt_is_phased(gt[2*i+1])) f &= ~TBIN_PHASED;
+			for (uint32_t h = 2*i ; h < 2*i+2 ; h ++) {
+				if (bcf_gt_is_missing(gt[h])) missing[h / 64] |= 1ULL << (h % 64);
+				else if (bcf_gt_allele(gt[h])) allele[h / 64] |= 1ULL << (h % 64);
+			}
+		}
+		next(f);
+	}
+
+	//ADD A VARIANT WITHOUT GENOTYPES [all alleles missing]
+	void pushVoid() {
+		uint64_t * missing = group_missing.data() + n_group * n_hblocks;
+		for (uint32_t h = 0 ; h < 2 * n_samples ; h ++) missing[h / 64] |= 1ULL << (h % 64);
+		next(TBIN_NOGT);
+	}
+
+	void next(uint8_t f) {
+		flags.push_back(f);
+		n_variants ++;
+		if (++n_group == 64) flushGroup();
+		if (n_block == block) flushBlock();
+	}
+
+	//Transpose the 64 variants of the group into the rows of the current block
+	void flushGroup() {
+		if (n_group == 0) return;
+		uint64_t a [64];
+		const uint32_t w = n_block / 64;
+		std::vector < uint64_t > * src [2] = { &group_allele, &group_missing };
+		std::vector < uint64_t > * dst [2] = { &rows_allele, &rows_missing };
+		for (uint32_t p = 0 ; p < 2 ; p ++) {
+			for (uint32_t hb = 0 ; hb < n_hblocks ; hb ++) {
+				for (uint32_t v = 0 ; v < 64 ; v ++) a[v] = (*src[p])[v * n_hblocks + hb];
+				transposed_bin::transpose64(a);
+				for (uint32_t h = 0 ; h < 64 ; h ++) (*dst[p])[(hb * TBIN_TILE_HAPS + h) * n_words + w] = a[h];
+			}
+			std::fill(src[p]->begin(), src[p]->end(), 0);
+		}
+		n_block += 64;
+		n_group = 0;
+	}
+
+	//Write the tiles of the current block
+	void flushBlock() {
+		if (n_block == 0) return;
+		const uint32_t n_tile = TBIN_TILE_HAPS * n_words;
+		for (uint32_t hb = 0 ; hb < n_hblocks ; hb ++) {
+			const uint64_t * allele = rows_allele.data() + hb * n_tile;
+			const uint64_t * missing = rows_missing.data() + hb * n_tile;
+			bool has_missing = false;
+			for (uint32_t k = 0 ; k < n_tile && !has_missing ; k ++) has_missing = (missing[k] != 0);
+			tile_offset.push_back(fd.tellp());
+			tile_flags.push_back(has_missing ? TBIN_TILE_MISSING : 0);
+			fd.write((const char*)allele, n_tile * sizeof(uint64_t));
+			if (has_missing) fd.write((const char*)missing, n_tile * sizeof(uint64_t));
+		}
+		std::fill(rows_allele.begin(), rows_allele.end(), 0);
+		std::fill(rows_missing.begin(), rows_missing.end(), 0);
+		n_block = 0;
+	}
+
+	//Write the last partial block and the footer
+	bool close() {
+		flushGroup();
+		flushBlock();
+		uint64_t footer = fd.tellp();
+		fd.write((char*)&n_variants, sizeof(uint64_t));
+		fd.write((const char*)flags.data(), flags.size());
+		fd.write((const char*)tile_offset.data(), tile_offset.size() * sizeof(uint64_t));
+		fd.write((const char*)tile_flags.data(), tile_flags.size());
+		fd.write((char*)&footer, sizeof(uint64_t));
+		bool ok = fd.good();
+		fd.close();
+		return ok;
+	}
+};
+
+class transposed_reader {
+public:
+	std::ifstream fd;
+	uint32_t n_samples;
+	uint32_t n_hblocks;
+	uint32_t block;
+	uint32_t n_words;
+	uint64_t n_variants;
+	uint64_t n_vblocks;
+	std::vector < uint8_t > ploidy;
+	std::vector < uint8_t > flags;
+	std::vector < uint64_t > tile_offset;
+	std::vector < uint8_t > tile_flags;
+
+	//Rows of the last read
+	std::vector < uint64_t > row_allele;
+	std::vector < uint64_t > row_missing;
+
+	transposed_reader() : n_samples(0), n_hblocks(0), block(0), n_words(0), n_variants(0), n_vblocks(0) {
+	}
+
+	~transposed_reader() {
+	}
+
+	//Open companion file and read its index / Returns false when missing or unreadable
+	bool open(std::string fname) {
+		if (std::endian::native != std::endian::little) return false;
+		fd.open(fname.c_str(), std::ios::in | std::ios::binary);
+		if (!fd) return false;
+		char magic[8];
+		uint32_t version = 0;
+		fd.read(magic, 8);
+		fd.read((char*)&version, sizeof(uint32_t));
+		fd.read((char*)&n_samples, sizeof(uint32_t));
+		fd.read((char*)&block, sizeof(uint32_t));
+		if (!fd || memcmp(magic, TBIN_MAGIC, 8) || version != TBIN_VERSION || block == 0 || block % 64) return false;
+		ploidy.resize(n_samples);
+		fd.read((char*)ploidy.data(), n_samples);
+		n_hblocks = (2 * n_samples + TBIN_TILE_HAPS - 1) / TBIN_TILE_HAPS;
+		n_words = block / 64;
+
+		//Footer
+		uint64_t footer = 0;
+		fd.seekg(-(int)sizeof(uint64_t), fd.end);
+		fd.read((char*)&footer, sizeof(uint64_t));
+		fd.seekg(footer, fd.beg);
+		fd.read((char*)&n_variants, sizeof(uint64_t));
+		n_vblocks = (n_variants + block - 1) / block;
+		flags.resize(n_variants);
+		tile_offset.resize(n_vblocks * n_hblocks);
+		tile_flags.resize(n_vblocks * n_hblocks);
+		fd.read((char*)flags.data(), n_variants);
+		fd.read((char*)tile_offset.data(), tile_offset.size() * sizeof(uint64_t));
+		fd.read((char*)tile_flags.data(), tile_flags.size());
+		row_allele.resize(n_words);
+		row_missing.resize(n_words);
+		return fd.good();
+	}
+
+	//READ THE ALLELE AND MISSING ROWS OF HAPLOTYPE [h] IN VARIANT BLOCK [vb]
+	bool readRow(uint32_t h, uint64_t vb, uint64_t * allele, uint64_t * missing) {
+		const uint64_t t = vb * n_hblocks + h / TBIN_TILE_HAPS;
+		const uint64_t row = (h % TBIN_TILE_HAPS) * n_words * sizeof(uint64_t);
+		fd.seekg(tile_offset[t] + row, fd.beg);
+		fd.read((char*)allele, n_words * sizeof(uint64_t));
+		if (tile_flags[t] & TBIN_TILE_MISSING) {
+			fd.seekg(tile_offset[t] + TBIN_TILE_HAPS * n_words * sizeof(uint64_t) + row, fd.beg);
+			fd.read((char*)missing, n_words * sizeof(uint64_t));
+		} else std::fill(missing, missing + n_words, 0);
+		return fd.good();
+	}
+
+	//BCF GENOTYPES OF SAMPLE [i] FOR ALL VARIANTS [2 values per variant, bcf_int32_vector_end for haploid calls]
+	bool readSample(uint32_t i, std::vector < int32_t > & gt) {
+		if (i >= n_samples) return false;
+		gt.resize(2 * n_variants);
+		for (uint64_t vb = 0 ; vb < n_vblocks ; vb ++) {
+			const uint64_t v0 = vb * block, v1 = std::min(n_variants, v0 + block);
+			for (uint32_t k = 0 ; k < 2 ; k ++) {
+				if (!readRow(2 * i + k, vb, row_allele.data(), row_missing.data())) return false;
+				for (uint64_t v = v0 ; v < v1 ; v ++) {
+					const uint32_t b = v - v0;
+					if (k == 1 && ploidy[i] == 1 && (flags[v] & TBIN_HAPLOID)) gt[2*v+k] = bcf_int32_vector_end;
+					else if ((row_missing[b / 64] >> (b % 64)) & 1ULL) gt[2*v+k] = bcf_gt_missing;
+					else if (flags[v] & TBIN_PHASED) gt[2*v+k] = bcf_gt_phased((row_allele[b / 64] >> (b % 64)) & 1ULL);
+					else gt[2*v+k] = bcf_gt_unphased((row_allele[b / 64] >> (b % 64)) & 1ULL);
+				}
+			}
+		}
+		return true;
+	}
+
+	void close() {
+		fd.close();
+	}
+};
+
+#endif
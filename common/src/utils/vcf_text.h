@@ -0,0 +1,260 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _VCF_TEXT_H
+#define _VCF_TEXT_H
+
+#include <cstring>
+#include <cstdint>
+#include <array>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "otools.h"
+
+extern "C" {
+	#include <htslib/vcf.h>
+	#include <htslib/tbx.h>
+	#include <htslib/kstring.h>
+}
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						VCF_TEXT_PARSER								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Parsing of VCF text lines restricted to what the conversion to XCF reads: site columns, FORMAT/GT and optionally
+//FORMAT/PP. Site columns go through vcf_parse, sample columns are scanned here and stored in the bcf1_t as vcf_parse
+//would store them: GT on int8 [(allele+1)<<1|phased, 0 when missing, bcf_int8_vector_end after a haploid allele],
+//PP on floats. Other FORMAT fields are dropped. Lines outside of this path [GT not first, multi-digit alleles,
+//polyploid genotypes, wrong number of samples] are handed to vcf_parse in full.
+//
+//Sample columns made of a GT only ["a|b" and a tab, 4 bytes] are checked and converted 8 at a time with AVX2, the
+//end of longer columns is found 32 bytes at a time.
+
+class vcf_text_parser {
+public:
+	const bcf_hdr_t * hdr;
+	uint32_t n_samples;
+	bool enabled;				//Header compatible with the fast path
+	int32_t key_gt;				//Header ID of FORMAT/GT
+	int32_t key_pp;				//Header ID of FORMAT/PP [-1 when not parsed]
+	kstring_t text;				//Line read
+	kstring_t site;				//Site columns of the line
+	std::vector < int8_t > gt;
+	std::vector < float > pp;
+
+	//Counters
+	uint64_t n_fast;			//Lines parsed on GT/PP only
+	uint64_t n_full;			//Lines handed to vcf_parse
+	uint64_t n_simd;			//Samples converted 8 at a time
+
+	vcf_text_parser() : hdr(NULL), n_samples(0), enabled(false), key_gt(-1), key_pp(-1), n_fast(0), n_full(0), n_simd(0) {
+		text.l = text.m = site.l = site.m = 0;
+		text.s = site.s = NULL;
+	}
+
+	~vcf_text_parser() {
+		free(text.s);
+		free(site.s);
+	}
+
+	//SET THE HEADER OF THE FILE, [with_pp] TO KEEP FORMAT/PP
+	void init(const bcf_hdr_t * _hdr, bool with_pp) {
+		hdr = _hdr;
+		n_samples = bcf_hdr_nsamples(hdr);
+		key_gt = bcf_hdr_id2int(hdr, BCF_DT_ID, "GT");
+		key_pp = with_pp ? bcf_hdr_id2int(hdr, BCF_DT_ID, "PP") : -1;
+		if (key_pp >= 0 && !bcf_hdr_idinfo_exists(hdr, BCF_HL_FMT, key_pp)) key_pp = -1;
+		enabled = (n_samples > 0 && key_gt >= 0 && bcf_hdr_idinfo_exists(hdr, BCF_HL_FMT, key_gt));
+		if (key_pp >= 0 && bcf_hdr_id2type(hdr, BCF_HL_FMT, key_pp) != BCF_HT_REAL) enabled = false;
+		gt.resize(2 * n_samples);
+		pp.resize(n_samples);
+	}
+
+	//INT8 GT VALUE OF AN ALLELE CHARACTER [single digit or missing, -1 otherwise]
+	static const std::array < int8_t, 256 > & codes() {
+		static const std::array < int8_t, 256 > table = [] {
+			std::array < int8_t, 256 > t;
+			t.fill(-1);
+			for (int32_t d = 0 ; d < 10 ; d ++) t['0' + d] = (d + 1) << 1;
+			t['.'] = 0;
+			return t;
+		} ();
+		return table;
+	}
+
+#if defined(__AVX2__)
+	//8 SAMPLE COLUMNS "a|b\t" FROM [p] INTO 16 GT VALUES / Returns false when one column has another shape
+	static inline bool scan8(const char * p, int8_t * out) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast < const __m256i * > (p));
+		const __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+		const __m256i pipe = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|'));
+		const uint32_t m_digit = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit));
+		const uint32_t m_sep = _mm256_movemask_epi8(_mm256_or_si256(pipe, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))));
+		const uint32_t m_tab = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+		if ((m_digit & 0x55555555U) != 0x55555555U || (m_sep & 0x22222222U) != 0x22222222U || (m_tab & 0x88888888U) != 0x88888888U) return false;
+
+		//(allele+1)<<1, phase bit moved from the separator to the second allele, then alleles packed
+		__m256i code = _mm256_add_epi8(_mm256_add_epi8(digit, digit), _mm256_set1_epi8(2));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_slli_si256(pipe, 1), _mm256_set1_epi8(1)));
+		const __m256i alleles = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1, 0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+		code = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(code, alleles), 0x08);
+		_mm_storeu_si128(reinterpret_cast < __m128i * > (out), _mm256_castsi256_si128(code));
+		return true;
+	}
+#endif
+
+	//FIRST TAB IN [q, end), end WHEN NONE [columns are short: inlined 32 bytes at a time rather than memchr]
+	static inline const char * nextTab(const char * q, const char * end) {
+#if defined(__AVX2__)
+		const __m256i tab = _mm256_set1_epi8('\t');
+		for (; q + 32 <= end ; q += 32) {
+			uint32_t m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast < const __m256i * > (q)), tab));
+			if (m) return q + __builtin_ctz(m);
+		}
+#endif
+		while (q < end && *q != '\t') q ++;
+		return q;
+	}
+
+	//GT [and PP field pp_field] OF ALL SAMPLE COLUMNS IN [p, end) / Returns false when outside of the fast path
+	bool parseSamples(const char * p, const char * end, int32_t pp_field, uint32_t & width) {
+		const std::array < int8_t, 256 > & code = codes();
+		bool diploid = false, haploid = false;
+		uint32_t i = 0;
+		while (i < n_samples && p < end) {
+#if defined(__AVX2__)
+			if (pp_field < 0) {
+				for (; i + 8 <= n_samples && p + 32 <= end && scan8(p, &gt[2 * i]) ; i += 8, p += 32) {
+					n_simd += 8;
+					diploid = true;
+				}
+				if (i == n_samples) break;
+			}
+#endif
+			//One sample column: GT first, then PP when asked for
+			const int8_t a0 = code[(uint8_t)p[0]];
+			if (a0 < 0) return false;
+			const char * q = p + 1;
+			if (q < end && (*q == '|' || *q == '/')) {
+				const int8_t a1 = (q + 1 < end) ? code[(uint8_t)q[1]] : -1;
+				if (a1 < 0) return false;
+				gt[2*i+0] = a0;
+				gt[2*i+1] = a1 | (*q == '|');
+				q += 2;
+				diploid = true;
+			} else {
+				gt[2*i+0] = a0;
+				gt[2*i+1] = bcf_int8_vector_end;
+				haploid = true;
+			}
+			if (q < end && *q != ':' && *q != '\t') return false;
+
+			if (pp_field >= 0) {
+				float v;
+				bcf_float_set_missing(v);
+				for (int32_t f = 1 ; q < end && *q == ':' ; f ++) {
+					const char * e = ++q;
+					while (e < end && *e != ':' && *e != '\t') e ++;
+					if (f == pp_field && e > q && !(e - q == 1 && *q == '.')) v = strtof(q, NULL);
+					q = e;
+				}
+				pp[i] = v;
+			}
+
+			q = nextTab(q, end);
+			p = (q < end) ? q + 1 : end;
+			i ++;
+		}
+		if (i != n_samples || p < end) return false;
+
+		//Lines with haploid genotypes only are stored on 1 value per sample
+		width = (haploid && !diploid) ? 1 : 2;
+		if (width == 1) for (i = 0 ; i < n_samples ; i ++) gt[i] = gt[2*i];
+		return true;
+	}
+
+	//PARSE LINE [s] INTO [line] / Returns false on a malformed line
+	bool parse(kstring_t & s, bcf1_t * line) {
+		if (!enabled) return full(s, line);
+
+		//FORMAT column and first sample column
+		char * end = s.s + s.l;
+		char * format = s.s;
+		for (uint32_t c = 0 ; c < 8 && format ; c ++) {
+			format = static_cast < char * > (memchr(format, '\t', end - format));
+			if (format) format ++;
+		}
+		char * samples = format ? static_cast < char * > (memchr(format, '\t', end - format)) : NULL;
+		if (!samples || strncmp(format, "GT", 2) || (format[2] != ':' && format[2] != '\t')) return full(s, line);
+		samples ++;
+
+		//Field of PP in the FORMAT column
+		int32_t pp_field = -1;
+		if (key_pp >= 0) for (char * f = format, * e = format ; f < samples && pp_field < 0 ; f = ++e) {
+			while (*e != ':' && *e != '\t') e ++;
+			if (e - f == 2 && f[0] == 'P' && f[1] == 'P') pp_field = std::count(format, f, ':');
+		}
+
+		uint32_t width = 2;
+		if (!parseSamples(samples, end, pp_field, width)) return full(s, line);
+
+		//Site columns, then FORMAT fields appended the way vcf_parse stores them
+		site.l = 0;
+		kputsn(s.s, format - 1 - s.s, &site);
+		if (vcf_parse(&site, hdr, line) != 0) return false;
+		bcf_enc_int1(&line->indiv, key_gt);
+		bcf_enc_size(&line->indiv, width, BCF_BT_INT8);
+		kputsn(reinterpret_cast < char * > (gt.data()), width * n_samples, &line->indiv);
+		if (pp_field >= 0) {
+			bcf_enc_int1(&line->indiv, key_pp);
+			bcf_enc_size(&line->indiv, 1, BCF_BT_FLOAT);
+			kputsn(reinterpret_cast < char * > (pp.data()), n_samples * sizeof(float), &line->indiv);
+		}
+		line->n_fmt = 1 + (pp_field >= 0);
+		line->n_sample = n_samples;
+		n_fast ++;
+		return true;
+	}
+
+	//PARSE THE WHOLE LINE WITH HTSLIB
+	bool full(kstring_t & s, bcf1_t * line) {
+		n_full ++;
+		return (vcf_parse(&s, hdr, line) == 0);
+	}
+
+	//READ AND PARSE THE NEXT LINE OF [fp] INTO [line] [whole file, or tabix iterator when itr is set]
+	// Returns 0, -1 at the end of the file/region, < -1 on error
+	int32_t read(htsFile * fp, tbx_t * tbx, hts_itr_t * itr, bcf1_t * line) {
+		int32_t ret = itr ? tbx_itr_next(fp, tbx, itr, &text) : hts_getline(fp, KS_SEP_LINE, &text);
+		if (ret < 0) return ret;
+		return parse(text, line) ? 0 : -2;
+	}
+};
+
+#endif
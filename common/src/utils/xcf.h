@@ -35,18 +35,45 @@
 #include <chrono>
 #include <iomanip>
 #include <map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "otools.h"
+#include "binary_io.h"
+#include "binary_index.h"
+#include "ordinal_index.h"
+#include "binary_deflate.h"
+#include "sparse_codec.h"
+#include "pbwt_codec.h"
+#include "dosage_codec.h"
+#include "phaseprob_codec.h"
+#include "tiled_block.h"
 
 //INCLUDE HTS LIBRARY
 extern "C" {
 	#include <htslib/synced_bcf_reader.h>
 }
 
+#include "ploidy_mask.h"
+#include "vcf_text.h"
+
 #define FILE_VOID	0					//No data
 #define FILE_BCF	1					//Data in BCF file
 #define FILE_BINARY	2					//Data in Binary file
 
+#define XCF_READ_UNDECIDED	-1				//Reading mode chosen at first record
+#define XCF_READ_SYNCED		0				//Synchronized reader [multiple files or seek]
+#define XCF_READ_SEQUENTIAL	1				//Single file, whole file with bcf_read
+#define XCF_READ_INDEXED	2				//Single file, region with index iterator
+
+#define XCF_DECODE_SLOTS	32				//Records decoded ahead by the decoding thread
+
+#define XCF_ASYNC_BATCHES	3				//Batches of output in flight with the asynchronous writer
+#define XCF_ASYNC_RECORDS	4096			//Records per batch
+#define XCF_ASYNC_BYTES		(16*1024*1024)	//Binary payload bytes per batch
+
 #define RECORD_VOID				0		//No record
 #define RECORD_BCFVCF_GENOTYPE	1		//Record in BCF GT format
 #define RECORD_SPARSE_GENOTYPE	2		//Record in sparse genotype format (see rare_genotype.h)
@@ -54,10 +81,22 @@ extern "C" {
 #define RECORD_BINARY_GENOTYPE	4		//Record in binary genotype format (2bits per genotype; 10 for missing)
 #define RECORD_BINARY_HAPLOTYPE	5		//Record in binary haplotype format (1bit per allele; no missing allowed)
 #define RECORD_SPARSE_PHASEPROBS 6		//Extension of sparse genotype format that includes the float (see [rare/sparse]_genotype.h)
-#define RECORD_NUMBER_TYPES		7
+#define RECORD_SPARSE_GENOTYPE_VB 7		//Sparse genotype format, delta coded with variable byte lengths (see sparse_codec.h)
+#define RECORD_SPARSE_HAPLOTYPE_VB 8	//Sparse haplotype format, delta coded with variable byte lengths (see sparse_codec.h)
+#define RECORD_PBWT_HAPLOTYPE	9		//Binary haplotype format, coded as allele runs in PBWT order (see pbwt_codec.h)
+#define RECORD_BINARY_MIXED		10		//Binary haplotype format on the ploidy of the .fam (1bit per allele; see ploidy_mask.h)
+#define RECORD_SPARSE_MIXED		11		//Sparse haplotype format on the ploidy of the .fam, with missing alleles (see ploidy_mask.h)
+#define RECORD_DENSE_DOSAGE		12		//Dosages in 8 or 16 bits fixed point, one per sample (see dosage_codec.h)
+#define RECORD_SPARSE_DOSAGE	13		//Dosages in 8 or 16 bits fixed point, samples away from the major dosage only (see dosage_codec.h)
+#define RECORD_SPARSE_PHASEPROBS_FP 14	//Sparse genotype format with phase probabilities in 8 or 16 bits fixed point (see phaseprob_codec.h)
+#define RECORD_BINARY_HAPLOTYPE_TILED 15	//Binary haplotype format, stored in 2D tiled blocks (see tiled_block.h)
+#define RECORD_BINARY_GENOTYPE_TILED 16	//Binary genotype format, stored in 2D tiled blocks (see tiled_block.h)
+#define RECORD_NUMBER_TYPES		17
 
 #define MOD30BITS			0x40000000
 
+#define XCF_BATCH_MAX_BYTES	(64*1024*1024)	//Default cap on payload bytes per batch
+
 /*****************************************************************************/
 /*****************************************************************************/
 /******						XCF_UTILS									******/
@@ -120,6 +159,40 @@ namespace helper_tools
 		return tokens.size();
 	}
 
+	//Parses a region [chr, chr:beg, chr:beg- or chr:beg-end] with 1-based inclusive bounds; end is 0 when open.
+	//A suffix that is not a valid interval is taken as part of the contig name [e.g. HLA contigs]
+	inline bool parseRegion(const std::string & region, std::string & chr, uint64_t & beg, uint64_t & end) {
+		chr = region; beg = 1; end = 0;
+		if (region.empty() || region.find(',') != std::string::npos) return false;
+		size_t colon = region.find_last_of(':');
+		if (colon == std::string::npos || colon == 0) return true;
+		std::string bounds = region.substr(colon + 1);
+		size_t dash = bounds.find('-');
+		std::string sbeg = bounds.substr(0, dash), send = (dash == std::string::npos) ? "" : bounds.substr(dash + 1);
+		auto number = [](const std::string & s, uint64_t & v) {
+			if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos || s.size() > 18) return false;
+			v = std::stoull(s);
+			return true;
+		};
+		uint64_t b = 0, e = 0;
+		if (!number(sbeg, b) || (!send.empty() && !number(send, e))) return true;
+		if (b == 0 || (e && e < b)) return false;
+		chr = region.substr(0, colon); beg = b; end = e;
+		return true;
+	}
+
+	//Parses a comma separated list of regions [see parseRegion]
+	inline bool parseRegions(const std::string & regions, std::vector < std::string > & chr, std::vector < uint64_t > & beg, std::vector < uint64_t > & end) {
+		std::vector < std::string > tokens;
+		for (size_t p = 0, q = 0 ; q != std::string::npos ; p = q + 1) {
+			q = regions.find(',', p);
+			tokens.push_back(regions.substr(p, q == std::string::npos ? q : q - p));
+		}
+		chr.assign(tokens.size(), ""); beg.assign(tokens.size(), 1); end.assign(tokens.size(), 0);
+		for (size_t r = 0 ; r < tokens.size() ; r ++) if (!parseRegion(tokens[r], chr[r], beg[r], end[r])) return false;
+		return true;
+	}
+
 	inline void error(std::string s) {
 		vrb.error(s);
 	}
@@ -136,8 +209,86 @@ namespace helper_tools
 	    return ss.str();
 	}
 
+	//Varint coded sparse records decode to the index arrays of their plain counterparts
+	//PBWT and tiled records are read back by xcf_reader as plain binary records
+	inline int32_t plainType(int32_t type) {
+		if (type == RECORD_SPARSE_GENOTYPE_VB) return RECORD_SPARSE_GENOTYPE;
+		if (type == RECORD_SPARSE_HAPLOTYPE_VB) return RECORD_SPARSE_HAPLOTYPE;
+		if (type == RECORD_PBWT_HAPLOTYPE) return RECORD_BINARY_HAPLOTYPE;
+		if (type == RECORD_BINARY_HAPLOTYPE_TILED) return RECORD_BINARY_HAPLOTYPE;
+		if (type == RECORD_BINARY_GENOTYPE_TILED) return RECORD_BINARY_GENOTYPE;
+		return type;
+	}
+
+	inline bool isTiled(int32_t type) {
+		return (type == RECORD_BINARY_HAPLOTYPE_TILED || type == RECORD_BINARY_GENOTYPE_TILED);
+	}
 }
 
+/*****************************************************************************/
+/*****************************************************************************/
+/******						XCF_BATCH									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Block of consecutive variants of one binary file, stored column-wise.
+//Payloads are contiguous: record i is at data(i) and is size[i] bytes long.
+class xcf_batch {
+public:
+	uint32_t n;									//Number of variants in the batch
+
+	//Variant information
+	std::vector < std::string > chr;
+	std::vector < uint32_t > pos;
+	std::vector < std::string > ref;
+	std::vector < std::string > alt;
+	std::vector < std::string > rsid;
+	std::vector < uint32_t > AC;
+	std::vector < uint32_t > AN;
+
+	//Binary records
+	std::vector < int32_t > type;				//Type of Binary record
+	std::vector < uint64_t > seek;				//Location of Binary record in the binary file
+	std::vector < uint32_t > size;				//Size of Binary record in bytes
+	std::vector < uint64_t > offset;			//Location of Binary record in the payload block
+	std::vector < char > payload;				//Storage of the payload block when it is not a view
+	const char * base;							//Start of the payload block
+
+	xcf_batch() : n(0), base(NULL) {
+	}
+
+	void clear() {
+		n = 0;
+		chr.clear(); pos.clear(); ref.clear(); alt.clear(); rsid.clear(); AC.clear(); AN.clear();
+		type.clear(); seek.clear(); size.clear(); offset.clear();
+		base = NULL;
+	}
+
+	inline const char * data(uint32_t i) const { return base + offset[i]; }
+	inline float getAF(uint32_t i) const { return AC[i] * 1.0f / AN[i]; }
+};
+
+/*****************************************************************************/
+/*****************************************************************************/
+/******						XCF_SITE									******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Site decoded ahead of the consumer [slot of the decoding ring]
+class xcf_site {
+public:
+	bcf1_t * line;								//Unpacked record, owned by the slot
+	bool biallelic;
+	std::string chr, ref, alt, rsid;
+	uint32_t pos, AC, AN;
+	int32_t type;
+	uint64_t seek;
+	uint32_t size;
+
+	xcf_site() : line(NULL), biallelic(false), pos(0), AC(0), AN(0), type(RECORD_VOID), seek(0), size(0) {
+	}
+};
+
 /*****************************************************************************/
 /*****************************************************************************/
 /******						XCF_READER									******/
@@ -152,6 +303,29 @@ public:
 	std::vector < bcf1_t * > sync_lines;
 	std::vector < int32_t > sync_types;			//Type of data: [DATA_EMPTY, FILE_BCF, FILE_BINARY]
 	std::vector < bool > sync_flags;			//Has record?
+	std::string sync_region;					//Region given at construction
+
+	//Single file fast path [bypasses the synchronization when only one file is read]
+	int32_t single_mode;						//XCF_READ_UNDECIDED until the first record, then one of the XCF_READ_* modes
+	bool single_disabled;						//Set by seek(): jumps require the synchronized reader
+	bool single_done;							//No more records in the file/region
+	bcf1_t * single_line;						//Current record
+	hts_itr_t * single_itr;						//Index iterator on the region
+	hts_idx_t * single_idx;						//Index loaded for ordinal jumps [when not loaded by the synchronized reader]
+
+	//Ordinal indexes [variant k of a contig -> location], loaded on demand
+	std::vector < ordinal_index > ord_index;
+
+	//Decoding thread [single file fast path: records read, unpacked and parsed ahead in a SPSC ring]
+	bool decode_requested;						//Use the decoding thread when reading a single file
+	bool decode_running;						//Thread started
+	bool decode_holding;						//Consumer holds the slot at decode_tail
+	std::thread decode_worker;
+	std::vector < xcf_site > decode_ring;
+	std::atomic < uint64_t > decode_head;		//Slots published by the producer
+	std::atomic < uint64_t > decode_tail;		//Slots released by the consumer
+	std::atomic < bool > decode_eof;			//Producer reached the end of the file/region
+	std::atomic < bool > decode_stop;			//Consumer asks the producer to exit
 
 	//Variant information
 	bool multi;
@@ -170,12 +344,21 @@ public:
 	int32_t * vAN;
 	int32_t * vSK;
 
+	//FORMAT/GT [decoded for callers passing a fixed size buffer]
+	int32_t nGT;
+	int32_t * vGT;
+
+	//FORMAT field [dosages]
+	int32_t nFMT;
+	float * vFMT;
+
 	//Pedigree file
 	std::vector < uint32_t> ind_number;
 	std::vector < std::vector < std::string > > ind_names;
 	std::vector < std::vector < std::string > > ind_fathers;
 	std::vector < std::vector < std::string > > ind_mothers;
 	std::vector < std::vector < std::string > > ind_pops;
+	std::vector < std::vector < uint8_t > > ind_ploidy;	//5th column of the .fam [2 when absent]
 
 	//Binary files [files x types]
 	std::vector < std::ifstream > bin_fds;		//File Descriptors
@@ -184,9 +367,36 @@ public:
 	std::vector < uint32_t > bin_size;			//Amount of Binary records in bytes		//Integer 4 in INFO/SEEK field
 	std::vector < uint64_t > bin_curr;			//Location of Binary record				//Integer 2 and 3 in INFO/SEEK field
 
+	//Binary I/O backend
+	int32_t bin_io;								//Backend used to access binary files [BINIO_STREAM, BINIO_MMAP, BINIO_PREFETCH, BINIO_BLOCK, BINIO_DIRECT, BINIO_URING]
+	bool bin_sequential;						//Access pattern: full scan (true) or region queries/jumps (false)
+	std::vector < binary_mmap > bin_maps;		//Memory mappings of the binary files [BINIO_MMAP]
+	std::vector < binary_prefetch * > bin_pref;	//Read-ahead threads on the binary files [BINIO_PREFETCH]
+	std::vector < binary_block > bin_blocks;	//Large block readers on the binary files [BINIO_BLOCK, BINIO_DIRECT]
+	std::vector < int > bin_ufds;				//Raw file descriptors [BINIO_URING]
+	binary_uring bin_uring;						//Reads batched across files [BINIO_URING]
+	std::vector < binary_deflate_reader * > bin_zips;	//Block compressed binary files [used whatever the backend]
+	std::vector < std::vector < char > > bin_bufs;	//Record buffers backing views [BINIO_STREAM]
+	std::vector < pbwt_codec > bin_pbwt;		//PBWT order of the haplotypes [RECORD_PBWT_HAPLOTYPE]
+	std::vector < std::vector < char > > bin_pbwt_bits;	//Decoded PBWT and tiled records backing views
+	std::vector < tiled_block_reader > bin_tiles;	//Loaded tiled block [RECORD_*_TILED]
+	std::vector < uint32_t > bin_tile;			//Index of the current record in its tiled block
+
+	//Multi-allelic split [single BCF file: one bi-allelic record per ALT allele]
+	bool split_requested;						//Split multi-allelic lines instead of skipping them
+	bcf1_t * split_src;							//Multi-allelic line being split
+	bcf1_t * split_line;						//Current bi-allelic record
+	int32_t split_allele;						//ALT allele of the current record in split_src [0: no split]
+	uint64_t split_lines, split_records;		//Counts of lines split and records produced
+
+	//VCF text fast path [single VCF file: site columns, FORMAT/GT and PP only]
+	bool text_requested;						//Parse text lines on GT [and PP] instead of all FORMAT fields
+	bool text_pp;								//Keep FORMAT/PP
+	bool text_mode;								//Fast path in use
+	vcf_text_parser text_parser;
 
 	//CONSTRUCTOR
-	xcf_reader(std::string region, uint32_t nthreads) : multi(false),pos(0) {
+	xcf_reader(std::string region, uint32_t nthreads) : sync_region(region),single_mode(XCF_READ_UNDECIDED),single_disabled(false),single_done(false),single_line(NULL),single_itr(NULL),single_idx(NULL),decode_requested(false),decode_running(false),decode_holding(false),decode_head(0),decode_tail(0),decode_eof(false),decode_stop(false),multi(false),pos(0),bin_io(BINIO_STREAM),bin_sequential(region.empty()),split_requested(false),split_src(NULL),split_line(NULL),split_allele(0),split_lines(0),split_records(0),text_requested(false),text_pp(false),text_mode(false) {
 		if (region.empty())
 		{
 			sync_number = 0;
@@ -196,6 +406,10 @@ public:
 			if (nthreads > 1) bcf_sr_set_threads(sync_reader, nthreads);
 			vAC = vAN = vSK = NULL;
 			nAC = nAN = nSK = 0;
+			vGT = NULL;
+			nGT = 0;
+			vFMT = NULL;
+			nFMT = 0;
 			return;
 		}
 		sync_number = 0;
@@ -210,10 +424,14 @@ public:
 		}
 		vAC = vAN = vSK = NULL;
 		nAC = nAN = nSK = 0;
+		vGT = NULL;
+		nGT = 0;
+		vFMT = NULL;
+		nFMT = 0;
 	}
 
 	//CONSTRUCTOR
-	xcf_reader(uint32_t nthreads) : multi(false),pos(0) {
+	xcf_reader(uint32_t nthreads) : single_mode(XCF_READ_UNDECIDED),single_disabled(false),single_done(false),single_line(NULL),single_itr(NULL),single_idx(NULL),decode_requested(false),decode_running(false),decode_holding(false),decode_head(0),decode_tail(0),decode_eof(false),decode_stop(false),multi(false),pos(0),bin_io(BINIO_STREAM),bin_sequential(true),split_requested(false),split_src(NULL),split_line(NULL),split_allele(0),split_lines(0),split_records(0),text_requested(false),text_pp(false),text_mode(false) {
 		sync_number = 0;
 		sync_reader = bcf_sr_init();
 		sync_reader->collapse = COLLAPSE_NONE;
@@ -221,14 +439,51 @@ public:
 		if (nthreads > 1) bcf_sr_set_threads(sync_reader, nthreads);
 		vAC = vAN = vSK = NULL;
 		nAC = nAN = nSK = 0;
+		vGT = NULL;
+		nGT = 0;
+		vFMT = NULL;
+		nFMT = 0;
 	}
 
 	//DESTRUCTOR
 	~xcf_reader() {
 		//bcf_sr_destroy(sync_reader);
+		stopDecoding();
+	}
+
+	//SET THE BACKEND USED FOR BINARY FILES [to be called before adding files]
+	void setBinaryIO(int32_t mode) {
+		if (sync_number > 0) helper_tools::error("Binary I/O backend must be set before opening files");
+		bin_io = mode;
+#ifdef __LIBURING__
+		if (bin_io == BINIO_URING && !bin_uring.open()) helper_tools::warning("io_uring unavailable, binary records read with pread");
+#endif
+	}
+
+	//OPEN THE BINARY FILE ASSOCIATED WITH READER [file]
+	void openBinary(uint32_t file, std::string bfname) {
+		if (binary_deflate::isCompressed(bfname)) {
+			bin_zips[file] = new binary_deflate_reader();
+			if (!bin_zips[file]->open(bfname)) helper_tools::error("Cannot read block index of compressed file [" + bfname + "]");
+		} else if (bin_io == BINIO_MMAP) {
+			if (!bin_maps[file].open(bfname, bin_sequential)) helper_tools::error("Cannot map file [" + bfname + "] for reading");
+		} else if (bin_io == BINIO_PREFETCH) {
+			bin_pref[file] = new binary_prefetch();
+			if (!bin_pref[file]->open(bfname)) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+		} else if (bin_io == BINIO_BLOCK || bin_io == BINIO_DIRECT) {
+			if (!bin_blocks[file].open(bfname, binary_io::block_size * 1024UL * 1024UL, bin_io == BINIO_DIRECT)) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+			if (bin_io == BINIO_DIRECT && !bin_blocks[file].direct) helper_tools::warning("O_DIRECT not supported for [" + bfname + "], using the page cache");
+		} else if (bin_io == BINIO_URING) {
+			bin_ufds[file] = ::open(bfname.c_str(), O_RDONLY);
+			if (bin_ufds[file] < 0) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+		} else {
+			bin_fds[file].open(bfname.c_str(), std::ios::in | std::ios::binary);
+			if (!bin_fds[file]) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+		}
 	}
 
 	int32_t addFile() {
+		if (single_mode > XCF_READ_SYNCED) helper_tools::error("Cannot add files once single file reading has started");
 		if (sync_number>0) helper_tools::error("Cannot use stdin in combination with other files.");
 		std::string fname="";
 		if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";
@@ -252,6 +507,17 @@ public:
 		bin_seek.push_back(0);
 		bin_size.push_back(0);
 		bin_curr.push_back(0);
+		bin_maps.push_back(binary_mmap());
+		bin_pref.push_back(NULL);
+		bin_blocks.push_back(binary_block());
+		bin_ufds.push_back(-1);
+		bin_zips.push_back(NULL);
+		bin_bufs.push_back(std::vector < char > ());
+		bin_pbwt.push_back(pbwt_codec());
+		bin_pbwt_bits.push_back(std::vector < char > ());
+		bin_tiles.push_back(tiled_block_reader());
+		bin_tile.push_back(0);
+		ord_index.push_back(ordinal_index());
 		AC.push_back(0);
 		AN.push_back(0);
 		ploidy.push_back(-1);
@@ -267,9 +533,7 @@ public:
 		/************************************************************************************/
 		if (flagSEEK && nsamples == 0) {
 			//Open Binary file
-			std::string bfname = helper_tools::get_name_from_vcf(fname) + ".bin";
-			bin_fds[sync_number].open(bfname.c_str(), std::ios::in | std::ios::binary);
-			if (!bin_fds[sync_number]) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+			openBinary(sync_number, helper_tools::get_name_from_vcf(fname) + ".bin");
 			//Read PED file
 			std::string ped_fname = helper_tools::get_name_from_vcf(fname) + ".fam";
 			std::ifstream fdp(ped_fname);
@@ -278,9 +542,11 @@ public:
 			ind_fathers.push_back(std::vector < std::string >());
 			ind_mothers.push_back(std::vector < std::string >());
 			ind_pops.push_back(std::vector < std::string >());
+			ind_ploidy.push_back(std::vector < uint8_t >());
 			while (getline(fdp, buffer)) {
 				helper_tools::split(buffer, tokens);
 				ind_names[sync_number].push_back(tokens[0]);
+				ind_ploidy[sync_number].push_back((tokens.size() > 4 && tokens[4] == "1") ? 1 : 2);
 				if (tokens.size() >=3 )
 				{
 					ind_fathers[sync_number].push_back(tokens[1]); ind_mothers[sync_number].push_back(tokens[2]);
@@ -305,6 +571,7 @@ public:
 			ind_fathers.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
 			ind_mothers.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
 			ind_pops.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
+			ind_ploidy.push_back(std::vector < uint8_t >(ind_number[sync_number], 2));
 			sync_types[sync_number] = FILE_BCF;
 		}
 
@@ -328,6 +595,7 @@ public:
 
 	//ADD A NEW FILE IN THE SYNCHRONIZED READER
 	int32_t addFile(std::string fname) {
+		if (single_mode > XCF_READ_SYNCED) helper_tools::error("Cannot add files once single file reading has started");
 		std::string buffer;
 		std::vector < std::string > tokens;
 
@@ -350,6 +618,17 @@ public:
 		bin_seek.push_back(0);
 		bin_size.push_back(0);
 		bin_curr.push_back(0);
+		bin_maps.push_back(binary_mmap());
+		bin_pref.push_back(NULL);
+		bin_blocks.push_back(binary_block());
+		bin_ufds.push_back(-1);
+		bin_zips.push_back(NULL);
+		bin_bufs.push_back(std::vector < char > ());
+		bin_pbwt.push_back(pbwt_codec());
+		bin_pbwt_bits.push_back(std::vector < char > ());
+		bin_tiles.push_back(tiled_block_reader());
+		bin_tile.push_back(0);
+		ord_index.push_back(ordinal_index());
 		AC.push_back(0);
 		AN.push_back(0);
 		ploidy.push_back(-1);
@@ -365,9 +644,7 @@ public:
 		/************************************************************************************/
 		if (flagSEEK && nsamples == 0) {
 			//Open Binary file
-			std::string bfname = helper_tools::get_name_from_vcf(fname) + ".bin";
-			bin_fds[sync_number].open(bfname.c_str(), std::ios::in | std::ios::binary);
-			if (!bin_fds[sync_number]) helper_tools::error("Cannot open file [" + bfname + "] for reading");
+			openBinary(sync_number, helper_tools::get_name_from_vcf(fname) + ".bin");
 			//Read PED file
 			std::string ped_fname = helper_tools::get_name_from_vcf(fname) + ".fam";
 			std::ifstream fdp(ped_fname);
@@ -376,9 +653,11 @@ public:
 			ind_fathers.push_back(std::vector < std::string >());
 			ind_mothers.push_back(std::vector < std::string >());
 			ind_pops.push_back(std::vector < std::string >());
+			ind_ploidy.push_back(std::vector < uint8_t >());
 			while (getline(fdp, buffer)) {
 				helper_tools::split(buffer, tokens);
 				ind_names[sync_number].push_back(tokens[0]);
+				ind_ploidy[sync_number].push_back((tokens.size() > 4 && tokens[4] == "1") ? 1 : 2);
 				if (tokens.size() >=3 )
 				{
 					ind_fathers[sync_number].push_back(tokens[1]); ind_mothers[sync_number].push_back(tokens[2]);
@@ -403,6 +682,7 @@ public:
 			ind_fathers.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
 			ind_mothers.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
 			ind_pops.push_back(std::vector < std::string >(ind_number[sync_number], "NA"));
+			ind_ploidy.push_back(std::vector < uint8_t >(ind_number[sync_number], 2));
 			sync_types[sync_number] = FILE_BCF;
 		}
 
@@ -438,6 +718,21 @@ public:
 		bin_seek.erase(bin_seek.begin() + file);
 		bin_size.erase(bin_size.begin() + file);
 		bin_curr.erase(bin_curr.begin() + file);
+		bin_maps[file].close();
+		bin_maps.erase(bin_maps.begin() + file);
+		if (bin_pref[file]) delete bin_pref[file];
+		bin_pref.erase(bin_pref.begin() + file);
+		bin_blocks[file].close();
+		bin_blocks.erase(bin_blocks.begin() + file);
+		if (bin_ufds[file] >= 0) ::close(bin_ufds[file]);
+		bin_ufds.erase(bin_ufds.begin() + file);
+		if (bin_zips[file]) delete bin_zips[file];
+		bin_zips.erase(bin_zips.begin() + file);
+		bin_bufs.erase(bin_bufs.begin() + file);
+		bin_pbwt.erase(bin_pbwt.begin() + file);
+		bin_pbwt_bits.erase(bin_pbwt_bits.begin() + file);
+		bin_tiles.erase(bin_tiles.begin() + file);
+		bin_tile.erase(bin_tile.begin() + file);
 		AC.erase(AC.begin() + file);
 		AN.erase(AN.begin() + file);
 		ploidy.erase(ploidy.begin() + file);
@@ -445,6 +740,7 @@ public:
 		ind_fathers.erase(ind_fathers.begin() + file);
 		ind_mothers.erase(ind_mothers.begin() + file);
 		ind_pops.erase(ind_pops.begin() + file);
+		ind_ploidy.erase(ind_ploidy.begin() + file);
 		ind_number.erase(ind_number.begin()+file);
 
 		//Decrement number of readers
@@ -484,8 +780,366 @@ public:
 
 
 
-	//SET SYNCHRONIZED READER TO NEXT RECORD
+	//TILED RECORDS: INFO/SEEK gives the index in the block in place of the size, which is the one of the plain record
+	void parseTiled(uint32_t file) {
+		if (!helper_tools::isTiled(bin_type[file])) return;
+		bin_tile[file] = bin_size[file];
+		bin_size[file] = (2 * ind_names[file].size() + 7) / 8;
+	}
+
+	//PARSE VARIANT INFORMATION OF RECORD IN READER [r] / Returns false for non bi-allelic records
+	bool parseRecord(uint32_t r, bool firstfile) {
+		//If bi-allelic, proceed
+		if (sync_lines[r]->n_allele != 2) return false;
+
+		//If first time we see the record across files
+		if (firstfile) {
+
+			//Get variant information
+			chr = bcf_hdr_id2name(sync_reader->readers[r].header, sync_lines[r]->rid);
+			pos = sync_lines[r]->pos + 1;
+			rsid = std::string(sync_lines[r]->d.id);
+			ref = std::string(sync_lines[r]->d.allele[0]);
+			alt = std::string(sync_lines[r]->d.allele[1]);
+		}
+
+		//Get AC/AN information
+		int32_t rAC = bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "AC", &vAC, &nAC);
+		int32_t rAN = bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "AN", &vAN, &nAN);
+		if (rAC != 1) helper_tools::error("AC field is needed in file");
+		if (rAN != 1) helper_tools::error("AN field is needed in file");
+		AC[r] = vAC[0]; AN[r] = vAN[0];
+
+		//Get SEEK information
+		if (sync_types[r] == FILE_BINARY) {
+			if (bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "SEEK", &vSK, &nSK) < 0)
+				helper_tools::error("Could not fine INFO/SEEK fields");
+			if (nSK != 4) helper_tools::error("INFO/SEEK field should contain 4 numbers");
+			else {
+				bin_type[r] = vSK[0];
+				bin_seek[r] = vSK[1];
+				bin_seek[r] *= MOD30BITS;
+				bin_seek[r] += vSK[2];
+				bin_size[r] = vSK[3];
+				parseTiled(r);
+			}
+		} else if (sync_types[r] == FILE_BCF) {
+			bin_type[r] = RECORD_BCFVCF_GENOTYPE;
+			bin_seek[r] = 0;
+			bin_size[r] = 0;
+		}
+
+		//Set "has record" flag
+		sync_flags[r] = true;
+		return true;
+	}
+
+	//CHOOSE BETWEEN THE SYNCHRONIZED READER AND THE SINGLE FILE FAST PATH [at first record]
+	void initSingle() {
+		single_mode = XCF_READ_SYNCED;
+		if (sync_number != 1 || single_disabled) return;
+
+		bcf_sr_t * reader = &sync_reader->readers[0];
+		const bool text = text_requested && hts_get_format(reader->file)->format == vcf;
+		if (sync_region.empty()) single_mode = XCF_READ_SEQUENTIAL;
+		else if (reader->bcf_idx != NULL && sync_region.find(',') == std::string::npos) {
+			//Multiple regions stay on the synchronized reader, tabix indexed VCFs too unless parsed as text
+			single_itr = bcf_itr_querys(reader->bcf_idx, reader->header, sync_region.c_str());
+			if (single_itr == NULL) return;
+			single_mode = XCF_READ_INDEXED;
+		} else if (text && reader->tbx_idx != NULL && sync_region.find(',') == std::string::npos) {
+			single_itr = tbx_itr_querys(reader->tbx_idx, sync_region.c_str());
+			if (single_itr == NULL) return;
+			single_mode = XCF_READ_INDEXED;
+		}
+		if (single_mode != XCF_READ_SYNCED) {
+			text_mode = text;
+			if (text_mode) text_parser.init(reader->header, text_pp);
+			openSingle();
+		}
+	}
+
+	//ALLOCATE THE RECORDS OF THE SINGLE FILE FAST PATH
+	void openSingle() {
+		if (decode_requested) startDecoding();
+		else single_line = bcf_init();
+	}
+
+	//ORDINAL INDEX OF [file]: loaded from the .oidx next to the file, or built by scanning the records when missing
+	ordinal_index & getOrdinalIndex(uint32_t file) {
+		if (ord_index[file].empty()) {
+			std::string fname = sync_reader->readers[file].fname;
+			if (!ord_index[file].load(fname)) {
+				helper_tools::warning("No up to date ordinal index found for [" + fname + "], scanning all records");
+				if (!ord_index[file].build(fname)) helper_tools::error("Cannot build the ordinal index of [" + fname + "]");
+			}
+		}
+		return ord_index[file];
+	}
+
+	//NUMBER OF VARIANTS OF CONTIG [chr] IN [file]
+	uint64_t getVariantCount(uint32_t file, const std::string & chr) {
+		return getOrdinalIndex(file).count(chr);
+	}
+
+	//JUMP TO THE [k]-TH VARIANT (0-based) OF CONTIG [chr] [single file, before the first record]
+	// Records are then read from this variant up to the end of the contig.
+	void seekVariant(const std::string & chr, uint64_t k) {
+		if (sync_number != 1) helper_tools::error("Jumping to a variant ordinal requires a single input file");
+		if (single_mode != XCF_READ_UNDECIDED) helper_tools::error("Cannot jump to a variant ordinal once reading has started");
+		if (!sync_region.empty()) helper_tools::error("Jumping to a variant ordinal cannot be combined with a region");
+
+		bcf_sr_t * reader = &sync_reader->readers[0];
+		ordinal_index & oidx = getOrdinalIndex(0);
+		int32_t c = oidx.contig(chr);
+		int32_t rid = bcf_hdr_name2id(reader->header, chr.c_str());
+		single_mode = XCF_READ_INDEXED;
+		if (c < 0 || rid < 0 || k >= oidx.counts[c]) { single_done = true; return; }
+
+		hts_idx_t * idx = reader->bcf_idx;
+		if (idx == NULL) idx = single_idx = bcf_index_load(reader->fname);
+		if (idx == NULL) helper_tools::error("Cannot load the index of [" + std::string(reader->fname) + "]");
+		uint64_t cp = k / oidx.step;
+		single_itr = bcf_itr_queryi(idx, rid, oidx.cp_pos[c][cp] - 1, HTS_POS_MAX);
+		if (single_itr == NULL) helper_tools::error("Impossible to jump to contig [" + chr + "]");
+
+		//Skip variants sharing the position of the checkpoint, then the ones up to [k]
+		bcf1_t * line = bcf_init();
+		for (uint64_t n = oidx.cp_dup[c][cp] + k % oidx.step ; n > 0 && !single_done ; n--) single_done = !readSingle(line);
+		bcf_destroy(line);
+		openSingle();
+	}
+
+	//READ NEXT RECORD OF THE ONLY FILE INTO [line] / Returns false at the end of the file/region
+	bool readSingle(bcf1_t * line) {
+		bcf_sr_t * reader = &sync_reader->readers[0];
+		while (true) {
+			int32_t ret;
+			if (text_mode) ret = text_parser.read(reader->file, reader->tbx_idx, (single_mode == XCF_READ_INDEXED) ? single_itr : NULL, line);
+			else if (single_mode == XCF_READ_INDEXED) ret = bcf_itr_next(reader->file, single_itr, line);
+			else ret = bcf_read(reader->file, reader->header, line);
+			if (ret < -1) helper_tools::error("Failed to read record in [" + std::string(reader->fname) + "]");
+			if (ret == -1) return false;
+			//Same as targets in the synchronized reader: skip records starting before the region (e.g. overlapping indels)
+			if (single_mode == XCF_READ_INDEXED && line->pos < single_itr->beg) continue;
+			return true;
+		}
+	}
+
+	//READ NEXT RECORD OF THE ONLY FILE WITHOUT SYNCHRONIZATION
+	int32_t nextRecordSingle() {
+		if (!readSingle(single_line)) { single_done = true; return 0; }
+		bcf_unpack(single_line, BCF_UN_STR);
+
+		sync_lines[0] = single_line;
+		sync_flags[0] = false;
+		AC[0] = AN[0] = 0;
+		bin_type[0] = RECORD_VOID;
+		bin_seek[0] = bin_size[0] = 0;
+		parseRecord(0, true);
+		return 1;
+	}
+
+	//DECODE RECORDS OF THE ONLY FILE IN A SEPARATE THREAD [to be called before the first record]
+	// Reading, unpacking and parsing of INFO fields overlap with the genotype work of the caller.
+	// The record returned in sync_lines[0] stays valid and modifiable until the next call to nextRecord.
+	// Ignored when several files are read or with seek().
+	void useDecodeThread() {
+		decode_requested = true;
+	}
+
+	//PRODUCER: READ, UNPACK AND PARSE RECORDS INTO FREE SLOTS OF THE RING
+	void decodeRun() {
+		const bcf_hdr_t * hdr = sync_reader->readers[0].header;
+		const uint64_t nslots = decode_ring.size();
+		const int unpack = (sync_types[0] == FILE_BCF) ? BCF_UN_ALL : BCF_UN_STR;
+		int32_t nA = 0, nN = 0, nS = 0;
+		int32_t * vA = NULL, * vN = NULL, * vS = NULL;
+		while (true) {
+			uint64_t head = decode_head.load(std::memory_order_relaxed);
+			while (head - decode_tail.load(std::memory_order_acquire) >= nslots && !decode_stop.load(std::memory_order_relaxed)) std::this_thread::yield();
+			if (decode_stop.load(std::memory_order_relaxed)) break;
+
+			xcf_site & s = decode_ring[head % nslots];
+			if (!readSingle(s.line)) break;
+			bcf_unpack(s.line, unpack);
+			s.biallelic = (s.line->n_allele == 2);
+			if (s.biallelic) {
+				s.chr = bcf_hdr_id2name(hdr, s.line->rid);
+				s.pos = s.line->pos + 1;
+				s.rsid = s.line->d.id;
+				s.ref = s.line->d.allele[0];
+				s.alt = s.line->d.allele[1];
+				if (bcf_get_info_int32(hdr, s.line, "AC", &vA, &nA) != 1) helper_tools::error("AC field is needed in file");
+				if (bcf_get_info_int32(hdr, s.line, "AN", &vN, &nN) != 1) helper_tools::error("AN field is needed in file");
+				s.AC = vA[0]; s.AN = vN[0];
+				if (sync_types[0] == FILE_BINARY) {
+					if (bcf_get_info_int32(hdr, s.line, "SEEK", &vS, &nS) < 0) helper_tools::error("Could not fine INFO/SEEK fields");
+					if (nS != 4) helper_tools::error("INFO/SEEK field should contain 4 numbers");
+					s.type = vS[0];
+					s.seek = vS[1];
+					s.seek *= MOD30BITS;
+					s.seek += vS[2];
+					s.size = vS[3];
+				} else {
+					s.type = RECORD_BCFVCF_GENOTYPE;
+					s.seek = 0;
+					s.size = 0;
+				}
+			}
+			decode_head.store(head + 1, std::memory_order_release);
+		}
+		free(vA); free(vN); free(vS);
+		decode_eof.store(true, std::memory_order_release);
+	}
+
+	void startDecoding() {
+		decode_ring.resize(XCF_DECODE_SLOTS);
+		for (uint32_t i = 0 ; i < decode_ring.size() ; i++) decode_ring[i].line = bcf_init();
+		decode_worker = std::thread(&xcf_reader::decodeRun, this);
+		decode_running = true;
+	}
+
+	void stopDecoding() {
+		if (!decode_running) return;
+		decode_stop.store(true, std::memory_order_relaxed);
+		decode_worker.join();
+		for (uint32_t i = 0 ; i < decode_ring.size() ; i++) bcf_destroy(decode_ring[i].line);
+		decode_ring.clear();
+		decode_running = false;
+	}
+
+	//CONSUMER: RELEASE PREVIOUS SLOT AND TAKE THE NEXT DECODED RECORD
+	int32_t nextRecordDecoded() {
+		if (decode_holding) {
+			decode_tail.store(decode_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			decode_holding = false;
+		}
+		uint64_t tail = decode_tail.load(std::memory_order_relaxed);
+		while (decode_head.load(std::memory_order_acquire) == tail) {
+			if (decode_eof.load(std::memory_order_acquire) && decode_head.load(std::memory_order_acquire) == tail) { single_done = true; return 0; }
+			std::this_thread::yield();
+		}
+		xcf_site & s = decode_ring[tail % decode_ring.size()];
+		decode_holding = true;
+
+		sync_lines[0] = s.line;
+		sync_flags[0] = false;
+		AC[0] = AN[0] = 0;
+		bin_type[0] = RECORD_VOID;
+		bin_seek[0] = bin_size[0] = 0;
+		if (s.biallelic) {
+			//Swap strings: slot keeps the allocations for the next records
+			chr.swap(s.chr); ref.swap(s.ref); alt.swap(s.alt); rsid.swap(s.rsid);
+			pos = s.pos;
+			AC[0] = s.AC; AN[0] = s.AN;
+			bin_type[0] = s.type;
+			bin_seek[0] = s.seek;
+			bin_size[0] = s.size;
+			parseTiled(0);
+			sync_flags[0] = true;
+		}
+		return 1;
+	}
+
+	//PARSE VCF TEXT LINES ON FORMAT/GT ONLY [and PP when with_pp, to be called before the first record]
+	// Only applies when a single VCF file is read, whole or on a region of its tabix index: other FORMAT fields are
+	// then missing from the records. BCF files and other reading modes are not affected.
+	void parseTextGT(bool with_pp) {
+		text_requested = true;
+		text_pp = with_pp;
+	}
+
+	//SPLIT MULTI-ALLELIC LINES INTO BI-ALLELIC RECORDS [to be called before the first record]
+	// Only applies when a single BCF file is read. Record k of a line with n ALT alleles keeps REF and ALT k:
+	// Number=A/R numeric INFO fields are subset, other per-allele INFO fields are dropped, and GT alleles other
+	// than k are recoded to REF, as done by `bcftools norm -m-`.
+	void splitMultiallelic() {
+		split_requested = true;
+	}
+
+	//BUILD THE BI-ALLELIC RECORD FOR ALT ALLELE [k] OF LINE [src] INTO [dst]
+	static void splitLine(const bcf_hdr_t * hdr, bcf1_t * src, int32_t k, bcf1_t * dst) {
+		bcf_copy(dst, src);
+		bcf_unpack(dst, BCF_UN_ALL);
+		std::string a0 = std::string(src->d.allele[0]), ak = std::string(src->d.allele[k]);
+		const char * alleles[2] = { a0.c_str(), ak.c_str() };
+		bcf_update_alleles(hdr, dst, alleles, 2);
+
+		//Keys first, the INFO array of dst is modified along the way
+		std::vector < int32_t > keys;
+		for (uint32_t i = 0 ; i < dst->n_info ; i ++) keys.push_back(dst->d.info[i].key);
+
+		int32_t * vals = NULL, nvals = 0;
+		for (uint32_t i = 0 ; i < keys.size() ; i ++) {
+			int32_t vl = bcf_hdr_id2length(hdr, BCF_HL_INFO, keys[i]);
+			if (vl != BCF_VL_A && vl != BCF_VL_R && vl != BCF_VL_G) continue;
+			int32_t ht = bcf_hdr_id2type(hdr, BCF_HL_INFO, keys[i]);
+			const char * tag = bcf_hdr_int2id(hdr, BCF_DT_ID, keys[i]);
+			if (vl != BCF_VL_G && (ht == BCF_HT_INT || ht == BCF_HT_REAL)) {
+				//Integers and floats are both 4 bytes wide: values are moved without conversion
+				int32_t n = bcf_get_info_values(hdr, src, tag, (void**)&vals, &nvals, ht);
+				if (vl == BCF_VL_A && n == src->n_allele - 1) { bcf_update_info(hdr, dst, tag, &vals[k-1], 1, ht); continue; }
+				if (vl == BCF_VL_R && n == src->n_allele) { vals[1] = vals[k]; bcf_update_info(hdr, dst, tag, vals, 2, ht); continue; }
+			}
+			bcf_update_info(hdr, dst, tag, NULL, 0, ht);
+		}
+		free(vals);
+	}
+
+	//MOVE TO THE NEXT BI-ALLELIC RECORD OF THE LINE BEING SPLIT
+	int32_t nextSplit() {
+		const bcf_hdr_t * hdr = sync_reader->readers[0].header;
+		if (split_allele == 0) split_lines ++;
+		split_allele ++;
+		split_records ++;
+		if (!split_line) split_line = bcf_init();
+		splitLine(hdr, split_src, split_allele, split_line);
+
+		sync_lines[0] = split_line;
+		chr = bcf_hdr_id2name(hdr, split_line->rid);
+		pos = split_line->pos + 1;
+		rsid = std::string(split_line->d.id);
+		ref = std::string(split_line->d.allele[0]);
+		alt = std::string(split_line->d.allele[1]);
+		if (bcf_get_info_int32(hdr, split_line, "AC", &vAC, &nAC) != 1) helper_tools::error("AC field is needed in file");
+		if (bcf_get_info_int32(hdr, split_line, "AN", &vAN, &nAN) != 1) helper_tools::error("AN field is needed in file");
+		AC[0] = vAC[0]; AN[0] = vAN[0];
+		bin_type[0] = RECORD_BCFVCF_GENOTYPE;
+		bin_seek[0] = bin_size[0] = 0;
+		sync_flags[0] = true;
+		return 1;
+	}
+
+	//RECODE GENOTYPES OF A SPLIT RECORD [ALT allele kept -> 1, other ALT alleles -> 0, phase preserved]
+	void recodeSplit(int32_t * gt, int32_t n) const {
+		for (int32_t i = 0 ; i < n ; i ++) {
+			if (gt[i] == bcf_int32_vector_end || bcf_gt_is_missing(gt[i])) continue;
+			int32_t a = (bcf_gt_allele(gt[i]) == split_allele);
+			gt[i] = ((a + 1) << 1) | (gt[i] & 1);
+		}
+	}
+
+	//SET READER TO NEXT RECORD [multi-allelic lines give one record per ALT allele when split]
 	int32_t nextRecord() {
+		if (split_allele > 0 && split_allele + 1 < split_src->n_allele) return nextSplit();
+		split_allele = 0;
+		int32_t ret = nextLine();
+		if (ret && split_requested && sync_number == 1 && sync_types[0] == FILE_BCF && !sync_flags[0] && sync_lines[0] && sync_lines[0]->n_allele > 2) {
+			split_src = sync_lines[0];
+			return nextSplit();
+		}
+		return ret;
+	}
+
+	//SET SYNCHRONIZED READER TO NEXT LINE
+	int32_t nextLine() {
+
+		//Single file: skip the synchronized reader
+		if (single_mode == XCF_READ_UNDECIDED) initSingle();
+		if (single_mode == XCF_READ_INDEXED && single_done) return 0;
+		if (decode_running) return nextRecordDecoded();
+		if (single_mode != XCF_READ_SYNCED) return nextRecordSingle();
 
 		//Go to next record
 		int32_t ret = bcf_sr_next_line (sync_reader);
@@ -511,49 +1165,8 @@ public:
 				//Get the record
 				sync_lines[r] = bcf_sr_get_line(sync_reader, r);
 
-				//If bi-allelic, proceed
-				if (sync_lines[r]->n_allele == 2) {
-
-					//If first time we see the record across files
-					if (firstfile) {
-
-						//Get variant information
-						chr = bcf_hdr_id2name(sync_reader->readers[r].header, sync_lines[r]->rid);
-						pos = sync_lines[r]->pos + 1;
-						rsid = std::string(sync_lines[r]->d.id);
-						ref = std::string(sync_lines[r]->d.allele[0]);
-						alt = std::string(sync_lines[r]->d.allele[1]);
-						firstfile = 0;
-					}
-
-					//Get AC/AN information
-					int32_t rAC = bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "AC", &vAC, &nAC);
-					int32_t rAN = bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "AN", &vAN, &nAN);
-					if (rAC != 1) helper_tools::error("AC field is needed in file");
-					if (rAN != 1) helper_tools::error("AN field is needed in file");
-					AC[r] = vAC[0]; AN[r] = vAN[0];
-
-					//Get SEEK information
-					if (sync_types[r] == FILE_BINARY) {
-						if (bcf_get_info_int32(sync_reader->readers[r].header, sync_lines[r], "SEEK", &vSK, &nSK) < 0)
-							helper_tools::error("Could not fine INFO/SEEK fields");
-						if (nSK != 4) helper_tools::error("INFO/SEEK field should contain 4 numbers");
-						else {
-							bin_type[r] = vSK[0];
-							bin_seek[r] = vSK[1];
-							bin_seek[r] *= MOD30BITS;
-							bin_seek[r] += vSK[2];
-							bin_size[r] = vSK[3];
-						}
-					} else if (sync_types[r] == FILE_BCF) {
-						bin_type[r] = RECORD_BCFVCF_GENOTYPE;
-						bin_seek[r] = 0;
-						bin_size[r] = 0;
-					}
-
-					//Set "has record" flag
-					sync_flags[r] = true;
-				}
+				//Parse variant information, AC/AN and SEEK
+				if (parseRecord(r, firstfile)) firstfile = 0;
 			}
 		}
 
@@ -567,6 +1180,7 @@ public:
 	}
 
 	int32_t regionDone(uint32_t file) {
+		if (single_mode > XCF_READ_SYNCED) return single_done;
 		return (bcf_sr_region_done(sync_reader,file));
 	}
 
@@ -591,6 +1205,147 @@ public:
 		return bin_size[file];
 	}
 
+	//FILL A BATCH WITH THE NEXT [nmax] RECORDS OF BINARY FILE [file]
+	// Returns the number of records in the batch, 0 when no record is left.
+	// Payloads of the batch are fetched with a single read of the SEEK range when records are contiguous in the
+	// binary file, which is the case for any XCF written in one pass. They stay valid until the next read on [file].
+	// Records without data in [file] (e.g. multi-allelic) are kept with type RECORD_VOID and size 0.
+	uint32_t nextBatch(uint32_t file, xcf_batch & batch, uint32_t nmax, uint64_t max_bytes = XCF_BATCH_MAX_BYTES) {
+		batch.clear();
+		if (sync_types[file] != FILE_BINARY) helper_tools::error("Batched reading is only supported on binary files");
+
+		//Collect records [tiled ones are gathered from their blocks afterwards]
+		uint64_t span_beg = std::numeric_limits < uint64_t >::max(), span_end = 0, n_bytes = 0, n_tiled = 0;
+		std::vector < std::array < uint64_t, 3 > > tiled;
+		while (batch.n < nmax && n_bytes + n_tiled < max_bytes && nextRecord()) {
+			bool has = sync_flags[file];
+			bool is_tiled = has && helper_tools::isTiled(bin_type[file]);
+			batch.chr.push_back(chr);
+			batch.pos.push_back(pos);
+			batch.ref.push_back(ref);
+			batch.alt.push_back(alt);
+			batch.rsid.push_back(rsid);
+			batch.AC.push_back(AC[file]);
+			batch.AN.push_back(AN[file]);
+			batch.type.push_back(has ? bin_type[file] : RECORD_VOID);
+			batch.seek.push_back((has && !is_tiled) ? bin_seek[file] : 0);
+			batch.size.push_back((has && !is_tiled) ? bin_size[file] : 0);
+			if (is_tiled) {
+				tiled.push_back({ batch.n, bin_seek[file], bin_tile[file] });
+				n_tiled += bin_size[file];
+			} else if (has && bin_size[file]) {
+				span_beg = std::min(span_beg, bin_seek[file]);
+				span_end = std::max(span_end, bin_seek[file] + bin_size[file]);
+				n_bytes += bin_size[file];
+			}
+			batch.n++;
+		}
+		if (batch.n == 0) return 0;
+		batch.offset.resize(batch.n, 0);
+		batch.base = batch.payload.data();
+
+		//No plain payload
+		if (n_bytes == 0) ;
+
+		//Dense SEEK range: one coalesced read
+		else if (span_end - span_beg <= 2 * n_bytes) {
+			batch.base = readRange(file, span_beg, span_end - span_beg, batch.payload);
+			for (uint32_t i = 0 ; i < batch.n ; i ++) batch.offset[i] = batch.size[i] ? (batch.seek[i] - span_beg) : 0;
+		}
+
+		//Sparse SEEK range (e.g. files merged out of order): one read per record
+		else {
+			batch.payload.resize(n_bytes);
+			std::vector < char > tmp;
+			for (uint32_t i = 0, o = 0 ; i < batch.n ; i ++) {
+				batch.offset[i] = o;
+				if (batch.size[i] == 0) continue;
+				const char * src = readRange(file, batch.seek[i], batch.size[i], tmp);
+				memcpy(batch.payload.data() + o, src, batch.size[i]);
+				o += batch.size[i];
+			}
+			batch.base = batch.payload.data();
+		}
+
+		//PBWT records are handed out decoded [binary haplotypes]
+		if (std::find(batch.type.begin(), batch.type.end(), RECORD_PBWT_HAPLOTYPE) != batch.type.end()) decodeBatchPBWT(file, batch);
+
+		//Tiled records are appended after the other payloads
+		if (!tiled.empty()) decodeBatchTiled(file, batch, tiled);
+		return batch.n;
+	}
+
+	//APPEND THE TILED RECORDS OF [batch] [index in batch, block offset, index in block] TO ITS PAYLOADS
+	void decodeBatchTiled(uint32_t file, xcf_batch & batch, const std::vector < std::array < uint64_t, 3 > > & tiled) {
+		const uint32_t S = (2 * ind_names[file].size() + 7) / 8;
+		uint64_t span = 0;
+		for (uint32_t i = 0 ; i < batch.n ; i ++) span = std::max(span, batch.offset[i] + (uint64_t)batch.size[i]);
+		if (batch.base != batch.payload.data()) batch.payload.assign(batch.base, batch.base + span);
+		batch.payload.resize(span + tiled.size() * S);
+		uint64_t o = span;
+		for (auto & t : tiled) {
+			readTiled(file, t[1], t[2], batch.payload.data() + o);
+			batch.offset[t[0]] = o;
+			batch.size[t[0]] = S;
+			batch.seek[t[0]] = t[1];
+			o += S;
+		}
+		batch.base = batch.payload.data();
+	}
+
+	//REPLACE THE PBWT PAYLOADS OF [batch] BY THEIR ALLELE BITS
+	void decodeBatchPBWT(uint32_t file, xcf_batch & batch) {
+		const uint32_t n_bits_bytes = (2 * ind_names[file].size() + 7) / 8;
+		uint64_t span = 0, n_bytes = 0;
+		for (uint32_t i = 0 ; i < batch.n ; i ++) {
+			span = std::max(span, batch.offset[i] + (uint64_t)batch.size[i]);
+			n_bytes += (batch.type[i] == RECORD_PBWT_HAPLOTYPE && batch.size[i]) ? n_bits_bytes : batch.size[i];
+		}
+		//Raw payloads are copied first: replaying a chain may invalidate the views
+		std::vector < char > raw (batch.base, batch.base + span);
+		batch.payload.resize(n_bytes);
+		uint64_t o = 0;
+		for (uint32_t i = 0 ; i < batch.n ; i ++) {
+			if (batch.size[i] == 0) continue;
+			const char * src = raw.data() + batch.offset[i];
+			if (batch.type[i] == RECORD_PBWT_HAPLOTYPE) batch.size[i] = decodePBWT(file, src, batch.seek[i], batch.size[i], batch.payload.data() + o);
+			else memcpy(batch.payload.data() + o, src, batch.size[i]);
+			batch.offset[i] = o;
+			o += batch.size[i];
+		}
+		batch.base = batch.payload.data();
+	}
+
+	//READ [nbytes] AT [seek] IN BINARY FILE [file] / Returns a view or a pointer into [storage]
+	const char * readRange(uint32_t file, uint64_t seek, uint64_t nbytes, std::vector < char > & storage) {
+		const char * data = NULL;
+		if (bin_zips[file]) data = bin_zips[file]->view(seek, nbytes);
+		else if (bin_io == BINIO_MMAP) data = bin_maps[file].view(seek, nbytes);
+		else if (bin_io == BINIO_PREFETCH) data = bin_pref[file]->view(seek, nbytes);
+		else if (bin_io == BINIO_BLOCK || bin_io == BINIO_DIRECT) data = bin_blocks[file].view(seek, nbytes);
+		else if (bin_io == BINIO_URING) {
+			if (storage.size() < nbytes) storage.resize(nbytes);
+			bin_uring.push(bin_ufds[file], storage.data(), seek, nbytes);
+			if (bin_uring.run()) data = storage.data();
+		} else {
+			if (storage.size() < nbytes) storage.resize(nbytes);
+			if (bin_curr[file] != seek) bin_fds[file].seekg(seek, bin_fds[file].beg);
+			bin_fds[file].read(storage.data(), nbytes);
+			bin_curr[file] = seek + nbytes;
+			if (bin_fds[file]) data = storage.data();
+		}
+		if (data == NULL) helper_tools::error("Cannot read binary range in reader [" + std::to_string(file) + "]");
+		return data;
+	}
+
+	//SPREAD ONE GT VALUE PER SAMPLE TO THE DIPLOID LAYOUT [second value set to vector_end, buffer holding 2*n values]
+	static void spreadHaploid(int32_t * gt, uint32_t n) {
+		for (int32_t i = n - 1 ; i >= 0 ; i --) {
+			gt[2*i+1] = bcf_int32_vector_end;
+			gt[2*i+0] = gt[i];
+		}
+	}
+
 	//READ DATA OF THE AVAILABLE RECORD
 	// =0: No sample data available
 	// >0: Amount of data read in bytes
@@ -607,6 +1362,7 @@ public:
 			//Read genotypes [assuming buffer to be allocated!]
 			int32_t ndp = 0;//ind_number[file]*2;
 			int32_t rdp = bcf_get_genotypes(sync_reader->readers[file].header, sync_lines[file], buffer, &ndp);
+			if (split_allele > 0) recodeSplit(reinterpret_cast < int32_t * > (*buffer), rdp);
 
 			if (probabilities != NULL) {
 				bcf_get_format_float(sync_reader->readers[file].header, sync_lines[file], "PP", probabilities, nprobabilities);
@@ -616,21 +1372,21 @@ public:
 			int32_t max_ploidy = rdp/ind_number[file];
 			if (ploidy[file] < 0) ploidy[file] = rdp/ind_number[file];
 			assert ( rdp>=0 && max_ploidy>0); // GT present
-			assert(max_ploidy==ploidy[file]);
+			//Haploid-only records [e.g. male only chrY]: same diploid layout as mixed ploidy records
+			if (max_ploidy == 1) {
+				*buffer = (char*)realloc(*buffer, 2 * ind_number[file] * sizeof(int32_t));
+				spreadHaploid(reinterpret_cast < int32_t * > (*buffer), ind_number[file]);
+				return 2 * ind_number[file] * sizeof(int32_t);
+			}
 			//assert(rdp == (ind_number[file]*2));
 			return ndp * sizeof(int32_t);
 		}
 
 		//Data is in binary file
 		else {
-			if (bin_curr[file] != bin_seek[file])
-			{
-				//Seek to right position
-				bin_fds[file].seekg(bin_seek[file], bin_fds[file].beg);
-			}
-			//Read data in Binary file
-			bin_fds[file].read(*buffer, bin_size[file]);
-			bin_curr[file] = bin_seek[file] + bin_size[file];
+			if (bin_type[file] == RECORD_PBWT_HAPLOTYPE) return decodePBWT(file, *buffer);
+			if (helper_tools::isTiled(bin_type[file])) return readTiled(file, *buffer);
+			readBinary(file, *buffer);
 			//Return amount of data in bytes read in file
 			return bin_size[file];
 		}
@@ -646,19 +1402,108 @@ public:
 
 		//Data is in BCF file
 		if (sync_types[file] == FILE_BCF) {
-			//Read genotypes [assuming buffer to be allocated!]
-			int32_t ndp = 0;//ind_number[file]*2;
-			int32_t rdp = bcf_get_genotypes(sync_reader->readers[file].header, sync_lines[file], &buffer, &ndp);
+			//Read genotypes in vGT, then copied to buffer [assuming it to hold 2 values per sample!]
+			int32_t rdp = bcf_get_genotypes(sync_reader->readers[file].header, sync_lines[file], &vGT, &nGT);
+			if (split_allele > 0) recodeSplit(vGT, rdp);
 			int32_t max_ploidy = rdp/ind_number[file];
 			if (ploidy[file] < 0) ploidy[file] = rdp/ind_number[file];
 			assert ( rdp>=0 && max_ploidy>0); // GT present
-			assert(max_ploidy==ploidy[file]);
+			//Haploid-only records [e.g. male only chrY]: same diploid layout as mixed ploidy records
+			if (max_ploidy == 1) {
+				memcpy(buffer, vGT, ind_number[file] * sizeof(int32_t));
+				spreadHaploid(reinterpret_cast < int32_t * > (buffer), ind_number[file]);
+				return 2 * ind_number[file] * sizeof(int32_t);
+			}
 			//assert(rdp == (ind_number[file]*2));
-			return ndp * sizeof(int32_t);
+			memcpy(buffer, vGT, rdp * sizeof(int32_t));
+			return rdp * sizeof(int32_t);
 		}
 
 		//Data is in binary file
 		else {
+			if (bin_type[file] == RECORD_PBWT_HAPLOTYPE) return decodePBWT(file, buffer);
+			if (helper_tools::isTiled(bin_type[file])) return readTiled(file, buffer);
+			readBinary(file, buffer);
+			//Return amount of data in bytes read in file
+			return bin_size[file];
+		}
+	}
+
+	//READ DOSAGES OF THE AVAILABLE RECORD [BCF only: FORMAT/DS, or expected ALT count from FORMAT/GP]
+	// One float per sample in [ds], bcf_float_missing when unknown. Split multi-allelic records use the values
+	// of their ALT allele. Returns false when the record has neither field.
+	bool readDosages(uint32_t file, std::vector < float > & ds) {
+		if (!sync_flags[file] || sync_types[file] != FILE_BCF) return false;
+		const bcf_hdr_t * hdr = sync_reader->readers[file].header;
+		const uint32_t n = ind_number[file];
+		const int32_t k = std::max(split_allele, 1);
+		ds.resize(n);
+
+		//FORMAT/DS [Number=A]
+		int32_t rds = bcf_get_format_float(hdr, sync_lines[file], "DS", &vFMT, &nFMT);
+		if (rds > 0 && rds % n == 0) {
+			const int32_t stride = rds / n;
+			for (uint32_t i = 0 ; i < n ; i ++) ds[i] = vFMT[i * stride + std::min(k, stride) - 1];
+			return true;
+		}
+
+		//FORMAT/GP [Number=G, diploid ordering: genotype a/b at b*(b+1)/2+a]
+		int32_t rgp = bcf_get_format_float(hdr, sync_lines[file], "GP", &vFMT, &nFMT);
+		if (rgp > 0 && rgp % n == 0) {
+			const int32_t stride = rgp / n;
+			for (uint32_t i = 0 ; i < n ; i ++) {
+				const float * gp = vFMT + i * stride;
+				float d = 0.0f;
+				bool mis = false;
+				for (int32_t b = 0, g = 0 ; g < stride ; b ++) for (int32_t a = 0 ; a <= b && g < stride ; a ++, g ++) {
+					if (bcf_float_is_missing(gp[g]) || bcf_float_is_vector_end(gp[g])) { mis |= (g == 0); continue; }
+					d += gp[g] * ((a == k) + (b == k));
+				}
+				if (mis) bcf_float_set_missing(ds[i]);
+				else ds[i] = d;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	//READ THE CURRENT RECORDS OF SEVERAL FILES [buffers[i] receives the record of files[i], same semantic as readRecord]
+	// With BINIO_URING, the binary reads of all files are submitted together; other backends read file by file.
+	void readRecords(const std::vector < uint32_t > & files, const std::vector < char * > & buffers) {
+		if (bin_io != BINIO_URING) {
+			for (uint32_t i = 0 ; i < files.size() ; i ++) readRecord(files[i], buffers[i]);
+			return;
+		}
+		for (uint32_t i = 0 ; i < files.size() ; i ++) {
+			uint32_t f = files[i];
+			if (sync_flags[f] && sync_types[f] == FILE_BINARY && !bin_zips[f] && bin_type[f] != RECORD_PBWT_HAPLOTYPE && !helper_tools::isTiled(bin_type[f])) bin_uring.push(bin_ufds[f], buffers[i], bin_seek[f], bin_size[f]);
+			else readRecord(f, buffers[i]);
+		}
+		if (!bin_uring.run()) helper_tools::error("Cannot read binary records");
+	}
+
+	//COPY THE CURRENT BINARY RECORD INTO [buffer]
+	void readBinary(uint32_t file, char * buffer) {
+		if (bin_zips[file]) {
+			const char * data = bin_zips[file]->view(bin_seek[file], bin_size[file]);
+			if (data == NULL) helper_tools::error("Cannot decompress binary record in reader [" + std::to_string(file) + "]");
+			memcpy(buffer, data, bin_size[file]);
+		} else if (bin_io == BINIO_MMAP) {
+			const char * data = bin_maps[file].view(bin_seek[file], bin_size[file]);
+			if (data == NULL) helper_tools::error("Binary record out of file bounds in reader [" + std::to_string(file) + "]");
+			memcpy(buffer, data, bin_size[file]);
+		} else if (bin_io == BINIO_PREFETCH) {
+			const char * data = bin_pref[file]->view(bin_seek[file], bin_size[file]);
+			if (data == NULL) helper_tools::error("Cannot read binary record in reader [" + std::to_string(file) + "]");
+			memcpy(buffer, data, bin_size[file]);
+		} else if (bin_io == BINIO_BLOCK || bin_io == BINIO_DIRECT) {
+			const char * data = bin_blocks[file].view(bin_seek[file], bin_size[file]);
+			if (data == NULL) helper_tools::error("Cannot read binary record in reader [" + std::to_string(file) + "]");
+			memcpy(buffer, data, bin_size[file]);
+		} else if (bin_io == BINIO_URING) {
+			bin_uring.push(bin_ufds[file], buffer, bin_seek[file], bin_size[file]);
+			if (!bin_uring.run()) helper_tools::error("Cannot read binary record in reader [" + std::to_string(file) + "]");
+		} else {
 			if (bin_curr[file] != bin_seek[file])
 			{
 				//Seek to right position
@@ -667,23 +1512,219 @@ public:
 			//Read data in Binary file
 			bin_fds[file].read(buffer, bin_size[file]);
 			bin_curr[file] = bin_seek[file] + bin_size[file];
-			//Return amount of data in bytes read in file
-			return bin_size[file];
+		}
+	}
+
+	//VIEW ON THE CURRENT BINARY RECORD
+	// =0: No binary data available, [data] set to NULL
+	// >0: Size of the record in bytes, [data] points to the record (valid until the next call for this file)
+	// With BINIO_MMAP, the view points directly into the mapped file and no copy is done.
+	// With BINIO_PREFETCH, the view points into the read-ahead ring unless the record spans two chunks.
+	// With BINIO_BLOCK and BINIO_DIRECT, the view points into the current block.
+	// With compressed binary files, the view points into the last decompressed block.
+	int32_t viewRecord(uint32_t file, const char ** data) {
+		*data = NULL;
+		if (!sync_flags[file] || sync_types[file] != FILE_BINARY || bin_size[file] == 0) return 0;
+		if (bin_type[file] == RECORD_PBWT_HAPLOTYPE) {
+			std::vector < char > & bits = bin_pbwt_bits[file];
+			bits.resize((2 * ind_names[file].size() + 7) / 8);
+			*data = bits.data();
+			return decodePBWT(file, bits.data());
+		}
+		if (helper_tools::isTiled(bin_type[file])) {
+			std::vector < char > & bits = bin_pbwt_bits[file];
+			bits.resize(bin_size[file]);
+			*data = bits.data();
+			return readTiled(file, bits.data());
+		}
+		if (bin_zips[file]) {
+			*data = bin_zips[file]->view(bin_seek[file], bin_size[file]);
+			if (*data == NULL) helper_tools::error("Cannot decompress binary record in reader [" + std::to_string(file) + "]");
+		} else if (bin_io == BINIO_MMAP) {
+			*data = bin_maps[file].view(bin_seek[file], bin_size[file]);
+			if (*data == NULL) helper_tools::error("Binary record out of file bounds in reader [" + std::to_string(file) + "]");
+		} else if (bin_io == BINIO_PREFETCH) {
+			*data = bin_pref[file]->view(bin_seek[file], bin_size[file]);
+			if (*data == NULL) helper_tools::error("Cannot read binary record in reader [" + std::to_string(file) + "]");
+		} else if (bin_io == BINIO_BLOCK || bin_io == BINIO_DIRECT) {
+			*data = bin_blocks[file].view(bin_seek[file], bin_size[file]);
+			if (*data == NULL) helper_tools::error("Cannot read binary record in reader [" + std::to_string(file) + "]");
+		} else {
+			if (bin_bufs[file].size() < bin_size[file]) bin_bufs[file].resize(bin_size[file]);
+			readBinary(file, bin_bufs[file].data());
+			*data = bin_bufs[file].data();
+		}
+		return bin_size[file];
+	}
+
+	//DECODE THE CURRENT PBWT RECORD OF [file] INTO ALLELE BITS [bitvector layout], returns the number of bytes
+	int32_t decodePBWT(uint32_t file, char * bits) {
+		return decodePBWT(file, NULL, bin_seek[file], bin_size[file], bits);
+	}
+
+	//DECODE THE PBWT RECORD AT [seek] OF [file] / [data] holds the record, or NULL to read it
+	int32_t decodePBWT(uint32_t file, const char * data, uint64_t seek, uint32_t size, char * bits) {
+		pbwt_codec & C = bin_pbwt[file];
+		if (C.n_haps == 0) C.init(2 * ind_names[file].size());
+		std::vector < char > storage;
+		if (data == NULL) data = readRange(file, seek, size, storage);
+		if (!C.decode(data, size, seek, bits)) {
+			//Replaying reads other records of the file, so the record has to be kept aside
+			std::vector < char > record (data, data + size);
+			replayPBWT(file, pbwt_codec::parse(record.data(), seek));
+			if (!C.decode(record.data(), size, seek, bits)) helper_tools::error("Broken PBWT chain at " + chr + ":" + std::to_string(pos));
+		}
+		return (C.n_haps + 7) / 8;
+	}
+
+	//REBUILD THE PBWT ORDER OF [file] UP TO THE RECORD BEFORE [h]: walk back the chain, then replay it
+	void replayPBWT(uint32_t file, const pbwt_codec::header & h) {
+		pbwt_codec & C = bin_pbwt[file];
+		std::vector < std::pair < uint64_t, uint32_t > > chain;
+		std::vector < char > storage;
+		pbwt_codec::header curr = h;
+		while (curr.position > 0) {
+			chain.emplace_back(curr.prev_seek, curr.prev_size);
+			pbwt_codec::header prev = pbwt_codec::parse(readRange(file, curr.prev_seek, PBWT_HEADER, storage), curr.prev_seek);
+			if (prev.position + 1 != curr.position) helper_tools::error("Broken PBWT chain at " + chr + ":" + std::to_string(pos));
+			curr = prev;
+		}
+		for (auto it = chain.rbegin() ; it != chain.rend() ; ++ it)
+			if (!C.decode(readRange(file, it->first, it->second, storage), it->second, it->first, NULL)) helper_tools::error("Broken PBWT chain at " + chr + ":" + std::to_string(pos));
+	}
+
+	//GATHER THE CURRENT TILED RECORD OF [file] INTO [buffer], returns the number of bytes
+	int32_t readTiled(uint32_t file, char * buffer) {
+		return readTiled(file, bin_seek[file], bin_tile[file], buffer);
+	}
+
+	//GATHER RECORD [index] OF THE TILED BLOCK AT [seek] OF [file] / Only the tiles in the projection are read
+	int32_t readTiled(uint32_t file, uint64_t seek, uint32_t index, char * buffer) {
+		tiled_block_reader & B = bin_tiles[file];
+		const uint32_t S = (2 * ind_names[file].size() + 7) / 8;
+		if (B.offset != seek) {
+			std::vector < char > storage;
+			uint64_t n_offsets = B.parseHeader(readRange(file, seek, TILE_HEADER, storage));
+			if (B.record_bytes != S) helper_tools::error("Tiled block does not match the samples in reader [" + std::to_string(file) + "]");
+			B.parseOffsets(readRange(file, seek + TILE_HEADER, n_offsets, storage));
+			//One read per run of adjacent tiles needed
+			for (uint32_t t0 = 0, t1 = 0 ; t0 < B.n_tiles ; t0 = t1) {
+				if (!B.needed(t0)) { t1 = t0 + 1; continue; }
+				uint64_t n_bytes = 0;
+				for (t1 = t0 ; t1 < B.n_tiles && B.needed(t1) ; t1 ++) n_bytes += B.tileBytes(t1);
+				B.addTiles(t0, t1, readRange(file, seek + B.tile_offset[t0], n_bytes, storage));
+			}
+			B.bytes_full += (uint64_t)B.n_variants * S;
+			B.offset = seek;
+		}
+		B.gather(index, buffer);
+		return S;
+	}
+
+	//RESTRICT TILED READS OF [file] TO [samples] / Bytes of the other samples are zeroed in the records
+	void setProjection(uint32_t file, const std::vector < int32_t > & samples) {
+		bin_tiles[file].setProjection(ind_names[file].size(), samples);
+	}
+
+	//REPORT BYTES READ FROM BINARY FILES VERSUS BYTES USED AS RECORDS [BINIO_BLOCK and BINIO_DIRECT, tiled records]
+	void reportBinaryIO() {
+		const bool blocks = (bin_io == BINIO_BLOCK || bin_io == BINIO_DIRECT);
+		for (uint32_t r = 0 ; blocks && r < sync_number ; r++) if (sync_types[r] == FILE_BINARY) {
+			const binary_block & b = bin_blocks[r];
+			double ratio = b.bytes_used ? b.bytes_read * 1.0 / b.bytes_used : 0.0;
+			vrb.bullet("Binary I/O [" + std::to_string(r) + "]: " + stb.str(b.bytes_read / 1048576.0, 1) + "Mb read / " + stb.str(b.bytes_used / 1048576.0, 1) + "Mb used / " + stb.str(b.n_blocks) + " blocks / x" + stb.str(ratio, 2));
+		}
+		for (uint32_t r = 0 ; r < sync_number ; r++) if (sync_types[r] == FILE_BINARY && bin_tiles[r].bytes_full) {
+			const tiled_block_reader & B = bin_tiles[r];
+			vrb.bullet("Tiled I/O [" + std::to_string(r) + "]: " + stb.str(B.bytes_read / 1048576.0, 1) + "Mb read / " + stb.str(B.bytes_full / 1048576.0, 1) + "Mb of records / x" + stb.str(B.bytes_read * 1.0 / B.bytes_full, 2));
 		}
 	}
 
 	void seek(const char * seek_chr, int seek_pos) {
+		//Jumps are only supported by the synchronized reader
+		if (single_mode > XCF_READ_SYNCED) helper_tools::error("Cannot seek once single file reading has started");
+		single_disabled = true;
+
+		//Jumps break the sequential pattern, update mapping hints accordingly
+		if (bin_sequential) {
+			bin_sequential = false;
+			for (uint32_t r = 0 ; r < sync_number ; r++) bin_maps[r].advise(false);
+		}
 		bcf_sr_seek(sync_reader, seek_chr, seek_pos);
 	}
 
 	void close() {
-		free(vSK); free(vAC); free(vAN);
-		for (uint32_t r = 0 ; r < sync_number ; r++) if (sync_types[r]>=2) bin_fds[r].close();
+		free(vSK); free(vAC); free(vAN); free(vGT); free(vFMT);
+		stopDecoding();
+		if (single_line) bcf_destroy(single_line);
+		if (split_line) bcf_destroy(split_line);
+		if (single_itr) hts_itr_destroy(single_itr);
+		if (single_idx) hts_idx_destroy(single_idx);
+		single_line = NULL;
+		split_line = NULL;
+		split_src = NULL;
+		split_allele = 0;
+		single_itr = NULL;
+		single_idx = NULL;
+		for (uint32_t r = 0 ; r < sync_number ; r++) if (sync_types[r]>=2) {
+			bin_fds[r].close();
+			bin_maps[r].close();
+			if (bin_pref[r]) { delete bin_pref[r]; bin_pref[r] = NULL; }
+			bin_blocks[r].close();
+			if (bin_ufds[r] >= 0) { ::close(bin_ufds[r]); bin_ufds[r] = -1; }
+			if (bin_zips[r]) { delete bin_zips[r]; bin_zips[r] = NULL; }
+		}
+		bin_uring.close();
 		bcf_sr_destroy(sync_reader);
 	}
 };
 
 
+/*****************************************************************************/
+/*****************************************************************************/
+/******						XCF_WRITE_BATCH								******/
+/*****************************************************************************/
+/*****************************************************************************/
+
+//Output buffered by the asynchronous writer: site records and the binary payload that goes with them
+class xcf_write_batch {
+public:
+	uint32_t n;									//Records used in the pool
+	std::vector < bcf1_t * > records;			//Pool of records, reused across batches
+	std::vector < char > payload;
+	uint64_t n_bytes;							//Bytes used in payload
+
+	xcf_write_batch() : n(0), n_bytes(0) {
+	}
+
+	bool full() const {
+		return n >= XCF_ASYNC_RECORDS || n_bytes >= XCF_ASYNC_BYTES;
+	}
+
+	void addRecord(bcf1_t * rec) {
+		if (n == records.size()) records.push_back(bcf_init1());
+		bcf_copy(records[n++], rec);
+	}
+
+	void addPayload(const char * buffer, uint64_t nbytes) {
+		if (payload.size() < n_bytes + nbytes) payload.resize(std::max(n_bytes + nbytes, (uint64_t)XCF_ASYNC_BYTES));
+		memcpy(payload.data() + n_bytes, buffer, nbytes);
+		n_bytes += nbytes;
+	}
+
+	void clear() {
+		n = 0;
+		n_bytes = 0;
+	}
+
+	void destroy() {
+		for (uint32_t r = 0 ; r < records.size() ; r ++) bcf_destroy1(records[r]);
+		records.clear();
+		payload.clear();
+		clear();
+	}
+};
+
 /*****************************************************************************/
 /*****************************************************************************/
 /******						XCF_WRITER									******/
@@ -712,14 +1753,48 @@ public:
 	std::vector < std::string > ind_fathers;
 	std::vector < std::string > ind_mothers;
 	std::vector < std::string > ind_pops;
+	std::vector < uint8_t > ind_ploidy;
 
 
 	//Binary files [files x types]
 	std::ofstream bin_fds;						//File Descriptors
+	std::string bin_fname;						//Binary file name
 	uint32_t bin_type;							//Type of Binary record					//Integer 1 in INFO/SEEK field
 	uint64_t bin_seek;							//Location of Binary record				//Integer 2 and 3 in INFO/SEEK field
 	uint32_t bin_size;							//Amount of Binary records in bytes		//Integer 4 in INFO/SEEK field
 
+	//Ordinal index [written next to the .csi]
+	ordinal_index ord_index;
+
+	//Block compression of the binary file [optional]
+	binary_deflate_writer bin_zip;
+
+	//PBWT coding of binary haplotype records [optional]
+	bool pbwt;
+	pbwt_codec bin_pbwt;
+	std::vector < char > bin_pbwt_buf;
+
+	//2D tiled layout of binary records [optional]
+	tiled_block_writer bin_tiles;
+	std::vector < char > bin_tiles_buf;
+
+	//Asynchronous output [optional: records and payload written by a dedicated I/O thread, in order]
+	bool async;
+	std::thread async_worker;
+	std::mutex async_mtx;
+	std::condition_variable async_cv_work;
+	std::condition_variable async_cv_free;
+	std::vector < xcf_write_batch > async_batches;	//Batch [i % XCF_ASYNC_BATCHES] holds the i-th batch
+	uint64_t async_submitted;					//Batches handed to the I/O thread
+	uint64_t async_written;						//Batches written by the I/O thread
+	bool async_stop;
+	double async_blocked;						//Time the caller waited for a free batch [ms]
+
+	//Sidecar index of the binary file [optional]
+	binary_index_writer bin_index;
+	int32_t ninfo;
+	int32_t * vinfo;
+
 	//CONSTRUCTOR
 	xcf_writer(std::string _hts_fname, bool _hts_genotypes, uint32_t _nthreads, bool write_genotypes=true) : hts_hdr(nullptr) , ind_number(0) {
 		std::string oformat;
@@ -748,6 +1823,13 @@ public:
 		hts_record = bcf_init1();
 		vsk = (int32_t *)malloc(4 * sizeof(int32_t *));
 		nsk = rsk = 0;
+		vinfo = NULL;
+		ninfo = 0;
+		async = false;
+		pbwt = false;
+		async_submitted = async_written = 0;
+		async_stop = false;
+		async_blocked = 0.0;
 
 		hts_fd = hts_open(hts_fname.c_str(), oformat.c_str());
 	    if (!hts_fd)  helper_tools::error("Could not open " + hts_fname);
@@ -756,10 +1838,145 @@ public:
 
 		if (!hts_genotypes && write_genotypes) {
 			//BINARY
-			std::string bfname = helper_tools::get_name_from_vcf(hts_fname) + ".bin";
-			bin_fds.open(bfname.c_str(), std::ios::out | std::ios::binary);
-			if (!bin_fds) helper_tools::error("Cannot open file [" + bfname + "] for writing");
+			bin_fname = helper_tools::get_name_from_vcf(hts_fname) + ".bin";
+			bin_fds.open(bin_fname.c_str(), std::ios::out | std::ios::binary);
+			if (!bin_fds) helper_tools::error("Cannot open file [" + bin_fname + "] for writing");
+		}
+	}
+
+	//WRITE A SIDECAR INDEX (.bin.idx) ALONG THE BINARY FILE [to be called before writing records]
+	void setBinaryIndex() {
+		if (!bin_fds.is_open()) helper_tools::error("Sidecar index requires a binary file to be written");
+		std::string ifname = binary_index::filename(bin_fname);
+		if (!bin_index.open(ifname)) helper_tools::error("Cannot open file [" + ifname + "] for writing (little-endian platform required)");
+	}
+
+	//Add record to the sidecar index [record has to be expressed with the output header]
+	void indexRecord(bcf1_t * rec, uint32_t type, uint64_t seek, uint32_t nbytes) {
+		uint32_t AC = 0, AN = 0;
+		if (bcf_get_info_int32(hts_hdr, rec, "AC", &vinfo, &ninfo) > 0) AC = vinfo[0];
+		if (bcf_get_info_int32(hts_hdr, rec, "AN", &vinfo, &ninfo) > 0) AN = vinfo[0];
+		bin_index.push(rec->rid, rec->pos + 1, seek, nbytes, AC, AN, type);
+	}
+
+	//WRITE RECORDS AND BINARY PAYLOAD FROM A DEDICATED I/O THREAD [to be called before writing records]
+	// Records are copied in batches, BGZF compression and file writes overlap with the caller.
+	void setAsync() {
+		if (async) return;
+		async = true;
+		async_batches.resize(XCF_ASYNC_BATCHES);
+		async_worker = std::thread(&xcf_writer::asyncRun, this);
+	}
+
+	//I/O THREAD: write batches in submission order
+	void asyncRun() {
+		std::unique_lock < std::mutex > lock(async_mtx);
+		while (true) {
+			async_cv_work.wait(lock, [&] { return async_stop || async_written < async_submitted; });
+			if (async_written == async_submitted) break;
+			xcf_write_batch & b = async_batches[async_written % XCF_ASYNC_BATCHES];
+			lock.unlock();
+			if (b.n_bytes) bin_fds.write(b.payload.data(), b.n_bytes);
+			for (uint32_t r = 0 ; r < b.n ; r ++)
+				if (bcf_write1(hts_fd, hts_hdr, b.records[r]) < 0) helper_tools::error("Failing to write VCF/record for rare variants");
+			b.clear();
+			lock.lock();
+			async_written ++;
+			async_cv_free.notify_one();
+		}
+	}
+
+	//HAND THE BATCH BEING FILLED TO THE I/O THREAD AND WAIT FOR THE NEXT ONE TO BE FREE
+	void asyncSubmit() {
+		std::unique_lock < std::mutex > lock(async_mtx);
+		async_submitted ++;
+		async_cv_work.notify_one();
+		if (async_submitted - async_written >= XCF_ASYNC_BATCHES) {
+			auto t0 = std::chrono::steady_clock::now();
+			async_cv_free.wait(lock, [&] { return async_submitted - async_written < XCF_ASYNC_BATCHES; });
+			async_blocked += std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - t0).count();
+		}
+	}
+
+	inline xcf_write_batch & asyncBatch() {
+		return async_batches[async_submitted % XCF_ASYNC_BATCHES];
+	}
+
+	//WRITE REMAINING BATCHES AND STOP THE I/O THREAD
+	void asyncFinish() {
+		if (!async) return;
+		if (asyncBatch().n || asyncBatch().n_bytes) asyncSubmit();
+		{
+			std::lock_guard < std::mutex > lock(async_mtx);
+			async_stop = true;
 		}
+		async_cv_work.notify_one();
+		async_worker.join();
+		for (uint32_t b = 0 ; b < async_batches.size() ; b ++) async_batches[b].destroy();
+		async = false;
+		vrb.bullet("Asynchronous writer: " + stb.str(async_submitted) + " batches / caller blocked for " + stb.str(async_blocked / 1000.0, 2) + "s");
+	}
+
+	//COMPRESS THE BINARY FILE IN BLOCKS [to be called before writing records, uses nthreads]
+	void setCompression() {
+		if (!bin_fds.is_open()) helper_tools::error("Compression requires a binary file to be written");
+		bin_zip.open(nthreads);
+	}
+
+	//WRITE BINARY HAPLOTYPE RECORDS OF [n_haps] HAPLOTYPES IN PBWT ORDER [to be called before writing records]
+	void setPBWT(uint32_t n_haps) {
+		if (!bin_fds.is_open()) helper_tools::error("PBWT coding requires a binary file to be written");
+		pbwt = true;
+		bin_pbwt.init(n_haps);
+	}
+
+	//WRITE BINARY RECORDS IN 2D TILED BLOCKS OF [tile_haps] HAPLOTYPES PER TILE [to be called before writing records]
+	// Blocks are rewritten in place once full, so no compression, PBWT coding or asynchronous output.
+	void setTiling(uint32_t tile_haps) {
+		if (!bin_fds.is_open()) helper_tools::error("Tiled layout requires a binary file to be written");
+		bin_tiles.init(tile_haps);
+	}
+
+	//ADD BINARY RECORD TO THE CURRENT TILED BLOCK [room for a full block is kept in the file when it starts]
+	void writeTiled(uint32_t type, const char * buffer, uint32_t nbytes) {
+		if (bin_tiles.n == 0) {
+			if (async || bin_zip.isOpen() || pbwt) helper_tools::error("Tiled layout cannot be combined with compression, PBWT coding or asynchronous output");
+			bin_tiles.offset = bin_seek;
+			bin_seek += bin_tiles.reserve(nbytes);
+			bin_fds.seekp(bin_seek);
+		}
+		uint32_t index = bin_tiles.push(buffer, nbytes);
+		type = (type == RECORD_BINARY_HAPLOTYPE) ? RECORD_BINARY_HAPLOTYPE_TILED : RECORD_BINARY_GENOTYPE_TILED;
+		vsk[0] = type;
+		vsk[1] = bin_tiles.offset / MOD30BITS;
+		vsk[2] = bin_tiles.offset % MOD30BITS;
+		vsk[3] = index;
+		if (bin_index.isOpen()) indexRecord(hts_record, type, bin_tiles.offset, index);
+		bcf_update_info_int32(hts_hdr, hts_record, "SEEK", vsk, 4);
+		if (bin_tiles.full()) flushTiled();
+	}
+
+	//WRITE THE CURRENT TILED BLOCK IN ITS ROOM [shrunk when nothing follows it]
+	void flushTiled() {
+		if (bin_tiles.n == 0) return;
+		if (bin_seek == bin_tiles.offset + bin_tiles.reserved) bin_seek = bin_tiles.offset + tiled_block::size(bin_tiles.n, bin_tiles.record_bytes, bin_tiles.tile_haps);
+		bin_tiles.encode(bin_tiles.n, bin_tiles_buf);
+		bin_fds.seekp(bin_tiles.offset);
+		bin_fds.write(bin_tiles_buf.data(), bin_tiles_buf.size());
+		bin_fds.seekp(bin_seek);
+		bin_tiles.clear();
+	}
+
+	//WRITE COMPRESSED BLOCKS THAT ARE READY
+	void flushCompressed() {
+		for (uint32_t b = 0 ; b < bin_zip.ready.size() ; b ++) writeBinary(bin_zip.ready[b].data(), bin_zip.ready[b].size());
+		bin_zip.ready.clear();
+	}
+
+	//WRITE BINARY PAYLOAD
+	void writeBinary(const char * buffer, uint32_t nbytes) {
+		if (!async) { bin_fds.write(buffer, nbytes); return; }
+		asyncBatch().addPayload(buffer, nbytes);
 	}
 
 	//DESTRUCTOR
@@ -796,6 +2013,7 @@ public:
 		if (hts_genotypes) {
 			bcf_hdr_append(hts_hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Phased genotypes\">");
 			bcf_hdr_append(hts_hdr, "##FORMAT=<ID=PP,Number=1,Type=Float,Description=\"Phasing confidence\">");
+			bcf_hdr_append(hts_hdr, "##FORMAT=<ID=DS,Number=A,Type=Float,Description=\"Genotype dosage\">");
 		} else bcf_hdr_append(hts_hdr, "##INFO=<ID=SEEK,Number=4,Type=Integer,Description=\"SEEK binary file information\">");
 	}
 	
@@ -831,11 +2049,12 @@ public:
 			bcf_hdr_add_sample(hts_hdr, NULL);      // to update internal structures
 		} else {
 			//Samples are in PED file
-			std::string ffname = helper_tools::get_name_from_vcf(hts_fname) + ".fam";
-			std::ofstream fd (ffname);
-			if (!fd.is_open()) helper_tools::error("Cannot open [" + ffname + "] for writing");
-			for (uint32_t i = 0 ; i < input_xcf_reader.ind_names[0].size() ; i++) fd << input_xcf_reader.ind_names[0][i] << "\t"<< input_xcf_reader.ind_fathers[0][i] << "\t" << input_xcf_reader.ind_mothers[0][i] << "\t" << input_xcf_reader.ind_pops[0][i] << std::endl;
-			fd.close();
+			ind_names = input_xcf_reader.ind_names[0];
+			ind_fathers = input_xcf_reader.ind_fathers[0];
+			ind_mothers = input_xcf_reader.ind_mothers[0];
+			ind_pops = input_xcf_reader.ind_pops[0];
+			ind_ploidy = input_xcf_reader.ind_ploidy[0];
+			writeFam();
 		}
 		//Terminate
 		writeHeader_terminate();
@@ -855,16 +2074,40 @@ public:
 			bcf_hdr_add_sample(hts_hdr, NULL);      // to update internal structures
 		} else {
 			//Samples are in PED file
-			std::string ffname = helper_tools::get_name_from_vcf(hts_fname) + ".fam";
-			std::ofstream fd (ffname);
-			if (!fd.is_open()) helper_tools::error("Cannot open [" + ffname + "] for writing");
-			for (uint32_t i = 0 ; i < subs2full.size() ; i++) fd << input_xcf_reader.ind_names[0][subs2full[i]] << "\t"<< input_xcf_reader.ind_fathers[0][subs2full[i]] << "\t" << input_xcf_reader.ind_mothers[0][subs2full[i]] << "\t" << input_xcf_reader.ind_pops[0][subs2full[i]] << std::endl;
-			fd.close();
+			ind_names.clear(); ind_fathers.clear(); ind_mothers.clear(); ind_pops.clear(); ind_ploidy.clear();
+			for (uint32_t i = 0 ; i < subs2full.size() ; i++) {
+				ind_names.push_back(input_xcf_reader.ind_names[0][subs2full[i]]);
+				ind_fathers.push_back(input_xcf_reader.ind_fathers[0][subs2full[i]]);
+				ind_mothers.push_back(input_xcf_reader.ind_mothers[0][subs2full[i]]);
+				ind_pops.push_back(input_xcf_reader.ind_pops[0][subs2full[i]]);
+				ind_ploidy.push_back(input_xcf_reader.ind_ploidy[0][subs2full[i]]);
+			}
+			writeFam();
 		}
 		//Terminate
 		writeHeader_terminate();
 	}
 
+	//Write the PED file [ploidy in 5th column when some samples are haploid]
+	void writeFam() {
+		std::string ffname = helper_tools::get_name_from_vcf(hts_fname) + ".fam";
+		std::ofstream fd (ffname);
+		if (!fd.is_open()) helper_tools::error("Cannot open [" + ffname + "] for writing");
+		bool haploid = (std::find(ind_ploidy.begin(), ind_ploidy.end(), 1) != ind_ploidy.end());
+		for (uint32_t i = 0 ; i < ind_names.size() ; i++) {
+			fd << ind_names[i] << "\t"<< ind_fathers[i] << "\t" << ind_mothers[i] << "\t" << ind_pops[i];
+			if (haploid) fd << "\t" << (int)ind_ploidy[i];
+			fd << std::endl;
+		}
+		fd.close();
+	}
+
+	//Set the ploidy of the samples, known once records have been seen [rewrites the PED file]
+	void setPloidy(const std::vector < uint8_t > & ploidy) {
+		ind_ploidy = ploidy;
+		if (!hts_genotypes) writeFam();
+	}
+
 	//Write variant information
 	void writeInfo(std::string chr, uint32_t pos, std::string ref, std::string alt, std::string rsid, uint32_t AC, uint32_t AN) {
 		hts_record->rid = bcf_hdr_name2id(hts_hdr, chr.c_str());
@@ -883,22 +2126,38 @@ public:
 		vsk[2] = seek % MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
 		vsk[3] = nbytes;
 		bcf_update_info_int32(hts_hdr, hts_record, "SEEK", vsk, 4);
+		if (bin_index.isOpen()) indexRecord(hts_record, type, seek, nbytes);
 		writeRecord(hts_record);
 	}
 	//Write genotypes + PPs
 	void writeRecord(uint32_t type, char * buffer, uint32_t nbytes, char * probabilities = NULL) {
+		//Binary haplotypes are written in PBWT order when requested
+		if (pbwt && !hts_genotypes && type == RECORD_BINARY_HAPLOTYPE) {
+			nbytes = bin_pbwt.encode(buffer, hts_record->rid, bin_pbwt_buf);
+			buffer = bin_pbwt_buf.data();
+			type = RECORD_PBWT_HAPLOTYPE;
+		}
 		if (hts_genotypes) {
 			bcf_update_genotypes(hts_hdr, hts_record, buffer, nbytes/sizeof(int32_t));
 			if (probabilities) {
 				bcf_update_format_float(hts_hdr, hts_record, "PP", probabilities, nbytes/(2*sizeof(float)));
 			}
+		} else if (bin_tiles.active() && (type == RECORD_BINARY_HAPLOTYPE || type == RECORD_BINARY_GENOTYPE)) {
+			writeTiled(type, buffer, nbytes);
 		} else {
+			//Compressed binary file: virtual SEEK [block, offset in block]
+			if (type == RECORD_PBWT_HAPLOTYPE) bin_pbwt.link(buffer, bin_zip.isOpen() ? bin_zip.tell(nbytes) : bin_seek, nbytes);
+			uint64_t seek = bin_zip.isOpen() ? bin_zip.push(buffer, nbytes) : bin_seek;
 			vsk[0] = type;
-			vsk[1] = bin_seek / MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
-			vsk[2] = bin_seek % MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
+			vsk[1] = seek / MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
+			vsk[2] = seek % MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
 			vsk[3] = nbytes;
-			bin_fds.write(buffer, nbytes);
-			bin_seek += nbytes;
+			if (bin_index.isOpen()) indexRecord(hts_record, type, seek, nbytes);
+			if (bin_zip.isOpen()) flushCompressed();
+			else {
+				writeBinary(buffer, nbytes);
+				bin_seek += nbytes;
+			}
 			bcf_update_info_int32(hts_hdr, hts_record, "SEEK", vsk, 4);
 		}
 		writeRecord(hts_record);
@@ -909,19 +2168,51 @@ public:
 		writeRecord(hts_record);
 	}
 
+	//Write dosages of the current record in FORMAT/DS [BCF output]
+	void writeDosages(float * dosages, uint32_t n) {
+		bcf_update_format_float(hts_hdr, hts_record, "DS", dosages, n);
+		writeRecord(hts_record);
+	}
+
 	void writeRecord(bcf1_t* rec) {
-			if (bcf_write1(hts_fd, hts_hdr, rec) < 0) helper_tools::error("Failing to write VCF/record for rare variants");
+			if (async) {
+				asyncBatch().addRecord(rec);
+				if (asyncBatch().full()) asyncSubmit();
+			} else if (bcf_write1(hts_fd, hts_hdr, rec) < 0) helper_tools::error("Failing to write VCF/record for rare variants");
+			if (!hts_fidx.empty()) ord_index.push(rec->rid, rec->pos + 1);
 			bcf_clear1(hts_record);
 		}
 
 	void close()
 	{
+		//Pending output has to reach the files before the index is saved
+		flushTiled();
+		if (bin_zip.isOpen()) {
+			bin_zip.finish();
+			flushCompressed();
+			vrb.bullet("Binary compression: " + stb.str(bin_zip.bytes_in / 1048576.0, 1) + "Mb to " + stb.str(bin_zip.offset / 1048576.0, 1) + "Mb in " + stb.str(bin_zip.idx_offset.size()) + " blocks");
+		}
+		asyncFinish();
 		if (!hts_fidx.empty()) if (bcf_idx_save(hts_fd)) helper_tools::error("Writing .csi index");
+		if (!hts_fidx.empty()) ord_index.setContigs(hts_hdr);
+
+		if (bin_index.isOpen()) {
+			std::vector < std::string > contigs;
+			for (int c = 0 ; c < hts_hdr->n[BCF_DT_CTG] ; c ++) contigs.push_back(std::string(hts_hdr->id[BCF_DT_CTG][c].key));
+			if (!bin_index.close(contigs)) helper_tools::error("Writing sidecar index of [" + bin_fname + "]");
+		}
 
 		free(vsk);
+		free(vinfo);
 		bcf_destroy1(hts_record);
 		bcf_hdr_destroy(hts_hdr);
 		if (hts_close(hts_fd)) helper_tools::error("Non zero status when closing [" + hts_fname + "]");
+
+		//Ordinal index saved once the file has its final size
+		if (!hts_fidx.empty()) {
+			ord_index.hts_size = ordinal_index::fileSize(hts_fname);
+			if (!ord_index.save(ordinal_index::filename(hts_fname))) helper_tools::error("Writing .oidx index");
+		}
 	}
 };
 
@@ -62,11 +62,17 @@ void concat::concat_naive()
 	const bool out_only_bcf = options.count("out-only-bcf");
 	std::string fname = options["output"].as < std::string > ();
 	xcf_writer XW(fname, false, nthreads, !out_only_bcf);
+	if (bin_index && !out_only_bcf) XW.setBinaryIndex();
 	int64_t offset_seek = 0;
 	uint64_t n_tot_sites=0;
 
 	concat_naive_check_headers(XW, fname);
 
+	//SEEK of compressed binary files are block numbers, they cannot be shifted
+	for (size_t i=0; i<filenames.size(); i++)
+		if (binary_deflate::isCompressed(stb.remove_extension(filenames[i]) + ".bin"))
+			vrb.error("Naive concat does not support compressed binary files [" + filenames[i] + "], use --ligate or decompress with xcftools view");
+
 	tac.clock();
 	vrb.title("Concatenating BCFs:");
     for (size_t i=0; i<filenames.size(); i++)
@@ -95,6 +101,7 @@ void concat::concat_naive()
 			vSK[2] = bin_seek % MOD30BITS;		//Split addr in 2 30bits integer (max number of sparse genotypes ~1.152922e+18)
 			bcf_update_info_int32(hdr, rec, "SEEK", vSK, 4);
         	bcf_translate(XW.hts_hdr, hdr,rec);
+			if (XW.bin_index.isOpen()) XW.indexRecord(rec, vSK[0], bin_seek, vSK[3]);
 			XW.writeRecord(rec);
 			++nsites;
         }
@@ -102,7 +109,9 @@ void concat::concat_naive()
         bcf_hdr_destroy(hdr);
         hts_close(fp);
         n_tot_sites += nsites;
-        if (vSK) offset_seek = bin_seek+vSK[3];
+        //Tiled records give their index in the block in place of their size, the binary file ends after the last block
+        if (vSK && helper_tools::isTiled(vSK[0])) offset_seek += std::filesystem::file_size(stb.remove_extension(filenames[i]) + ".bin");
+        else if (vSK) offset_seek = bin_seek+vSK[3];
         vrb.print("\t[#ns=" + stb.str(nsites) + "]\t(" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
     }
     vrb.print("BCF writing completed");
@@ -250,9 +259,13 @@ void concat::concat_ligate()
 	vrb.title("Ligating chunks");
 	std::string fname = options["output"].as < std::string > ();
 	xcf_writer XW(fname, false, nthreads);
+	if (bin_index) XW.setBinaryIndex();
+	if (async_write) XW.setAsync();
+	if (bin_compress) XW.setCompression();
 	uint64_t offset_seek = 0;
 
 	xcf_reader XR(nthreads);
+	XR.setBinaryIO(bin_io);
 	bcf_hdr_t * out_hdr = NULL;
 	uint32_t out_ind_number = 0;
 	std::vector < std::string > out_ind_names;
@@ -399,7 +412,7 @@ void concat::concat_ligate()
         		XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, XR.getAC(), XR.getAN());
               	const bool uphalf = !XR.hasRecord(0);
         		const int32_t type = XR.typeRecord(uphalf);
-        		if (type == RECORD_BINARY_HAPLOTYPE)
+        		if (type == RECORD_BINARY_HAPLOTYPE || type == RECORD_PBWT_HAPLOTYPE || type == RECORD_BINARY_HAPLOTYPE_TILED)
         		{
         			phase_update_common(haps_bitvector, uphalf, XR);
         			XW.writeRecord(RECORD_BINARY_HAPLOTYPE, haps_bitvector.bytes, haps_bitvector.n_bytes);
@@ -446,7 +459,7 @@ void concat::concat_ligate()
 
         		XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, XR.getAC(), XR.getAN());
         		const int32_t type = XR.typeRecord(i);
-        		if (type == RECORD_BINARY_HAPLOTYPE)
+        		if (type == RECORD_BINARY_HAPLOTYPE || type == RECORD_PBWT_HAPLOTYPE || type == RECORD_BINARY_HAPLOTYPE_TILED)
         		{
         			phase_update_common(haps_bitvector, i, XR);
         			XW.writeRecord(RECORD_BINARY_HAPLOTYPE, haps_bitvector.bytes, haps_bitvector.n_bytes);
@@ -476,7 +489,7 @@ void concat::concat_ligate()
         		XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, XR.getAC(), XR.getAN());//this should not be disruptive in the INFO
 				const bool uphalf = n_sites_buff >= nsites_buff_d2.back();
         		const int32_t type = XR.typeRecord(uphalf);
-        		if (type == RECORD_BINARY_HAPLOTYPE)
+        		if (type == RECORD_BINARY_HAPLOTYPE || type == RECORD_PBWT_HAPLOTYPE || type == RECORD_BINARY_HAPLOTYPE_TILED)
         		{
         			phase_update_common(haps_bitvector, uphalf, XR);
         			XW.writeRecord(RECORD_BINARY_HAPLOTYPE, haps_bitvector.bytes, haps_bitvector.n_bytes);
@@ -589,6 +602,7 @@ void concat::scan_overlap(const int ifname, const char * seek_chr, int seek_pos)
 	if (nthreads < 1) vrb.error("Number of threads should be a positive integer.");
 
 	xcf_reader XR(nthreads);
+	XR.setBinaryIO(bin_io);
 	if (XR.addFile(filenames[ifname-2])!=0) vrb.error("Problem opening/creating index file for [" + filenames[ifname-2] + "]");
 	if (XR.addFile(filenames[ifname-1])!=1) vrb.error("Problem opening/creating index file for [" + filenames[ifname-1] + "]");
 
@@ -622,19 +636,17 @@ void concat::scan_overlap(const int ifname, const char * seek_chr, int seek_pos)
 		if (atype != btype)
 			vrb.error("Different encoding of the same variant between different files. Ligation between different encodings is not supported.");
 		// ... in binary haplotype format
-		if (atype == RECORD_BINARY_HAPLOTYPE)
+		if (atype == RECORD_BINARY_HAPLOTYPE || atype == RECORD_PBWT_HAPLOTYPE || atype == RECORD_BINARY_HAPLOTYPE_TILED)
 		{
-			XR.readRecord(0, reinterpret_cast< char* > (abit_v.bytes));
-			XR.readRecord(1, reinterpret_cast< char* > (bbit_v.bytes));
+			XR.readRecords({0, 1}, {reinterpret_cast< char* > (abit_v.bytes), reinterpret_cast< char* > (bbit_v.bytes)});
 			update_distances_common(abit_v,bbit_v);
 		}
 		// ... in sparse haplotype format
 		else if (atype == RECORD_SPARSE_HAPLOTYPE)
 		{
 			asparse_v.resize(XR.bin_size[0]/ sizeof(int32_t));
-			XR.readRecord(0, reinterpret_cast< char* > (asparse_v.data()));
 			bsparse_v.resize(XR.bin_size[1]/ sizeof(int32_t));
-			XR.readRecord(1, reinterpret_cast< char* > (bsparse_v.data()));
+			XR.readRecords({0, 1}, {reinterpret_cast< char* > (asparse_v.data()), reinterpret_cast< char* > (bsparse_v.data())});
 			update_distances_rare(asparse_v,bsparse_v);
 		}
 		// ... format is unsupported
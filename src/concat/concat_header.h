@@ -41,6 +41,10 @@ public:
 
 	std::vector < std::string > filenames;
 	std::vector < int > prev_readers;
+	int bin_io;
+	bool bin_index;
+	bool async_write;
+	bool bin_compress;
 
 	//SAMPLE DATA
 
@@ -43,12 +43,16 @@ void concat::declare_options() {
 	bpo::options_description opt_par ("Parameters");
 	opt_par.add_options()
 			("naive", "Concatenate files without recompression, a header check compatibility is performed")
-			("ligate", "Ligate phased XCF files");
+			("ligate", "Ligate phased XCF files")
+			("bin-io", bpo::value< std::string >()->default_value("stream"), "Access to the binary files in ligate mode [stream|mmap|prefetch|block[:Mb]|direct[:Mb]|uring]");
 
 	bpo::options_description opt_output ("Output files");
 	opt_output.add_options()
 			("output,o", bpo::value< std::string >(), "Output ligated file in XCF format")
 			("out-only-bcf","Outputs BCF file only (only available in naive mode)")
+			("async-write","Write output records and binary payload from a dedicated I/O thread (only used in ligate mode)")
+			("bin-compress","Compress the binary file in independent deflate blocks (only used in ligate mode)")
+			("bin-index","Also write a .bin.idx sidecar with per-variant SEEK, AC and AN columns")
 			("log", bpo::value< std::string >(), "Log file");
 
 	descriptions.add(opt_base).add(opt_input).add(opt_par).add(opt_output);
@@ -87,6 +91,12 @@ void concat::check_options() {
 
 	if (options.count("threads") && options["threads"].as < int > () < 1)
 		vrb.error("You must use at least 1 thread");
+
+	bin_index = options.count("bin-index");
+	async_write = options.count("async-write");
+	bin_compress = options.count("bin-compress");
+	bin_io = binary_io::parse_mode(options["bin-io"].as < std::string > ());
+	if (bin_io < 0) vrb.error("Binary file access [" + options["bin-io"].as < std::string > () + "] unrecognized");
 }
 
 void concat::verbose_files() {
@@ -124,6 +134,10 @@ void concat::verbose_options() {
 
 	vrb.bullet("Seed     : " + stb.str(options["seed"].as < int > ()));
 	vrb.bullet("Threads  : " + stb.str(options["threads"].as < int > ()) + " threads");
+	if (options.count("ligate")) vrb.bullet("Bin I/O  : " + binary_io::name_mode(bin_io));
+	if (bin_index) vrb.bullet("Bin index: .bin.idx sidecar written");
+	if (async_write && options.count("ligate")) vrb.bullet("Async write: enabled");
+	if (bin_compress && options.count("ligate")) vrb.bullet("Bin compress: enabled");
 
 
 }
@@ -48,23 +48,30 @@ void fill_tags::set_counts(const uint32_t pop, const bool a0,const bool a1)
 	++pop_counts[pop].ns;
 }
 
+void fill_tags::set_haploid(const uint32_t pop, const bool a)
+{
+	++pop_counts[pop].nhom[a];
+	++pop_counts[pop].ns;
+}
+
 void fill_tags::run_algorithm()
 {
 	tac.clock();
 	vrb.title("[Fill-tags] Preparing output");
 	xcf_reader XR(A.mNumThreads);
+	XR.setBinaryIO(A.mBinIO);
+	if (A.mDecodeThread) XR.useDecodeThread();
 	const uint32_t idx_file = XR.addFile(A.mInputFilename);
 	const int32_t typef = XR.typeFile(idx_file);
 	if (typef != FILE_BINARY) vrb.error("[" + A.mInputFilename + "] is not a XCF file");
 	nsamples = XR.ind_names[idx_file].size();
+	mask.set(XR.ind_ploidy[idx_file]);
 	process_families(XR, idx_file);
 	process_populations(XR,idx_file);
 	xcf_writer XW(A.mOutputFilename, false, A.mNumThreads, false);
 	prepare_output(XR,XW,idx_file);
 
 	vrb.title("[Fill-tags] Processing variants");
-	binary_bit_buf.allocate(2 * nsamples);
-	sparse_int_buf.resize(2 * nsamples,0);
 	std::vector<double> hwe_probs;
 	uint32_t n_lines = 0;
 
@@ -78,6 +85,8 @@ void fill_tags::run_algorithm()
 		if (++n_lines % 100000 == 0) vrb.bullet("Number of XCF records processed: N = " + stb.str(n_lines));
 	}
 	vrb.bullet("Number of XCF variants processed: N = " + stb.str(n_lines));
+	vrb.bullet("Throughput: " + stb.str(n_lines * 1000.0 / std::max(1u, tac.rel_time()), 0) + " records/s");
+	XR.reportBinaryIO();
 
 	finalize_tags(XR,idx_file);
 	XR.close();
@@ -111,18 +120,29 @@ void fill_tags::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 	for (auto p=0; p<pop_counts.size(); ++p)
 			pop_counts[p].reset();
 
-	const int32_t type = XR.typeRecord(idx_file);
+	const int32_t type = helper_tools::plainType(XR.typeRecord(idx_file));
+
+	//View on the binary record [no copy with --bin-io mmap]
+	const char * payload = NULL;
+	const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+	const int32_t * sparse_buf = reinterpret_cast< const int32_t * > (payload);
+	uint32_t n_sparse = n_bytes / sizeof(int32_t);
+
+	//Varint coded sparse records are expanded into the plain index array [PBWT records are viewed decoded]
+	if (XR.typeRecord(idx_file) == RECORD_SPARSE_GENOTYPE_VB || XR.typeRecord(idx_file) == RECORD_SPARSE_HAPLOTYPE_VB) {
+		n_sparse = sparse_codec::decode(payload, n_bytes, sparse_vb_buf);
+		sparse_buf = sparse_vb_buf.data();
+	}
 
 	//Convert from BCF; copy the data over
 	if (type == RECORD_BCFVCF_GENOTYPE)
 		vrb.warning("VCF/BCF record type [" + stb.str(type) + "] at " + XR.chr + ":" + stb.str(XR.pos));
 	//Convert from binary genotypes
 	else if (type == RECORD_BINARY_GENOTYPE) {
-		const int32_t n_elements = XR.readRecord(idx_file, reinterpret_cast< char* > (&binary_bit_buf.bytes[0]));
 		for(uint32_t i = 0 ; i < nsamples ; i++)
 		{
-			const bool a0 = binary_bit_buf.get(2*i+0);
-			const bool a1 = binary_bit_buf.get(2*i+1);
+			const bool a0 = bitvector::get(payload, 2*i+0);
+			const bool a1 = bitvector::get(payload, 2*i+1);
 			const bool missing = (a0 == true && a1 == false);
 			for (auto f=0; f<samples2fam[i].size();++f)
 				fam_trio[samples2fam[i][f]].set_gt(i,missing?-1:a0+a1);
@@ -134,11 +154,10 @@ void fill_tags::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 	//Convert from binary haplotypes
 	else if (type == RECORD_BINARY_HAPLOTYPE)
 	{
-		const int32_t n_elements = XR.readRecord(idx_file, reinterpret_cast< char* > (&binary_bit_buf.bytes[0]));
 		for(uint32_t i = 0 ; i < nsamples ; i++)
 		{
-			const bool a0 = binary_bit_buf.get(2*i+0);
-			const bool a1 = binary_bit_buf.get(2*i+1);
+			const bool a0 = bitvector::get(payload, 2*i+0);
+			const bool a1 = bitvector::get(payload, 2*i+1);
 			for (auto f=0; f<samples2fam[i].size();++f)
 				fam_trio[samples2fam[i][f]].set_gt(i,a0+a1);
 			for (auto p=0; p<samples2pop[i].size(); ++p)
@@ -148,14 +167,12 @@ void fill_tags::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 	}
 	//Convert from sparse genotypes
 	else if (type == RECORD_SPARSE_GENOTYPE) {
-		sparse_int_buf.resize(XR.bin_size[idx_file]/ sizeof(int32_t));
-		XR.readRecord(idx_file, reinterpret_cast< char* > (sparse_int_buf.data()));
 		const bool major = (XR.getAF(idx_file)>0.5f);
 		for (auto f=0; f<fam_trio.size();++f) fam_trio[f].reset((int8_t)major*2);
 
-		for(uint32_t r = 0 ; r < sparse_int_buf.size() ; r++)
+		for(uint32_t r = 0 ; r < n_sparse ; r++)
 		{
-			sparse_genotype rg(sparse_int_buf[r]);
+			sparse_genotype rg(sparse_buf[r]);
 			for (auto f=0; f<samples2fam[rg.idx].size();++f)
 				fam_trio[samples2fam[rg.idx][f]].set_gt(rg.idx,rg.mis?-1:rg.al0+rg.al1);
 			for (auto p=0; p<samples2pop[rg.idx].size(); ++p)
@@ -166,17 +183,15 @@ void fill_tags::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 	}
 	else if (type == RECORD_SPARSE_HAPLOTYPE)
 	{
-		sparse_int_buf.resize(XR.bin_size[idx_file]/ sizeof(int32_t));
-		if (sparse_int_buf.size()==0) vrb.error("buffer resize.");
-		XR.readRecord(idx_file, reinterpret_cast< char* > (sparse_int_buf.data()));
+		if (n_sparse==0) vrb.error("buffer resize.");
 		const bool major = (XR.getAF()>0.5f);
 		for (auto f=0; f<fam_trio.size();++f) fam_trio[f].reset((int8_t)major*2);
-		for(uint32_t r = 0 ; r < sparse_int_buf.size() ; r++)
+		for(uint32_t r = 0 ; r < n_sparse ; r++)
 		{
-			const int32_t hap_idx = sparse_int_buf[r];
+			const int32_t hap_idx = sparse_buf[r];
 			const int32_t ind_idx = hap_idx/2;
 			const bool a0 = !major;
-			const bool a1=(hap_idx%2==0 && r<sparse_int_buf.size()-1 && sparse_int_buf[r+1]==hap_idx+1)? a0 : major;
+			const bool a1=(hap_idx%2==0 && r<n_sparse-1 && sparse_buf[r+1]==hap_idx+1)? a0 : major;
 			for (auto f=0; f<samples2fam[ind_idx].size();++f)
 				fam_trio[samples2fam[ind_idx][f]].set_gt(ind_idx,a0+a1);
 			for (auto p=0; p<samples2pop[ind_idx].size(); ++p)
@@ -186,6 +201,25 @@ void fill_tags::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 		for (auto p=0; p<pop_names.size(); ++p)
 			set_sparse(p, major);
 	}
+	//Convert from haploid-aware records [haploid genotypes count a single allele]
+	else if (type == RECORD_BINARY_MIXED || type == RECORD_SPARSE_MIXED)
+	{
+		if (!mask.mixed()) vrb.error("Haploid-aware record at " + XR.chr + ":" + stb.str(XR.pos) + " without ploidy in the .fam file");
+		mixed_gt.resize(2 * nsamples);
+		if (type == RECORD_BINARY_MIXED) mask.decodeBinary(payload, mixed_gt.data());
+		else mask.decodeSparse(sparse_buf, n_sparse, XR.getAF(idx_file)>0.5f, mixed_gt.data());
+		for(uint32_t i = 0 ; i < nsamples ; i++)
+		{
+			const bool haploid = (mixed_gt[2*i+1] == bcf_int32_vector_end);
+			const bool missing = bcf_gt_is_missing(mixed_gt[2*i+0]) || (!haploid && bcf_gt_is_missing(mixed_gt[2*i+1]));
+			const bool a0 = (bcf_gt_allele(mixed_gt[2*i+0]) == 1);
+			const bool a1 = haploid ? a0 : (bcf_gt_allele(mixed_gt[2*i+1]) == 1);
+			for (auto f=0; f<samples2fam[i].size();++f)
+				fam_trio[samples2fam[i][f]].set_gt(i,missing?-1:a0+a1);
+			for (auto p=0; p<samples2pop[i].size(); ++p)
+				missing ? set_missing(samples2pop[i][p]) : (haploid ? set_haploid(samples2pop[i][p], a0) : set_counts(samples2pop[i][p], a0, a1));
+		}
+	}
 	//Unknown record type
 	else vrb.warning("Unrecognized genotype record type [" + stb.str(type) + "] at " + XR.chr + ":" + stb.str(XR.pos));
 }
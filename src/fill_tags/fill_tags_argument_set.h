@@ -27,6 +27,7 @@
 #define _FILL_TAGS_ARGUMENT_SET_H
 
 #include "../utils/otools.h"
+#include "../utils/binary_io.h"
 #include "../../versions/versions.h"
 
 #define SET_AN      (1<<0)
@@ -108,6 +109,10 @@ public:
     std::string mTagsString;
     uint32_t mTags;
 
+    std::string mBinIOString;
+    int32_t mBinIO;
+    bool mDecodeThread;
+
 	bool mOutOnlyBcf;
 
 
@@ -129,6 +134,8 @@ public:
         			("help", "Produce help message")
 					("threads", boost::program_options::value<uint32_t>(&mNumThreads)->default_value(1), "Number of threads.")
 					("seed", boost::program_options::value<uint32_t>(&mSeed)->default_value(42), "Seed for RNG.")
+					("bin-io", bpo::value< std::string >(&mBinIOString)->default_value("stream"), "Access to binary files [stream/mmap/prefetch/block[:Mb]/direct[:Mb]/uring]")
+					("decode-thread", "Decode input records in a separate thread")
 					;
 
         	bpo::options_description opt_input ("Input files");
@@ -192,7 +199,11 @@ public:
     		vrb.error("At least one tag has to be specified");
 
     	mTags = parse_tags(mTagsString);
+
+    	mBinIO = binary_io::parse_mode(mBinIOString);
+    	if (mBinIO < 0) vrb.error("Unsupported binary file access [" + mBinIOString + "], use stream, mmap, prefetch, block[:Mb], direct[:Mb] or uring");
     	mOutOnlyBcf = options.count("out-only-bcf");
+    	mDecodeThread = options.count("decode-thread");
     }
 
     void verbose_files() const
@@ -219,6 +230,8 @@ public:
     	vrb.title("Other parameters");
     	vrb.bullet("Seed                : [" + stb.str(mSeed) + "]");
     	vrb.bullet("#Threads            : [" + stb.str(mNumThreads) + "]");
+    	vrb.bullet("Binary I/O          : [" + mBinIOString + "]");
+    	vrb.bullet("Decode thread       : [" + no_yes[mDecodeThread] + "]");
     }
 
     uint32_t parse_tags(const std::string str)
@@ -200,14 +200,12 @@ public:
 	std::vector < int > mendel_errors;
 	std::vector < int > mendel_totals_fam_all;
 	std::vector < int > mendel_totals_fam_minor;
+	std::vector < int32_t > sparse_vb_buf;
+	ploidy_mask mask;
+	std::vector < int32_t > mixed_gt;
 
 	//std::vector < int > mendel_totals_pop;
 
-	//Buffer for input/output
-
-	bitvector binary_bit_buf;
-	std::vector<int32_t> sparse_int_buf;
-
 	//CONSTRUCTOR
 	fill_tags(std::vector < std::string > &);
 	~fill_tags();
@@ -224,6 +222,7 @@ public:
 	void set_sparse(const uint32_t pop, const bool major);
 	void set_missing(const uint32_t pop);
 	void set_counts(const uint32_t pop,const bool a0, const bool a1);
+	void set_haploid(const uint32_t pop,const bool a);
 	void read_files_and_initialise();
 	void hdr_append(bcf_hdr_t* out_hdr);
 	void prepare_output(const xcf_reader& XR, xcf_writer& XW,const uint32_t idx_file);
@@ -27,6 +27,7 @@
 #include <viewer/viewer_header.h>
 #include <concat/concat_header.h>
 #include <fill_tags/fill_tags_header.h>
+#include <transpose/transpose_header.h>
 
 #include "../versions/versions.h"
 
@@ -37,7 +38,7 @@ int main(int argc, char ** argv) {
 
 	string mode = (argc>1)?string(argv[1]):"";
 
-	if (argc == 1 || (mode != "view" && mode != "concat" && mode != "fill-tags")) {
+	if (argc == 1 || (mode != "view" && mode != "concat" && mode != "fill-tags" && mode != "transpose")) {
 
 		vrb.title("[XCFtools] Manage XCF files");
 		vrb.bullet("Authors       : Olivier DELANEAU and Simone RUBINACCI");
@@ -50,6 +51,7 @@ int main(int argc, char ** argv) {
 		vrb.bullet("[view]\t| Converts between XCF and BCF files");
 		vrb.bullet("[concat]\t| Concat multiple XCF files together");
 		vrb.bullet("[fill-tags]\t| Set INFO tags AF, AC, AC_Hom, AC_Het, AN, ExcHet, HWE, MAF, NS. [Note: AC_Hemi, FORMAT tag VAF, custom INFO/TAG=func(FMT/TAG) not supported]");
+		vrb.bullet("[transpose]\t| Builds a sample-major companion of a XCF file and extracts samples from it");
 
 	} else {
 		//Get args
@@ -67,6 +69,9 @@ int main(int argc, char ** argv) {
 		else if (mode == "fill-tags") {
 			fill_tags(args).run();
 		}
+		else if (mode == "transpose") {
+			transpose().run(args);
+		}
 	}
 	return 0;
 }
@@ -30,20 +30,386 @@
 #include <utils/xcf.h>
 #include <utils/bitvector.h>
 #include <utils/sparse_genotype.h>
+#include <utils/sparse_codec.h>
+#include <utils/gt_kernel.h>
+#include <modes/record_selector.h>
+#include <modes/genotype_encoder.h>
 
 using namespace std;
 
-bcf2binary::bcf2binary(string _region, float _minmaf, int _nthreads, int _mode, bool _drop_info) {
+bcf2binary::bcf2binary(string _region, float _minmaf, int _nthreads, int _mode, bool _drop_info, bool _bin_index, bool _decode_thread, bool _async_write, bool _bin_compress, uint32_t _bin_tiles, int _encode_threads) {
 	mode = _mode;
 	nthreads = _nthreads;
 	region = _region;
 	minmaf = _minmaf;
 	drop_info = _drop_info;
+	bin_index = _bin_index;
+	decode_thread = _decode_thread;
+	async_write = _async_write;
+	bin_compress = _bin_compress;
+	bin_tiles = _bin_tiles;
+	encode_threads = _encode_threads;
 }
 
 bcf2binary::~bcf2binary() {
 }
 
+//READ THE CURRENT RECORD OF [XR] INTO [R]
+void bcf2binary::read(xcf_reader & XR, xcf_writer & XW, bcf2binary_record & R) {
+	R.chr = XR.chr;
+	R.pos = XR.pos;
+	R.ref = XR.ref;
+	R.alt = XR.alt;
+	R.rsid = XR.rsid;
+	R.AC = XR.getAC();
+	R.AN = XR.getAN();
+	R.af = XR.getAF();
+
+	//Dosage records: FORMAT/DS or GP, genotypes are not read
+	if (dosage_bits) {
+		if (!XR.readDosages(0, R.dosages)) vrb.error("No FORMAT/DS or FORMAT/GP field at " + XR.chr + ":" + stb.str(XR.pos));
+	} else {
+		//Records going to binary types: raw GT bytes, packed into bits at encoding
+		const bool binary = (mode != CONV_BCF_AUTO) && (conv == CONV_BCF_BG || conv == CONV_BCF_BH || min(R.af, 1.0f-R.af) >= minmaf);
+		const bcf_hdr_t * hdr = XR.sync_reader->readers[0].header;
+		const int8_t * gt = (binary && XR.split_allele == 0) ? gt_kernel::raw(hdr, XR.sync_lines[0], nsamples) : NULL;
+		R.raw = (gt != NULL) && (memchr(gt, bcf_int8_vector_end, 2 * nsamples) == NULL);
+		if (R.raw) {
+			R.gt8.assign(gt, gt + 2 * nsamples);
+			R.n_probs = (conv == CONV_BCF_PP && gt_kernel::count(hdr, XR.sync_lines[0], "PP") == 1) ? nsamples : 0;
+		}
+	}
+	if (!dosage_bits && !R.raw) {
+		R.n_probs = 0;
+		if (conv == CONV_BCF_PP) XR.readRecord(0, reinterpret_cast< char** > (&R.genotypes), reinterpret_cast< char** > (&R.probs), &R.n_probs);
+		else XR.readRecord(0, reinterpret_cast< char** > (&R.genotypes));
+
+		//Ploidy mask taken from the first record with haploid genotypes [e.g. first record out of PAR1 on chrX]
+		//It is set here, in record order, so that it is known before any haploid record gets encoded
+		if (!mask.mixed()) {
+			bool haploid = false;
+			for (uint32_t i = 0 ; i < nsamples && !haploid ; i++) haploid = (ploidy_mask::ploidyOf(R.genotypes, i) == 1);
+			if (haploid) {
+				vector < uint8_t > ploidy (nsamples);
+				for (uint32_t i = 0 ; i < nsamples ; i++) ploidy[i] = ploidy_mask::ploidyOf(R.genotypes, i);
+				mask.set(ploidy);
+			}
+		}
+	}
+
+	//Site information without FORMAT fields
+	if (!drop_info) {
+		bcf_subset(XW.hts_hdr, XR.sync_lines[0], 0, 0);//to remove format from XR's bcf1_t
+		bcf_copy(R.line, XR.sync_lines[0]);
+	}
+}
+
+//ENCODE RECORD [R] IN ITS TARGET TYPE
+void bcf2binary::encode(bcf2binary_record & R, record_selector & selector) {
+	//Is that a rare variant?
+	float maf = min(R.af, 1.0f-R.af);
+	bool minor = (R.af < 0.5f);
+	bool rare = (maf < minmaf);
+	R.hasPP = false;
+	R.fallback = false;
+	R.n_sparse_bytes = 0;
+	R.rare = rare;
+	R.n_sparse = R.n_random = 0;
+
+	//Dosage records
+	if (dosage_bits) {
+		R.target = R.type = rare ? RECORD_SPARSE_DOSAGE : RECORD_DENSE_DOSAGE;
+		R.n_bytes = dosage_codec::encode(R.dosages.data(), nsamples, dosage_bits, rare, minor ? 0 : 2, R.payload);
+		R.data = R.payload.data();
+		R.n_lines = 1;
+		return;
+	}
+
+	int32_t * input_buffer = R.genotypes;
+	R.hasPP = (R.n_probs == nsamples);
+
+	//Raw diploid GT bytes of a binary record [no haploid genotype, not rare in sparse modes]
+	if (R.raw) {
+		R.target = R.type = (conv == CONV_BCF_BG || conv == CONV_BCF_SG) ? RECORD_BINARY_GENOTYPE : RECORD_BINARY_HAPLOTYPE;
+		if (R.type == RECORD_BINARY_HAPLOTYPE) {
+			R.bits_mis.resize(R.binary.n_bytes);
+			if (gt_kernel::pack(R.gt8.data(), 2 * nsamples, R.binary.bytes, R.bits_mis.data(), NULL)) vrb.error("Missing data in phased data is not permitted!");
+		} else {
+			R.bits_alt.resize(R.binary.n_bytes);
+			R.bits_mis.resize(R.binary.n_bytes);
+			gt_kernel::pack(R.gt8.data(), 2 * nsamples, R.bits_alt.data(), R.bits_mis.data(), NULL);
+			gt_kernel::genotypes(R.bits_alt.data(), R.bits_mis.data(), R.binary.n_bytes, R.binary.bytes);
+		}
+		R.data = R.binary.bytes;
+		R.n_bytes = R.binary.n_bytes;
+		R.n_lines = nsamples;
+		return;
+	}
+
+	//Haploid genotypes are encoded against the ploidy mask
+	bool haploid = false;
+	for (uint32_t i = 0 ; i < nsamples && !haploid ; i++) haploid = (ploidy_mask::ploidyOf(input_buffer, i) == 1);
+	bool mixed = haploid && mask.match(input_buffer);
+
+	//Haploid genotypes not matching the mask are written as homozygous diploid genotypes
+	if (haploid && !mixed) {
+		for (uint32_t i = 0 ; i < nsamples ; i++) if (ploidy_mask::ploidyOf(input_buffer, i) == 1) input_buffer[2*i+1] = input_buffer[2*i+0];
+		R.fallback = true;
+	}
+
+	// Conversion mode
+	int32_t target_type = RECORD_BINARY_GENOTYPE;
+	if (conv == CONV_BCF_PP && rare && R.hasPP) target_type = RECORD_SPARSE_PHASEPROBS;
+	else if (conv == CONV_BCF_PP && rare) target_type = RECORD_SPARSE_HAPLOTYPE;
+	else if (conv == CONV_BCF_SG && rare) target_type = RECORD_SPARSE_GENOTYPE;
+	else if (conv == CONV_BCF_SH && rare) target_type = RECORD_SPARSE_HAPLOTYPE;
+	else if (conv == CONV_BCF_BH || conv == CONV_BCF_PP || conv == CONV_BCF_SH) target_type = RECORD_BINARY_HAPLOTYPE;
+	else target_type = RECORD_BINARY_GENOTYPE;
+	R.n_lines = 1;
+
+	//Auto mode: the choice waits for the writer when unphased hets have to be phased at random
+	if (mode == CONV_BCF_AUTO && !mixed) {
+		if (selector.prepare(input_buffer, R.af) == 0) {
+			R.target = R.type = selector.choose(rare);
+			//The selector is shared by the records encoded on the same thread, its payload is kept aside
+			R.payload.assign(selector.payload, selector.payload + selector.n_bytes);
+			R.data = R.payload.data();
+			R.n_bytes = selector.n_bytes;
+		} else {
+			R.haplotypes = selector.haplotypes;
+			R.n_sparse = selector.n_sparse;
+			R.n_random = selector.n_random;
+			memcpy(R.sparse, selector.sparse.data(), R.n_sparse * sizeof(int32_t));
+			memcpy(R.binary.bytes, selector.binary.bytes, R.binary.n_bytes);
+		}
+		return;
+	}
+
+	//Haploid-aware records: binary unless sparse is asked for rare variants, or smaller in auto mode
+	if (mixed) {
+		uint32_t n_mixed = 0;
+		bool binary = mask.binary(input_buffer);
+		if (mode == CONV_BCF_AUTO || !binary || (rare && conv != CONV_BCF_BG && conv != CONV_BCF_BH)) n_mixed = mask.encodeSparse(input_buffer, minor, R.mixed_sparse);
+		if (mode == CONV_BCF_AUTO) target_type = (!binary || n_mixed * sizeof(int32_t) < mask.n_bytes()) ? RECORD_SPARSE_MIXED : RECORD_BINARY_MIXED;
+		else target_type = (n_mixed > 0) ? RECORD_SPARSE_MIXED : RECORD_BINARY_MIXED;
+		R.target = R.type = target_type;
+		if (target_type == RECORD_SPARSE_MIXED) {
+			R.data = reinterpret_cast<char*>(R.mixed_sparse.data());
+			R.n_bytes = n_mixed * sizeof(int32_t);
+		} else {
+			R.payload.resize(mask.n_bytes());
+			mask.encodeBinary(input_buffer, R.payload.data());
+			R.data = R.payload.data();
+			R.n_bytes = R.payload.size();
+		}
+		return;
+	}
+
+	//Convert: one kernel per target type
+	genotype_encoder::counts c;
+	switch (target_type) {
+		case RECORD_SPARSE_PHASEPROBS: c = genotype_encoder::encode < RECORD_SPARSE_PHASEPROBS > (input_buffer, R.probs, nsamples, minor, R.sparse, R.sparse_probs, NULL); break;
+		case RECORD_SPARSE_GENOTYPE: c = genotype_encoder::encode < RECORD_SPARSE_GENOTYPE > (input_buffer, NULL, nsamples, minor, R.sparse, NULL, NULL); break;
+		case RECORD_SPARSE_HAPLOTYPE: c = genotype_encoder::encode < RECORD_SPARSE_HAPLOTYPE > (input_buffer, NULL, nsamples, minor, R.sparse, NULL, NULL); break;
+		case RECORD_BINARY_HAPLOTYPE: c = genotype_encoder::encode < RECORD_BINARY_HAPLOTYPE > (input_buffer, NULL, nsamples, minor, NULL, NULL, R.binary.bytes); break;
+		default: c = genotype_encoder::encode < RECORD_BINARY_GENOTYPE > (input_buffer, NULL, nsamples, minor, NULL, NULL, R.binary.bytes); break;
+	}
+	if (c.n_missing && (target_type ==  RECORD_SPARSE_PHASEPROBS || target_type == RECORD_SPARSE_HAPLOTYPE || target_type == RECORD_BINARY_HAPLOTYPE))
+		vrb.error("Missing data in phased data is not permitted!");
+	R.target = target_type;
+	R.n_sparse = c.n_sparse;
+	R.n_random = c.n_random;
+	R.n_lines = nsamples;
+
+	//Payload, unless unphased hets have to be phased at random first [writer]
+	if (R.n_random == 0) pack(R);
+}
+
+//BUILD THE PAYLOAD OF THE ENCODED RECORD [R] [sparse entries phased]
+void bcf2binary::pack(bcf2binary_record & R) {
+	R.type = R.target;
+	if (R.target == RECORD_SPARSE_PHASEPROBS && pp_bits) {
+		R.type = RECORD_SPARSE_PHASEPROBS_FP;
+		R.n_bytes = phaseprob_codec::encode(R.sparse, R.sparse_probs, R.n_sparse, pp_bits, R.payload);
+		R.data = R.payload.data();
+	} else if (R.target == RECORD_SPARSE_PHASEPROBS) {
+		R.n_bytes = R.n_sparse * (sizeof(int32_t) + sizeof(float));
+		R.payload.resize(R.n_bytes);
+		memcpy(R.payload.data(), R.sparse, R.n_sparse * sizeof(int32_t));
+		memcpy(R.payload.data() + R.n_sparse * sizeof(int32_t), R.sparse_probs, R.n_sparse * sizeof(float));
+		R.data = R.payload.data();
+	} else if (sparse_vb && (R.target == RECORD_SPARSE_GENOTYPE || R.target == RECORD_SPARSE_HAPLOTYPE)) {
+		R.type = (R.target == RECORD_SPARSE_GENOTYPE) ? RECORD_SPARSE_GENOTYPE_VB : RECORD_SPARSE_HAPLOTYPE_VB;
+		R.n_bytes = sparse_codec::encode(R.sparse, R.n_sparse, R.payload);
+		R.data = R.payload.data();
+		R.n_sparse_bytes = R.n_sparse * sizeof(int32_t);
+	} else if (R.target == RECORD_SPARSE_GENOTYPE || R.target == RECORD_SPARSE_HAPLOTYPE) {
+		R.data = reinterpret_cast<char*>(R.sparse);
+		R.n_bytes = R.n_sparse * sizeof(int32_t);
+	} else {
+		R.data = R.binary.bytes;
+		R.n_bytes = R.binary.n_bytes;
+	}
+}
+
+//WRITE RECORD [R], RECORDS HAVE TO COME IN ORDER
+void bcf2binary::write(xcf_writer & XW, bcf2binary_record & R, record_selector & selector) {
+	//Random phasing of unphased hets, drawn in record order, then payload
+	if (R.n_random && mode == CONV_BCF_AUTO) {
+		selector.haplotypes = R.haplotypes;
+		selector.n_sparse = R.n_sparse;
+		selector.n_random = R.n_random;
+		memcpy(selector.sparse.data(), R.sparse, R.n_sparse * sizeof(int32_t));
+		memcpy(selector.binary.bytes, R.binary.bytes, R.binary.n_bytes);
+		R.target = R.type = selector.choose(R.rare);
+		R.data = selector.payload;
+		R.n_bytes = selector.n_bytes;
+	} else if (R.n_random) {
+		genotype_encoder::phase(R.sparse, R.n_sparse);
+		pack(R);
+	}
+
+	//Summary
+	n_target_types[R.target]++;
+	if (R.hasPP) {
+		n_pp_lost += (R.target != RECORD_SPARSE_PHASEPROBS);
+		n_pp_kept += (R.target == RECORD_SPARSE_PHASEPROBS);
+	}
+	n_ploidy_fallback += R.fallback;
+	n_lines += R.n_lines;
+	if (sparse_vb && (R.target == RECORD_SPARSE_GENOTYPE || R.target == RECORD_SPARSE_HAPLOTYPE)) {
+		n_sparse_bytes += R.n_sparse_bytes;
+		n_sparse_vb_bytes += R.n_bytes;
+	}
+
+	//Copy over variant information
+	if (drop_info) XW.writeInfo(R.chr, R.pos, R.ref, R.alt, R.rsid, R.AC, R.AN);
+	else XW.hts_record = R.line;
+
+	//Write record
+	XW.writeRecord(R.type, R.data, R.n_bytes);
+
+	//Verbose
+	if (!dosage_bits && n_lines % 10000 == 0) {
+		vrb.bullet("Number of BCF records processed: [" + stb.str(n_target_types[RECORD_BINARY_GENOTYPE]) + " G, " +
+			stb.str(n_target_types[RECORD_BINARY_HAPLOTYPE]) + " H, " +
+			stb.str(n_target_types[RECORD_SPARSE_GENOTYPE]) + " SG, " +
+			stb.str(n_target_types[RECORD_SPARSE_HAPLOTYPE]) + " SH, " +
+			stb.str(n_target_types[RECORD_SPARSE_PHASEPROBS]) + " PP]");
+	}
+}
+
+//ONE RECORD AT A TIME ON THE CALLING THREAD
+void bcf2binary::convertSerial(xcf_reader & XR, xcf_writer & XW, record_selector & selector) {
+	bcf2binary_record R (nsamples);
+	while (XR.nextRecord()) {
+		//Lines that cannot be split [e.g. no ALT allele] carry no record
+		if (!XR.hasRecord(0)) continue;
+		read(XR, XW, R);
+		encode(R, selector);
+		write(XW, R, selector);
+	}
+}
+
+//PIPELINE: batches of records read on the calling thread, encoded by [encode_threads] workers and written in order by a writer thread
+void bcf2binary::convertPipeline(xcf_reader & XR, xcf_writer & XW, record_selector & selector) {
+	const uint32_t n_records = max(1UL, min((unsigned long)BCF2BINARY_BATCH_MAX, BCF2BINARY_BATCH_BYTES / (24UL * nsamples + 1)));
+	batches.resize(BCF2BINARY_BATCHES);
+	for (uint32_t b = 0 ; b < BCF2BINARY_BATCHES ; b ++) {
+		for (uint32_t r = 0 ; r < n_records ; r ++) batches[b].records.push_back(new bcf2binary_record (nsamples));
+		batches[b].n = batches[b].state = batches[b].n_next = batches[b].n_done = 0;
+		batches[b].id = numeric_limits < uint64_t >::max();
+	}
+	n_batches_read = n_batches_written = 0;
+	read_done = false;
+	vrb.bullet("Encoding pipeline: " + stb.str(encode_threads) + " workers / " + stb.str(n_records) + " records per batch");
+
+	//Workers encode with their own selector, merged afterwards for the summary
+	vector < record_selector * > selectors;
+	vector < thread > workers;
+	for (int t = 0 ; t < encode_threads ; t ++) {
+		selectors.push_back(new record_selector (nsamples));
+		workers.push_back(thread(&bcf2binary::encodeRun, this, selectors.back()));
+	}
+	thread writer (&bcf2binary::writeRun, this, &XW, &selector);
+
+	//Reader
+	bool more = true;
+	for (uint64_t r = 0 ; more ; r ++) {
+		bcf2binary_batch & B = batches[r % BCF2BINARY_BATCHES];
+		{
+			unique_lock < mutex > lock(pipe_mtx);
+			pipe_cv.wait(lock, [&] { return B.state == 0; });
+		}
+		B.n = 0;
+		while (B.n < n_records && (more = XR.nextRecord())) {
+			if (!XR.hasRecord(0)) continue;
+			read(XR, XW, *B.records[B.n ++]);
+		}
+		{
+			lock_guard < mutex > lock(pipe_mtx);
+			if (B.n) {
+				B.id = r;
+				B.n_next = B.n_done = 0;
+				B.state = 1;
+				n_batches_read ++;
+			}
+			read_done = !more;
+		}
+		pipe_cv.notify_all();
+	}
+
+	for (int t = 0 ; t < encode_threads ; t ++) workers[t].join();
+	writer.join();
+	for (int t = 0 ; t < encode_threads ; t ++) {
+		selector.merge(*selectors[t]);
+		delete selectors[t];
+	}
+	for (uint32_t b = 0 ; b < BCF2BINARY_BATCHES ; b ++) for (uint32_t r = 0 ; r < n_records ; r ++) delete batches[b].records[r];
+	batches.clear();
+}
+
+//WORKER: encode chunks of the oldest batch read and not yet fully claimed
+void bcf2binary::encodeRun(record_selector * selector) {
+	unique_lock < mutex > lock(pipe_mtx);
+	while (true) {
+		bcf2binary_batch * B = NULL;
+		pipe_cv.wait(lock, [&] {
+			for (uint32_t b = 0 ; b < BCF2BINARY_BATCHES ; b ++)
+				if (batches[b].state == 1 && batches[b].n_next < batches[b].n && (!B || batches[b].id < B->id)) B = &batches[b];
+			return B != NULL || read_done;
+		});
+		if (!B) break;
+		const uint32_t chunk = max(1U, B->n / (4U * encode_threads));
+		const uint32_t i0 = B->n_next, i1 = min(B->n, i0 + chunk);
+		B->n_next = i1;
+		lock.unlock();
+		for (uint32_t i = i0 ; i < i1 ; i ++) encode(*B->records[i], *selector);
+		lock.lock();
+		B->n_done += i1 - i0;
+		if (B->n_done == B->n) {
+			B->state = 2;
+			pipe_cv.notify_all();
+		}
+	}
+}
+
+//WRITER: write batches in reading order
+void bcf2binary::writeRun(xcf_writer * XW, record_selector * selector) {
+	unique_lock < mutex > lock(pipe_mtx);
+	for (uint64_t w = 0 ; ; w ++) {
+		bcf2binary_batch & B = batches[w % BCF2BINARY_BATCHES];
+		pipe_cv.wait(lock, [&] { return (B.id == w && B.state == 2) || (read_done && n_batches_read == w); });
+		if (B.id != w || B.state != 2) break;
+		lock.unlock();
+		for (uint32_t i = 0 ; i < B.n ; i ++) write(*XW, *B.records[i], *selector);
+		lock.lock();
+		B.state = 0;
+		n_batches_written ++;
+		pipe_cv.notify_all();
+	}
+}
+
 void bcf2binary::convert(string finput, string foutput) {
 	tac.clock();
 
@@ -53,16 +419,35 @@ void bcf2binary::convert(string finput, string foutput) {
 		case CONV_BCF_BH: vrb.title("Converting from BCF to XCF [Binary/Haplotype]"); break;
 		case CONV_BCF_SG: vrb.title("Converting from BCF to XCF [Sparse/Genotype]"); break;
 		case CONV_BCF_SH: vrb.title("Converting from BCF to XCF [Sparse/Haplotype]"); break;
-		case CONV_BCF_PP: vrb.title("Converting from BCF to XCF [Sparse/Genotype] + PP"); break;
+		case CONV_BCF_PP: vrb.title("Converting from BCF to XCF [Sparse/Genotype] + PP/float"); break;
+		case CONV_BCF_PP16: vrb.title("Converting from BCF to XCF [Sparse/Genotype] + PP/16 bits"); break;
+		case CONV_BCF_PP8: vrb.title("Converting from BCF to XCF [Sparse/Genotype] + PP/8 bits"); break;
+		case CONV_BCF_SGV: vrb.title("Converting from BCF to XCF [Sparse/Genotype/Varint]"); break;
+		case CONV_BCF_SHV: vrb.title("Converting from BCF to XCF [Sparse/Haplotype/Varint]"); break;
+		case CONV_BCF_PB: vrb.title("Converting from BCF to XCF [Sparse/Haplotype/PBWT]"); break;
+		case CONV_BCF_AUTO: vrb.title("Converting from BCF to XCF [Auto]"); break;
+		case CONV_BCF_DS8: vrb.title("Converting from BCF to XCF [Dosage/8 bits]"); break;
+		case CONV_BCF_DS16: vrb.title("Converting from BCF to XCF [Dosage/16 bits]"); break;
 	}
 
+	//Varint, PBWT and PP precision modes select records as their plain counterparts, only the payload coding differs
+	sparse_vb = (mode == CONV_BCF_SGV || mode == CONV_BCF_SHV);
+	conv = (mode == CONV_BCF_SGV) ? CONV_BCF_SG : ((mode == CONV_BCF_SHV || mode == CONV_BCF_PB) ? CONV_BCF_SH : mode);
+	if (mode == CONV_BCF_PP16 || mode == CONV_BCF_PP8) conv = CONV_BCF_PP;
+	pp_bits = (mode == CONV_BCF_PP16) ? 16 : ((mode == CONV_BCF_PP8) ? 8 : 0);
+	dosage_bits = (mode == CONV_BCF_DS8) ? 8 : ((mode == CONV_BCF_DS16) ? 16 : 0);
+
 	if (region.empty()) vrb.bullet("Region        : All");
 	else vrb.bullet("Region        : " + stb.str(region));
 
-	if (mode == CONV_BCF_SG || mode == CONV_BCF_SH) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (conv == CONV_BCF_SG || conv == CONV_BCF_SH || conv == CONV_BCF_AUTO || dosage_bits) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (pp_bits) vrb.bullet("PP coding     : [" + stb.str(pp_bits) + " bits fixed point / max error " + stb.str(phaseprob_codec::error(pp_bits), 6) + "]");
 
 	//Opening XCF reader for input
 	xcf_reader XR(region, nthreads);
+	if (decode_thread) XR.useDecodeThread();
+	XR.splitMultiallelic();
+	if (!dosage_bits) XR.parseTextGT(conv == CONV_BCF_PP);
 	int32_t idx_file = (finput == "-")? XR.addFile() : XR.addFile(finput);
 
 	//Check file type
@@ -71,11 +456,16 @@ void bcf2binary::convert(string finput, string foutput) {
 
 	//Get sample IDs
 	vector < string > samples;
-	int32_t nsamples = XR.getSamples(idx_file, samples);
+	nsamples = XR.getSamples(idx_file, samples);
 	vrb.bullet("#samples = " + stb.str(nsamples));
 
 	//Opening XCF writer for output [false means NO records in BCF body but in external BIN file]
 	xcf_writer XW(foutput, false, nthreads);
+	if (bin_index) XW.setBinaryIndex();
+	if (async_write) XW.setAsync();
+	if (bin_compress) XW.setCompression();
+	if (mode == CONV_BCF_PB) XW.setPBWT(2 * nsamples);
+	if (bin_tiles) XW.setTiling(bin_tiles);
 	bcf1_t* rec = XW.hts_record;
 
 	//Write header
@@ -84,115 +474,13 @@ void bcf2binary::convert(string finput, string foutput) {
 	XW.writeHeader(XR, string("XCFtools ") + string(XCFTLS_VERSION), !drop_info);
 	//XW.writeHeader(XR.sync_reader->readers[0].header, samples, string("XCFtools ") + string(XCFTLS_VERSION));
 
-	//Allocate input/output buffer
-	int32_t * input_buffer = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
-	int32_t * output_buffer = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
-	float * input_probs = (float *)malloc(nsamples * sizeof(float)); 
-	float * output_probs = (float *)malloc(nsamples * sizeof(float)); 
-	bitvector binary_buffer = bitvector (2 * nsamples);
-
 	//Proceed with conversion
-	uint32_t n_pp_lost = 0, n_pp_kept = 0, n_lines = 0;
-	vector < uint32_t > n_target_types = vector < uint32_t > (RECORD_NUMBER_TYPES, 0);
-	while (XR.nextRecord()) {
-		//Is that a rare variant?
-		float af =  XR.getAF();
-		float maf = min(af, 1.0f-af);
-		bool minor = (af < 0.5f);
-		bool rare = (maf < minmaf);
-		
-		//Get record
-		int32_t n_input_probs = 0;
-		if (CONV_BCF_PP) XR.readRecord(0, reinterpret_cast< char** > (&input_buffer), reinterpret_cast< char** > (&input_probs), &n_input_probs);
-		else XR.readRecord(0, reinterpret_cast< char** > (&input_buffer));
-		bool hasPP = (n_input_probs == nsamples);
-
-		// Conversion mode
-		int32_t target_type = RECORD_BINARY_GENOTYPE;
-		if (mode == CONV_BCF_PP && rare && hasPP) target_type = RECORD_SPARSE_PHASEPROBS;
-		else if (mode == CONV_BCF_PP && rare) target_type = RECORD_SPARSE_HAPLOTYPE;
-		else if (mode == CONV_BCF_SG && rare) target_type = RECORD_SPARSE_GENOTYPE;
-		else if (mode == CONV_BCF_SH && rare) target_type = RECORD_SPARSE_HAPLOTYPE;
-		else if (mode == CONV_BCF_BH || mode == CONV_BCF_PP || mode == CONV_BCF_SH) target_type = RECORD_BINARY_HAPLOTYPE;
-		else target_type = RECORD_BINARY_GENOTYPE;
-		if (hasPP) {
-			n_pp_lost += (target_type != RECORD_SPARSE_PHASEPROBS);
-			n_pp_kept += (target_type == RECORD_SPARSE_PHASEPROBS);
-		}
-		n_target_types[target_type]++;
-		
-		//Convert
-		uint32_t n_sparse = 0, n_sparse_probs = 0;
-		for (uint32_t i = 0 ; i < nsamples ; i++) {
-			bool a0 = (bcf_gt_allele(input_buffer[2*i+0])==1);
-			bool a1 = (bcf_gt_allele(input_buffer[2*i+1])==1);
-			bool mi = (input_buffer[2*i+0] == bcf_gt_missing || input_buffer[2*i+1] == bcf_gt_missing);
-			bool phased = (bcf_gt_is_phased(input_buffer[2*i+0]) || bcf_gt_is_phased(input_buffer[2*i+1])) && !mi;
-
-			if (mi && (target_type ==  RECORD_SPARSE_PHASEPROBS || target_type == RECORD_SPARSE_HAPLOTYPE || target_type == RECORD_BINARY_HAPLOTYPE))
-				vrb.error("Missing data in phased data is not permitted!");
-
-			if (target_type == RECORD_SPARSE_PHASEPROBS) {
-				if (a0 == minor || a1 == minor || mi) {
-					output_buffer[n_sparse++] = sparse_genotype(i, (a0!=a1), mi, a0, a1, phased).get();
-					output_probs[n_sparse_probs++] = input_probs[i];
-				}
-			}
-
-			if (target_type == RECORD_SPARSE_GENOTYPE) {
-				if (a0 == minor || a1 == minor || mi) {
-					output_buffer[n_sparse++] = sparse_genotype(i, (a0!=a1), mi, a0, a1, phased).get();
-				}
-			}
-
-			if (target_type == RECORD_SPARSE_HAPLOTYPE) {
-				if (a0 == minor) output_buffer[n_sparse++] = 2*i+0;
-				if (a1 == minor) output_buffer[n_sparse++] = 2*i+1;
-			}
-
-			if (target_type == RECORD_BINARY_HAPLOTYPE) {
-				binary_buffer.set(2*i+0, a0);
-				binary_buffer.set(2*i+1, a1);
-			}
-
-			if (target_type == RECORD_BINARY_GENOTYPE) {
-				if (mi) { binary_buffer.set(2*i+0, true); binary_buffer.set(2*i+1, false); }
-				else if (a0 == a1) { binary_buffer.set(2*i+0, a0); binary_buffer.set(2*i+1, a1); }
-				else { binary_buffer.set(2*i+0, false); binary_buffer.set(2*i+1, true); }
-			}
-
-			n_lines ++ ;
-		}
-
-		//Copy over variant information
-		if (drop_info) XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, XR.getAC(), XR.getAN());
-		else
-		{
-			XW.hts_record = XR.sync_lines[0];
-			bcf_subset(XW.hts_hdr, XW.hts_record, 0, 0);//to remove format from XR's bcf1_t
-		}
-
-		//Write record
-		if (target_type == RECORD_SPARSE_PHASEPROBS) {
-			uint32_t total_size = n_sparse * sizeof(int32_t) + n_sparse_probs * sizeof(float);
-			char * merged_array = (char *)malloc(total_size);
-			memcpy(merged_array, output_buffer, n_sparse * sizeof(int32_t));
-			memcpy(merged_array + n_sparse * sizeof(int32_t), output_probs, n_sparse_probs * sizeof(float));
-			XW.writeRecord(target_type, merged_array, total_size);
-			free(merged_array);
-		} else if (target_type == RECORD_SPARSE_GENOTYPE || target_type == RECORD_SPARSE_HAPLOTYPE) {
-			XW.writeRecord(target_type, reinterpret_cast<char*>(output_buffer), n_sparse * sizeof(int32_t));
-		} else XW.writeRecord(target_type, binary_buffer.bytes, binary_buffer.n_bytes);
-
-		//Verbose
-		if (n_lines % 10000 == 0) {
-			vrb.bullet("Number of BCF records processed: [" + stb.str(n_target_types[RECORD_BINARY_GENOTYPE]) + " G, " +
-				stb.str(n_target_types[RECORD_BINARY_HAPLOTYPE]) + " H, " +
-				stb.str(n_target_types[RECORD_SPARSE_GENOTYPE]) + " SG, " +
-				stb.str(n_target_types[RECORD_SPARSE_HAPLOTYPE]) + " SH, " +
-				stb.str(n_target_types[RECORD_SPARSE_PHASEPROBS]) + " PP]");
-		}
-	}
+	record_selector selector (nsamples);
+	n_target_types = vector < uint32_t > (RECORD_NUMBER_TYPES, 0);
+	n_pp_lost = n_pp_kept = n_lines = 0;
+	n_sparse_bytes = n_sparse_vb_bytes = n_ploidy_fallback = 0;
+	if (encode_threads > 0) convertPipeline(XR, XW, selector);
+	else convertSerial(XR, XW, selector);
 
 	vrb.bullet("Number of BCF records processed: [" + stb.str(n_target_types[RECORD_BINARY_GENOTYPE]) + " G, " +
 				stb.str(n_target_types[RECORD_BINARY_HAPLOTYPE]) + " H, " +
@@ -200,18 +488,24 @@ void bcf2binary::convert(string finput, string foutput) {
 				stb.str(n_target_types[RECORD_SPARSE_HAPLOTYPE]) + " SH, " +
 				stb.str(n_target_types[RECORD_SPARSE_PHASEPROBS]) + " PP]");
 
+	if (dosage_bits) vrb.bullet("Dosage records: " + stb.str(n_target_types[RECORD_DENSE_DOSAGE]) + " dense / " + stb.str(n_target_types[RECORD_SPARSE_DOSAGE]) + " sparse [" + stb.str(dosage_bits) + " bits]");
+	if (mask.mixed()) {
+		XW.setPloidy(mask.ploidy);
+		vrb.bullet("Haploid samples: " + stb.str(mask.n_haploid) + " / records [" + stb.str(n_target_types[RECORD_BINARY_MIXED]) + " binary, " + stb.str(n_target_types[RECORD_SPARSE_MIXED]) + " sparse]");
+	}
+	if (n_ploidy_fallback > 0) vrb.warning(stb.str(n_ploidy_fallback) + " records with a ploidy differing from the mask written with haploid genotypes as homozygous diploid ones");
+	if (XR.text_mode) vrb.bullet("VCF text lines: " + stb.str(XR.text_parser.n_fast) + " parsed on GT" + string(XR.text_pp ? "/PP" : "") + " only [" + stb.str(XR.text_parser.n_simd) + " samples by 8] / " + stb.str(XR.text_parser.n_full) + " parsed in full");
+	if (XR.split_lines > 0) vrb.bullet("Multi-allelic lines: " + stb.str(XR.split_lines) + " split into " + stb.str(XR.split_records) + " bi-allelic records");
+	if (mode == CONV_BCF_AUTO) selector.report();
+	if (sparse_vb && n_sparse_bytes > 0) vrb.bullet("Sparse payload: " + stb.str(n_sparse_vb_bytes) + " bytes varint coded / " + stb.str(n_sparse_bytes) + " bytes plain [" + stb.str(n_sparse_vb_bytes * 100.0 / n_sparse_bytes, 1) + "%]");
+
 	if (n_pp_lost > 0 || n_pp_kept > 0) {
 		vrb.bullet("Number of PP lost: " + stb.str(n_pp_lost) + " / kept: " + stb.str(n_pp_kept));
 		if (n_pp_lost > 0) vrb.warning("PP were not written for some rare variants, consider decreasing --maf value");
 	}
 
-	//Free
-	free(input_buffer);
-	free(output_buffer);
-
-	if (!drop_info) XW.hts_record = rec;
+	XW.hts_record = rec;
 	//Close files
 	XW.close();//always close XW first? important for multithreading if set
 	XR.close();
 }
-
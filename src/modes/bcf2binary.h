@@ -31,9 +31,91 @@
 #define CONV_BCF_BH	1
 #define CONV_BCF_SG	2
 #define CONV_BCF_SH	3
-#define CONV_BCF_PP 4
+#define CONV_BCF_PP 4		//Sparse/Genotype with phase probabilities as float [RECORD_SPARSE_PHASEPROBS]
+#define CONV_BCF_SGV 5		//Sparse/Genotype with delta+varint coded records
+#define CONV_BCF_SHV 6		//Sparse/Haplotype with delta+varint coded records
+#define CONV_BCF_PB 7		//Sparse/Haplotype with common variants coded in PBWT order
+#define CONV_BCF_AUTO 8		//Smallest encoding chosen for each record
+#define CONV_BCF_DS8 9		//Dosages from FORMAT/DS or GP in 8 bits fixed point
+#define CONV_BCF_DS16 10	//Dosages from FORMAT/DS or GP in 16 bits fixed point
+#define CONV_BCF_PP8 11		//Sparse/Genotype with phase probabilities in 8 bits fixed point
+#define CONV_BCF_PP16 12	//Sparse/Genotype with phase probabilities in 16 bits fixed point
+
+#define BCF2BINARY_BATCH_BYTES	(64*1024*1024)	//Genotype bytes per batch of the encoding pipeline
+#define BCF2BINARY_BATCH_MAX	1024				//Records per batch of the encoding pipeline
+#define BCF2BINARY_BATCHES		3					//Batches in flight [read, encoded, written]
 
 #include <utils/otools.h>
+#include <utils/xcf.h>
+#include <utils/bitvector.h>
+#include <modes/record_selector.h>
+
+//BCF record on its way through the conversion [read -> encoded -> written]
+class bcf2binary_record {
+public:
+	//Read
+	std::string chr, ref, alt, rsid;
+	uint32_t pos, AC, AN;
+	float af;
+	bcf1_t * line;							//Site without FORMAT fields [--keep-info]
+	int32_t * genotypes;
+	float * probs;
+	int32_t n_probs;
+	std::vector < float > dosages;
+	bool raw;								//Genotypes kept as raw int8 GT bytes [see gt_kernel.h]
+	std::vector < int8_t > gt8;
+
+	//Encoded
+	int32_t target;							//Type the record has been selected for
+	int32_t type;							//Type the payload is written with
+	char * data;
+	uint32_t n_bytes;
+	int32_t * sparse;
+	float * sparse_probs;
+	bitvector binary;
+	std::vector < int32_t > mixed_sparse;
+	std::vector < char > payload;
+	std::vector < char > bits_alt, bits_mis;
+	bool rare;
+	bool haplotypes;						//Auto mode: record prepared as haplotypes [see record_selector]
+	uint32_t n_sparse;
+	uint32_t n_random;						//Sparse genotypes left to phase at random, in record order
+	bool hasPP;
+	bool fallback;							//Haploid genotypes written as homozygous diploid ones
+	uint32_t n_lines;
+	uint32_t n_sparse_bytes;				//Plain bytes of a varint coded sparse record
+
+	bcf2binary_record(uint32_t nsamples) : binary(2 * nsamples) {
+		line = bcf_init1();
+		genotypes = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
+		probs = (float *)malloc(nsamples * sizeof(float));
+		sparse = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
+		sparse_probs = (float *)malloc(nsamples * sizeof(float));
+		n_probs = 0;
+		raw = false;
+		rare = haplotypes = false;
+		n_sparse = n_random = 0;
+	}
+
+	~bcf2binary_record() {
+		bcf_destroy1(line);
+		free(genotypes);
+		free(probs);
+		free(sparse);
+		free(sparse_probs);
+	}
+};
+
+//Records read and encoded together in the pipeline
+class bcf2binary_batch {
+public:
+	std::vector < bcf2binary_record * > records;
+	uint32_t n;
+	uint64_t id;							//Rank of the batch in reading order
+	uint32_t state;							//0: free, 1: read, 2: encoded
+	uint32_t n_next;						//Next record to be encoded
+	uint32_t n_done;						//Records encoded
+};
 
 class bcf2binary {
 public:
@@ -45,14 +127,49 @@ public:
 	int mode;
 	float minmaf;
 	bool drop_info;
+	bool bin_index;
+	bool decode_thread;
+	bool async_write;
+	bool bin_compress;
+	uint32_t bin_tiles;
+	int encode_threads;
+
+	//CONVERSION
+	int32_t conv;
+	bool sparse_vb;
+	uint32_t pp_bits;
+	uint32_t dosage_bits;
+	int32_t nsamples;
+	ploidy_mask mask;
+
+	//SUMMARY [written records]
+	std::vector < uint32_t > n_target_types;
+	uint32_t n_pp_lost, n_pp_kept, n_lines;
+	uint64_t n_sparse_bytes, n_sparse_vb_bytes;
+	uint64_t n_ploidy_fallback;
 
+	//PIPELINE
+	std::vector < bcf2binary_batch > batches;
+	uint64_t n_batches_read;
+	uint64_t n_batches_written;
+	bool read_done;
+	std::mutex pipe_mtx;
+	std::condition_variable pipe_cv;
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	bcf2binary(std::string, float, int, int, bool);
+	bcf2binary(std::string, float, int, int, bool, bool = false, bool = false, bool = false, bool = false, uint32_t = 0, int = 0);
 	~bcf2binary();
 
 	//PROCESS
 	void convert(std::string, std::string);
+	void read(xcf_reader &, xcf_writer &, bcf2binary_record &);
+	void encode(bcf2binary_record &, record_selector &);
+	void pack(bcf2binary_record &);
+	void write(xcf_writer &, bcf2binary_record &, record_selector &);
+	void convertSerial(xcf_reader &, xcf_writer &, record_selector &);
+	void convertPipeline(xcf_reader &, xcf_writer &, record_selector &);
+	void encodeRun(record_selector *);
+	void writeRun(xcf_writer *, record_selector *);
 };
 
 #endif
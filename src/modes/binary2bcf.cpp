@@ -33,10 +33,13 @@
 
 using namespace std;
 
-binary2bcf::binary2bcf(string _region, int _nthreads, bool _drop_info) {
+binary2bcf::binary2bcf(string _region, int _nthreads, bool _drop_info, int _bin_io, bool _decode_thread, bool _async_write) {
 	nthreads = _nthreads;
 	region = _region;
 	drop_info = _drop_info;
+	bin_io = _bin_io;
+	decode_thread = _decode_thread;
+	async_write = _async_write;
 }
 
 binary2bcf::~binary2bcf() {
@@ -51,6 +54,8 @@ void binary2bcf::convert(string finput, string foutput) {
 
 	//Opening XCF reader for input
 	xcf_reader XR(region, nthreads);
+	XR.setBinaryIO(bin_io);
+	if (decode_thread) XR.useDecodeThread();
 	int32_t idx_file = XR.addFile(finput);
 
 	//Get file type
@@ -59,11 +64,14 @@ void binary2bcf::convert(string finput, string foutput) {
 
 	//Get sample IDs
 	vector < string > samples;
-	int32_t nsamples = XR.getSamples(idx_file, samples);
+	nsamples = XR.getSamples(idx_file, samples);
 	vrb.bullet("#samples = " + stb.str(nsamples));
+	mask.set(XR.ind_ploidy[idx_file]);
+	if (mask.mixed()) vrb.bullet("#haploid samples = " + stb.str(mask.n_haploid));
 
 	//Opening XCF writer for output [true means records are written in BCF body]
 	xcf_writer XW(foutput, true, nthreads);
+	if (async_write) XW.setAsync();
 
 	//Write header
 	//XW.writeHeader(XR.sync_reader->readers[0].header, samples, string("XCFtools ") + string(XCFTLS_VERSION));
@@ -74,134 +82,74 @@ void binary2bcf::convert(string finput, string foutput) {
 	int32_t * input_buffer = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
 	int32_t * output_buffer = (int32_t*)malloc(2 * nsamples * sizeof(int32_t));
 
-	//Buffer for binary data
-	bitvector binary_buffer = bitvector(2 * nsamples);
+	//View on binary data [points into the mapped file with --bin-io mmap]
+	const char * payload = NULL;
 
 	//Buffer for phase probs
 	float * probabilities = (float*)malloc(nsamples * sizeof(float));
 
 	//Proceed with conversion
 	uint32_t n_lines = 0;
-	while (XR.nextRecord())
+
+	//Minimal INFO: variants are read and decoded by batches
+	if (drop_info) {
+		xcf_batch batch;
+		while (XR.nextBatch(idx_file, batch, BINARY2BCF_BATCH)) {
+			for (uint32_t b = 0 ; b < batch.n ; b ++) {
+				//Copy over variant information
+				XW.writeInfo(batch.chr[b], batch.pos[b], batch.ref[b], batch.alt[b], batch.rsid[b], batch.AC[b], batch.AN[b]);
+
+				//Dosage records go to FORMAT/DS
+				if (write_dosages(XW, batch.type[b], batch.data(b), batch.size[b])) { n_lines++; continue; }
+
+				//Decode genotypes
+				bool flagProbabilities = decode(batch.type[b], batch.data(b), batch.size[b], batch.getAF(b), output_buffer, probabilities, batch.chr[b], batch.pos[b]);
+
+				//Write record
+				if (flagProbabilities)
+					XW.writeRecord(RECORD_BCFVCF_GENOTYPE, reinterpret_cast<char*>(output_buffer), 2 * nsamples * sizeof(int32_t), reinterpret_cast<char*>(probabilities));
+				else
+					XW.writeRecord(RECORD_BCFVCF_GENOTYPE, reinterpret_cast<char*>(output_buffer), 2 * nsamples * sizeof(int32_t));
+
+				//Counting
+				n_lines++;
+
+				//Verbose
+				if (n_lines % 10000 == 0) vrb.bullet("Number of XCF records processed: N = " + stb.str(n_lines));
+			}
+		}
+	}
+
+	//Full INFO: variants are read one at a time to keep the BCF records
+	else while (XR.nextRecord())
 	{
 		//Copy over variant information
-		if (drop_info)
-			XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, XR.getAC(), XR.getAN());
-		else
-			XW.hts_record = XR.sync_lines[0];
+		XW.hts_record = XR.sync_lines[0];
 
 		//Get type of record
 		bool flagProbabilities = false;
 		type = XR.typeRecord(idx_file);
 
+		//Dosage records go to FORMAT/DS
+		if (type == RECORD_DENSE_DOSAGE || type == RECORD_SPARSE_DOSAGE) {
+			int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+			write_dosages(XW, type, payload, n_bytes);
+			n_lines++;
+			continue;
+		}
+
 		//Convert from BCF; copy the data over
 		if (type == RECORD_BCFVCF_GENOTYPE) {
 			XR.readRecord(idx_file, reinterpret_cast< char** > (&input_buffer));
 			memcpy(output_buffer, input_buffer, 2 * nsamples * sizeof(int32_t));
 		}
 
-		//Convert from binary genotypes
-		else if (type == RECORD_BINARY_GENOTYPE) {
-			int n = XR.readRecord(idx_file, reinterpret_cast< char** > (&binary_buffer.bytes));
-			for(uint32_t i = 0 ; i < nsamples ; i++) {
-				bool a0 = binary_buffer.get(2*i+0);
-				bool a1 = binary_buffer.get(2*i+1);
-				if (a0 == true && a1 == false) {
-					output_buffer[2*i+0] = bcf_gt_missing;
-					output_buffer[2*i+1] = bcf_gt_missing;
-				} else {
-					output_buffer[2*i+0] = bcf_gt_unphased(a0);
-					output_buffer[2*i+1] = bcf_gt_unphased(a1);
-				}
-			}
-		}
-
-		//Convert from binary haplotypes
-		else if (type == RECORD_BINARY_HAPLOTYPE) {
-			XR.readRecord(idx_file, reinterpret_cast< char** > (&binary_buffer.bytes));
-			for(uint32_t i = 0 ; i < nsamples ; i++) {
-				bool a0 = binary_buffer.get(2*i+0);
-				bool a1 = binary_buffer.get(2*i+1);
-				output_buffer[2*i+0] = bcf_gt_phased(a0);
-				output_buffer[2*i+1] = bcf_gt_phased(a1);
-			}
-		}
-
-		//Convert from sparse genotypes
-		else if (type == RECORD_SPARSE_GENOTYPE) {
-			int32_t n_elements = XR.readRecord(idx_file, reinterpret_cast< char** > (&input_buffer)) / sizeof(int32_t);
-			//Set all genotypes as major
-			bool major = (XR.getAF()>0.5f);
-			std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_unphased(major));
-			//Loop over sparse genotypes
-			for(uint32_t r = 0 ; r < n_elements ; r++) {
-				sparse_genotype rg;
-				rg.set(input_buffer[r]);
-                assert(rg.idx < nsamples);
-				if (rg.mis) {
-					output_buffer[2*rg.idx+0] = bcf_gt_missing;
-					output_buffer[2*rg.idx+1] = bcf_gt_missing;
-				} else if (rg.pha) {
-					output_buffer[2*rg.idx+0] = bcf_gt_phased(rg.al0);
-					output_buffer[2*rg.idx+1] = bcf_gt_phased(rg.al1);
-				} else {
-					output_buffer[2*rg.idx+0] = bcf_gt_unphased(rg.al0);
-					output_buffer[2*rg.idx+1] = bcf_gt_unphased(rg.al1);
-				}
-			}
+		//Convert from binary records
+		else {
+			int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+			flagProbabilities = decode(type, payload, n_bytes, XR.getAF(), output_buffer, probabilities, XR.chr, XR.pos);
 		}
 
-		//Convert from sparse genotypes+PP
-		else if (type == RECORD_SPARSE_PHASEPROBS) {
-			int32_t n_elements = XR.readRecord(idx_file, reinterpret_cast< char** > (&input_buffer)) / (2*sizeof(int32_t));
-			//Set all genotypes as major
-			bool major = (XR.getAF()>0.5f);
-			std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_phased(major));
-			//Loop over sparse genotypes
-			for(uint32_t r = 0 ; r < n_elements ; r++) {
-				sparse_genotype rg;
-				rg.set(input_buffer[r]);
-				//cout << "Sparse genotype: " << rg.idx << " m=" << rg.mis << " p=" << rg.pha << " a0=" << rg.al0 << " a1=" << rg.al1 << endl;
-				assert(rg.idx < nsamples);
-				if (rg.mis) {
-					output_buffer[2*rg.idx+0] = bcf_gt_missing;
-					output_buffer[2*rg.idx+1] = bcf_gt_missing;
-				} else if (rg.pha) {
-					output_buffer[2*rg.idx+0] = bcf_gt_phased(rg.al0);
-					output_buffer[2*rg.idx+1] = bcf_gt_phased(rg.al1);
-				} else vrb.bullet ("Sparse genotype with unphased alleles found in sparse phase probabilities record at " + XR.chr + ":" + stb.str(XR.pos) + ". This is not supported.");
-			}
-			if (sizeof(float) != sizeof(uint32_t)) vrb.error("PP format requires float to be 4 bytes long, which is not the case on this platform");
-			//Init probabilities
-			for (uint32_t i = 0 ; i < nsamples ; i++) bcf_float_set_missing(probabilities[i]);
-			for(uint32_t r = 0 ; r < n_elements ; r++) {
-				if (input_buffer[n_elements + r] != bcf_float_missing) {
-					float prob = bit_cast<float>(input_buffer[n_elements + r]);
-					sparse_genotype rg;
-					rg.set(input_buffer[r]);
-					probabilities[rg.idx] = std::round(prob * 1000) / 1000;
-				}
-			}
-			flagProbabilities = true;
-		}
-		//Convert from sparse haplotypes
-		else if (type == RECORD_SPARSE_HAPLOTYPE) {
-			int32_t n_elements = XR.readRecord(idx_file, reinterpret_cast< char** > (&input_buffer)) / sizeof(int32_t);
-			//Set all genotypes as major
-			bool major = (XR.getAF()>0.5f);
-			std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_phased(major));
-			//Loop over sparse genotypes
-			for(uint32_t r = 0 ; r < n_elements ; r++)
-			{
-				assert(input_buffer[r] < 2*nsamples);
-				output_buffer[input_buffer[r]] = bcf_gt_phased(!major);
-			}
-		}
-
-		//Unknown record type
-		else vrb.bullet("Unrecognized record type [" + stb.str(type) + "] at " + XR.chr + ":" + stb.str(XR.pos));
-
-
 		//Write record
 		if (flagProbabilities)
 			XW.writeRecord(RECORD_BCFVCF_GENOTYPE, reinterpret_cast<char*>(output_buffer), 2 * nsamples * sizeof(int32_t), reinterpret_cast<char*>(probabilities));
@@ -216,6 +164,8 @@ void binary2bcf::convert(string finput, string foutput) {
 	}
 
 	vrb.bullet("Number of XCF records processed: N = " + stb.str(n_lines));
+	vrb.bullet("Throughput: " + stb.str(n_lines * 1000.0 / std::max(1u, tac.rel_time()), 0) + " records/s");
+	XR.reportBinaryIO();
 
 	//Free
 	free(probabilities);
@@ -228,3 +178,141 @@ void binary2bcf::convert(string finput, string foutput) {
 	XW.close();
 	XR.close();
 }
+
+bool binary2bcf::write_dosages(xcf_writer & XW, int32_t type, const char * payload, uint32_t n_bytes) {
+	if (type != RECORD_DENSE_DOSAGE && type != RECORD_SPARSE_DOSAGE) return false;
+	dosages.resize(nsamples);
+	dosage_codec::decode(payload, n_bytes, nsamples, type == RECORD_SPARSE_DOSAGE, dosages.data());
+	XW.writeDosages(dosages.data(), nsamples);
+	return true;
+}
+
+bool binary2bcf::decode(int32_t type, const char * payload, uint32_t n_bytes, float af, int32_t * output_buffer, float * probabilities, const string & chr, uint32_t pos) {
+	bool flagProbabilities = false;
+
+	//Expand varint coded sparse records into the index array of their plain counterpart
+	if (type == RECORD_SPARSE_GENOTYPE_VB || type == RECORD_SPARSE_HAPLOTYPE_VB) {
+		n_bytes = sparse_codec::decode(payload, n_bytes, sparse_vb_buf) * sizeof(int32_t);
+		payload = reinterpret_cast< const char * > (sparse_vb_buf.data());
+	}
+
+	//PBWT records are handed out decoded by the reader
+	type = helper_tools::plainType(type);
+
+	//Convert from binary genotypes
+	if (type == RECORD_BINARY_GENOTYPE) {
+		for(uint32_t i = 0 ; i < nsamples ; i++) {
+			bool a0 = bitvector::get(payload, 2*i+0);
+			bool a1 = bitvector::get(payload, 2*i+1);
+			if (a0 == true && a1 == false) {
+				output_buffer[2*i+0] = bcf_gt_missing;
+				output_buffer[2*i+1] = bcf_gt_missing;
+			} else {
+				output_buffer[2*i+0] = bcf_gt_unphased(a0);
+				output_buffer[2*i+1] = bcf_gt_unphased(a1);
+			}
+		}
+	}
+
+	//Convert from binary haplotypes
+	else if (type == RECORD_BINARY_HAPLOTYPE) {
+		for(uint32_t i = 0 ; i < nsamples ; i++) {
+			bool a0 = bitvector::get(payload, 2*i+0);
+			bool a1 = bitvector::get(payload, 2*i+1);
+			output_buffer[2*i+0] = bcf_gt_phased(a0);
+			output_buffer[2*i+1] = bcf_gt_phased(a1);
+		}
+	}
+
+	//Convert from sparse genotypes
+	else if (type == RECORD_SPARSE_GENOTYPE) {
+		int32_t n_elements = n_bytes / sizeof(int32_t);
+		const int32_t * sparse_buffer = reinterpret_cast< const int32_t * > (payload);
+		//Set all genotypes as major
+		bool major = (af>0.5f);
+		std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_unphased(major));
+		//Loop over sparse genotypes
+		for(uint32_t r = 0 ; r < n_elements ; r++) {
+			sparse_genotype rg;
+			rg.set(sparse_buffer[r]);
+			assert(rg.idx < nsamples);
+			if (rg.mis) {
+				output_buffer[2*rg.idx+0] = bcf_gt_missing;
+				output_buffer[2*rg.idx+1] = bcf_gt_missing;
+			} else if (rg.pha) {
+				output_buffer[2*rg.idx+0] = bcf_gt_phased(rg.al0);
+				output_buffer[2*rg.idx+1] = bcf_gt_phased(rg.al1);
+			} else {
+				output_buffer[2*rg.idx+0] = bcf_gt_unphased(rg.al0);
+				output_buffer[2*rg.idx+1] = bcf_gt_unphased(rg.al1);
+			}
+		}
+	}
+
+	//Convert from sparse genotypes+PP [probabilities as float or in fixed point]
+	else if (type == RECORD_SPARSE_PHASEPROBS || type == RECORD_SPARSE_PHASEPROBS_FP) {
+		int32_t n_elements = n_bytes / (2*sizeof(int32_t));
+		const int32_t * sparse_buffer = reinterpret_cast< const int32_t * > (payload);
+		const float * sparse_probs = reinterpret_cast< const float * > (sparse_buffer + n_elements);
+		if (type == RECORD_SPARSE_PHASEPROBS_FP) {
+			n_elements = phaseprob_codec::decode(payload, n_bytes, pp_gts, pp_probs);
+			sparse_buffer = pp_gts.data();
+			sparse_probs = pp_probs.data();
+		}
+		//Set all genotypes as major
+		bool major = (af>0.5f);
+		std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_phased(major));
+		//Loop over sparse genotypes
+		for(uint32_t r = 0 ; r < n_elements ; r++) {
+			sparse_genotype rg;
+			rg.set(sparse_buffer[r]);
+			//cout << "Sparse genotype: " << rg.idx << " m=" << rg.mis << " p=" << rg.pha << " a0=" << rg.al0 << " a1=" << rg.al1 << endl;
+			assert(rg.idx < nsamples);
+			if (rg.mis) {
+				output_buffer[2*rg.idx+0] = bcf_gt_missing;
+				output_buffer[2*rg.idx+1] = bcf_gt_missing;
+			} else if (rg.pha) {
+				output_buffer[2*rg.idx+0] = bcf_gt_phased(rg.al0);
+				output_buffer[2*rg.idx+1] = bcf_gt_phased(rg.al1);
+			} else vrb.bullet ("Sparse genotype with unphased alleles found in sparse phase probabilities record at " + chr + ":" + stb.str(pos) + ". This is not supported.");
+		}
+		if (sizeof(float) != sizeof(uint32_t)) vrb.error("PP format requires float to be 4 bytes long, which is not the case on this platform");
+		//Init probabilities
+		for (uint32_t i = 0 ; i < nsamples ; i++) bcf_float_set_missing(probabilities[i]);
+		for(uint32_t r = 0 ; r < n_elements ; r++) {
+			if (!bcf_float_is_missing(sparse_probs[r])) {
+				float prob = sparse_probs[r];
+				sparse_genotype rg;
+				rg.set(sparse_buffer[r]);
+				probabilities[rg.idx] = std::round(prob * 1000) / 1000;
+			}
+		}
+		flagProbabilities = true;
+	}
+	//Convert from sparse haplotypes
+	else if (type == RECORD_SPARSE_HAPLOTYPE) {
+		int32_t n_elements = n_bytes / sizeof(int32_t);
+		const int32_t * sparse_buffer = reinterpret_cast< const int32_t * > (payload);
+		//Set all genotypes as major
+		bool major = (af>0.5f);
+		std::fill(output_buffer, output_buffer+2*nsamples, bcf_gt_phased(major));
+		//Loop over sparse genotypes
+		for(uint32_t r = 0 ; r < n_elements ; r++)
+		{
+			assert(sparse_buffer[r] < 2*nsamples);
+			output_buffer[sparse_buffer[r]] = bcf_gt_phased(!major);
+		}
+	}
+
+	//Convert from haploid-aware records
+	else if (type == RECORD_BINARY_MIXED || type == RECORD_SPARSE_MIXED) {
+		if (!mask.mixed()) vrb.error("Haploid-aware record at " + chr + ":" + stb.str(pos) + " without ploidy in the .fam file");
+		if (type == RECORD_BINARY_MIXED) mask.decodeBinary(payload, output_buffer);
+		else mask.decodeSparse(reinterpret_cast< const int32_t * > (payload), n_bytes / sizeof(int32_t), af > 0.5f, output_buffer);
+	}
+
+	//Unknown record type
+	else vrb.bullet("Unrecognized record type [" + stb.str(type) + "] at " + chr + ":" + stb.str(pos));
+
+	return flagProbabilities;
+}
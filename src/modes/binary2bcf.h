@@ -32,7 +32,13 @@
 #define CONV_BCF_SG	2
 #define CONV_BCF_SH	3
 
+#define BINARY2BCF_BATCH	1024		//Number of variants decoded per batch
+
 #include <utils/otools.h>
+#include <utils/binary_io.h>
+#include <utils/ploidy_mask.h>
+
+class xcf_writer;
 
 
 class binary2bcf {
@@ -42,13 +48,24 @@ public:
 	std::string region;
 	bool drop_info;
 	int nthreads;
+	int bin_io;
+	bool decode_thread;
+	bool async_write;
+	int32_t nsamples;
+	std::vector < int32_t > sparse_vb_buf;
+	ploidy_mask mask;
+	std::vector < float > dosages;
+	std::vector < int32_t > pp_gts;
+	std::vector < float > pp_probs;
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	binary2bcf(std::string, int, bool);
+	binary2bcf(std::string, int, bool, int = BINIO_STREAM, bool = false, bool = false);
 	~binary2bcf();
 
 	//PROCESS
 	void convert(std::string, std::string);
+	bool decode(int32_t, const char *, uint32_t, float, int32_t *, float *, const std::string &, uint32_t);
+	bool write_dosages(xcf_writer &, int32_t, const char *, uint32_t);
 };
 
 #endif
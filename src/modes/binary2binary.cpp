@@ -27,10 +27,20 @@
 #include <modes/binary2binary.h>
 #include <utils/xcf.h>
 #include <utils/sparse_genotype.h>
+#include <modes/record_selector.h>
+#include <modes/genotype_encoder.h>
 
-binary2binary::binary2binary(std::string _region, float _minmaf, int _nthreads, int _mode, bool _drop_info)
+binary2binary::binary2binary(std::string _region, float _minmaf, int _nthreads, int _mode, bool _drop_info, int _bin_io, bool _bin_index, bool _async_write, bool _bin_compress, uint32_t _bin_tiles)
 {
-	mode = _mode;
+	bin_io = _bin_io;
+	bin_index = _bin_index;
+	async_write = _async_write;
+	bin_compress = _bin_compress;
+	bin_tiles = _bin_tiles;
+	//Varint and PBWT modes behave as their plain sparse counterparts, only the coding of the written payload differs
+	sparse_vb = (_mode == CONV_BCF_SGV || _mode == CONV_BCF_SHV);
+	pbwt = (_mode == CONV_BCF_PB);
+	mode = (_mode == CONV_BCF_SGV) ? CONV_BCF_SG : ((_mode == CONV_BCF_SHV || _mode == CONV_BCF_PB) ? CONV_BCF_SH : _mode);
 	nthreads = _nthreads;
 	region = _region;
 	minmaf = _minmaf;
@@ -47,25 +57,110 @@ int32_t binary2binary::parse_genotypes(xcf_reader& XR, const uint32_t idx_file)
 	const int32_t type = XR.typeRecord(idx_file);
 	int32_t n_elements = XR.ind_names[idx_file].size();
 	if (type == RECORD_BCFVCF_GENOTYPE) {
-		XR.readRecord(idx_file, reinterpret_cast< char** > (&sparse_int_buf));
+		XR.readRecord(idx_file, reinterpret_cast< char* > (sparse_int_buf.data()));
 	}
-	else if (type == RECORD_BINARY_GENOTYPE) {
-		XR.readRecord(idx_file, reinterpret_cast< char** > (&binary_bit_buf.bytes));
+	else if (type == RECORD_BINARY_GENOTYPE || type == RECORD_BINARY_GENOTYPE_TILED) {
+		XR.readRecord(idx_file, binary_bit_buf.bytes);
 	}
-	else if (type == RECORD_BINARY_HAPLOTYPE) {
-		XR.readRecord(idx_file, reinterpret_cast< char** > (&binary_bit_buf.bytes));
+	else if (type == RECORD_BINARY_HAPLOTYPE || type == RECORD_PBWT_HAPLOTYPE || type == RECORD_BINARY_HAPLOTYPE_TILED) {
+		XR.readRecord(idx_file, binary_bit_buf.bytes);
 	}
 	else if (type == RECORD_SPARSE_GENOTYPE) {
-		n_elements = XR.readRecord(idx_file, reinterpret_cast< char** > (&sparse_int_buf)) / sizeof(int32_t);
+		n_elements = XR.readRecord(idx_file, reinterpret_cast< char* > (sparse_int_buf.data())) / sizeof(int32_t);
 	}
 	else if (type == RECORD_SPARSE_HAPLOTYPE) {
-		n_elements = XR.readRecord(idx_file, reinterpret_cast< char** > (&sparse_int_buf)) / sizeof(int32_t);
+		n_elements = XR.readRecord(idx_file, reinterpret_cast< char* > (sparse_int_buf.data())) / sizeof(int32_t);
+	}
+	else if (type == RECORD_SPARSE_GENOTYPE_VB || type == RECORD_SPARSE_HAPLOTYPE_VB) {
+		const char * payload = NULL;
+		const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+		n_elements = sparse_codec::decode(payload, n_bytes, sparse_int_buf);
 	}
 	else vrb.bullet("Unrecognized record type [" + stb.str(type) + "] at " + XR.chr + ":" + stb.str(XR.pos));
 
 	return n_elements;
 }
 
+void binary2binary::write_sparse(xcf_writer& XW, const int32_t type, const int32_t * buffer, const int32_t n_elements)
+{
+	if (sparse_vb) {
+		const uint32_t n_bytes = sparse_codec::encode(buffer, n_elements, sparse_vb_buf);
+		XW.writeRecord((type == RECORD_SPARSE_GENOTYPE) ? RECORD_SPARSE_GENOTYPE_VB : RECORD_SPARSE_HAPLOTYPE_VB, sparse_vb_buf.data(), n_bytes);
+	} else XW.writeRecord(type, reinterpret_cast<char*>(const_cast<int32_t*>(buffer)), n_elements * sizeof(int32_t));
+}
+
+//Encode genotypes on a ploidy mask [haploid-aware records], same type selection as bcf2binary
+void binary2binary::write_mixed(xcf_writer& XW, const ploidy_mask& m, const int32_t * gt, const bool minor, const bool rare)
+{
+	const bool binary = m.binary(gt);
+	uint32_t n = 0;
+	if (mode == CONV_BCF_AUTO || !binary || (rare && (mode == CONV_BCF_SG || mode == CONV_BCF_SH))) n = m.encodeSparse(gt, minor, mixed_sparse);
+	if (n > 0 && (mode != CONV_BCF_AUTO || !binary || n * sizeof(int32_t) < m.n_bytes()))
+		XW.writeRecord(RECORD_SPARSE_MIXED, reinterpret_cast<char*>(mixed_sparse.data()), n * sizeof(int32_t));
+	else {
+		mixed_bits.resize(m.n_bytes());
+		m.encodeBinary(gt, mixed_bits.data());
+		XW.writeRecord(RECORD_BINARY_MIXED, mixed_bits.data(), mixed_bits.size());
+	}
+}
+
+//Encode diploid genotypes [haploid-aware records once no haploid sample is kept], same type selection as convert
+void binary2binary::write_diploid(xcf_writer& XW, record_selector& selector, const int32_t * gt, const uint32_t n, const float af, const bool rare)
+{
+	const bool minor = (af < 0.5f);
+	if (mode == CONV_BCF_AUTO)
+	{
+		selector.select(gt, af, rare);
+		XW.writeRecord(selector.type, selector.payload, selector.n_bytes);
+	}
+	else if ((mode == CONV_BCF_SG || mode == CONV_BCF_SH) && rare)
+	{
+		mixed_sparse.resize(2 * n);
+		const int32_t type = (mode == CONV_BCF_SG) ? RECORD_SPARSE_GENOTYPE : RECORD_SPARSE_HAPLOTYPE;
+		const genotype_encoder::counts c = (mode == CONV_BCF_SG) ?
+			genotype_encoder::encode < RECORD_SPARSE_GENOTYPE > (gt, NULL, n, minor, mixed_sparse.data(), NULL, NULL) :
+			genotype_encoder::encode < RECORD_SPARSE_HAPLOTYPE > (gt, NULL, n, minor, mixed_sparse.data(), NULL, NULL);
+		if (c.n_random) genotype_encoder::phase(mixed_sparse.data(), c.n_sparse);
+		write_sparse(XW, type, mixed_sparse.data(), c.n_sparse);
+	}
+	else
+	{
+		mixed_bits.resize((2 * n + 7) / 8);
+		const int32_t type = (mode == CONV_BCF_SG || mode == CONV_BCF_BG) ? RECORD_BINARY_GENOTYPE : RECORD_BINARY_HAPLOTYPE;
+		if (type == RECORD_BINARY_GENOTYPE) genotype_encoder::encode < RECORD_BINARY_GENOTYPE > (gt, NULL, n, minor, NULL, NULL, mixed_bits.data());
+		else genotype_encoder::encode < RECORD_BINARY_HAPLOTYPE > (gt, NULL, n, minor, NULL, NULL, mixed_bits.data());
+		XW.writeRecord(type, mixed_bits.data(), mixed_bits.size());
+	}
+}
+
+//Expand a record into BCF genotypes [genotype_buf], used to re-encode records in auto mode
+void binary2binary::expand_genotypes(const int32_t type, const char * bits, const int32_t * sparse, const int32_t n_sparse, const uint32_t nsamples, const bool major)
+{
+	genotype_buf.resize(2 * nsamples);
+	int32_t * gt = genotype_buf.data();
+	if (type == RECORD_BINARY_GENOTYPE) {
+		for (uint32_t i = 0 ; i < nsamples ; i++) {
+			const bool a0 = bitvector::get(bits, 2*i+0);
+			const bool a1 = bitvector::get(bits, 2*i+1);
+			gt[2*i+0] = (a0 && !a1) ? bcf_gt_missing : bcf_gt_unphased(a0);
+			gt[2*i+1] = (a0 && !a1) ? bcf_gt_missing : bcf_gt_unphased(a1);
+		}
+	} else if (type == RECORD_BINARY_HAPLOTYPE) {
+		for (uint32_t i = 0 ; i < 2 * nsamples ; i++) gt[i] = bcf_gt_phased(bitvector::get(bits, i));
+	} else if (type == RECORD_SPARSE_GENOTYPE) {
+		std::fill(gt, gt + 2 * nsamples, bcf_gt_unphased(major));
+		for (int32_t r = 0 ; r < n_sparse ; r++) {
+			sparse_genotype rg(sparse[r]);
+			if (rg.mis) gt[2*rg.idx+0] = gt[2*rg.idx+1] = bcf_gt_missing;
+			else if (rg.pha) { gt[2*rg.idx+0] = bcf_gt_phased(rg.al0); gt[2*rg.idx+1] = bcf_gt_phased(rg.al1); }
+			else { gt[2*rg.idx+0] = bcf_gt_unphased(rg.al0); gt[2*rg.idx+1] = bcf_gt_unphased(rg.al1); }
+		}
+	} else if (type == RECORD_SPARSE_HAPLOTYPE) {
+		std::fill(gt, gt + 2 * nsamples, bcf_gt_phased(major));
+		for (int32_t r = 0 ; r < n_sparse ; r++) gt[sparse[r]] = bcf_gt_phased(!major);
+	} else vrb.error("Unsupported record type [" + stb.str(type) + "] for auto encoding");
+}
+
 void binary2binary::convert(std::string finput, std::string foutput)
 {
 	tac.clock();
@@ -75,21 +170,31 @@ void binary2binary::convert(std::string finput, std::string foutput)
 		case CONV_BCF_BH: vrb.title("Converting from XCF to XCF [Binary/Haplotype]"); break;
 		case CONV_BCF_SG: vrb.title("Converting from XCF to XCF [Sparse/Genotype]"); break;
 		case CONV_BCF_SH: vrb.title("Converting from XCF to XCF [Sparse/Haplotype]"); break;
+		case CONV_BCF_AUTO: vrb.title("Converting from XCF to XCF [Auto]"); break;
 	}
 
 	if (region.empty()) vrb.bullet("Region        : All");
 	else vrb.bullet("Region        : " + stb.str(region));
 
-	if (mode == CONV_BCF_SG || mode == CONV_BCF_SH) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (mode == CONV_BCF_SG || mode == CONV_BCF_SH || mode == CONV_BCF_AUTO) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (sparse_vb) vrb.bullet("Sparse coding : [delta/varint]");
+	if (pbwt) vrb.bullet("Common coding : [PBWT runs]");
 
 	xcf_reader XR(region, nthreads);
+	XR.setBinaryIO(bin_io);
 	const int32_t idx_file = XR.addFile(finput);
 	//xcf_reader XR(1);
 	//const uint32_t idx_file = XR.addFile(finput);
 	const int32_t typef = XR.typeFile(idx_file);
 	if (typef != FILE_BINARY) vrb.error("[" + finput + "] is not a XCF file");
 	uint32_t nsamples_input = XR.ind_names[idx_file].size();
+	mask.set(XR.ind_ploidy[idx_file]);
 	xcf_writer XW(foutput, false, nthreads);
+	if (bin_index) XW.setBinaryIndex();
+	if (async_write) XW.setAsync();
+	if (bin_compress) XW.setCompression();
+	if (pbwt) XW.setPBWT(2 * nsamples_input);
+	if (bin_tiles) XW.setTiling(bin_tiles);
 	bcf1_t* rec = XW.hts_record;
 
 	//if (drop_info) XW.writeHeader(XR.sync_reader->readers[0].header, XR.ind_names[idx_file], std::string("XCFtools ") + std::string(XCFTLS_VERSION));
@@ -100,6 +205,7 @@ void binary2binary::convert(std::string finput, std::string foutput)
 	sparse_int_buf.resize(2 * nsamples_input,0);
 
 	uint32_t n_lines_rare = 0, n_lines_comm = 0;
+	record_selector selector (nsamples_input);
 
 	while (XR.nextRecord())
 	{
@@ -114,14 +220,31 @@ void binary2binary::convert(std::string finput, std::string foutput)
 		else
 			XW.hts_record = XR.sync_lines[0];
 
+		//Haploid-aware and dosage records are copied over, their payload does not depend on the target mode
+		const int32_t type_record = XR.typeRecord(idx_file);
+		if (type_record == RECORD_BINARY_MIXED || type_record == RECORD_SPARSE_MIXED || type_record == RECORD_DENSE_DOSAGE || type_record == RECORD_SPARSE_DOSAGE)
+		{
+			const char * payload = NULL;
+			const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+			XW.writeRecord(type_record, const_cast<char*>(payload), n_bytes);
+			n_lines_comm ++;
+			continue;
+		}
+
 		int32_t n_elements = parse_genotypes(XR,idx_file);
-		const int32_t type = XR.typeRecord(idx_file);
+		const int32_t type = helper_tools::plainType(XR.typeRecord(idx_file));
 
 		//Write record
-		if (mode == CONV_BCF_SG && rare)
+		if (mode == CONV_BCF_AUTO)
+		{
+			expand_genotypes(type, binary_bit_buf.bytes, sparse_int_buf.data(), n_elements, nsamples_input, !minor);
+			selector.select(genotype_buf.data(), af, rare);
+			XW.writeRecord(selector.type, selector.payload, selector.n_bytes);
+		}
+		else if (mode == CONV_BCF_SG && rare)
 		{
 			if (type==RECORD_SPARSE_GENOTYPE)
-				XW.writeRecord(RECORD_SPARSE_GENOTYPE, reinterpret_cast<char*>(sparse_int_buf.data()), n_elements * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_GENOTYPE, sparse_int_buf.data(), n_elements);
 			else if (type==RECORD_BINARY_GENOTYPE)
 			{
 				//conversion: BINARY gen -> sparse
@@ -132,14 +255,14 @@ void binary2binary::convert(std::string finput, std::string foutput)
 					const bool a1 = binary_bit_buf.get(2*i+1);
 					sparse_int_buf[n_elements++] = sparse_genotype(i, (a0!=a1), (a0 && !a1), a0, a1, 0).get();
 				}
-				XW.writeRecord(RECORD_SPARSE_GENOTYPE, reinterpret_cast<char*>(sparse_int_buf.data()), n_elements * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_GENOTYPE, sparse_int_buf.data(), n_elements);
 			}
 			else vrb.error("Converting non-genotype type to genotype type!");
 		}
 		else if (mode == CONV_BCF_SH && rare)
 		{
 			if (type==RECORD_SPARSE_HAPLOTYPE)
-				XW.writeRecord(RECORD_SPARSE_HAPLOTYPE, reinterpret_cast<char*>(sparse_int_buf.data()), n_elements * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_HAPLOTYPE, sparse_int_buf.data(), n_elements);
 			else if (type==RECORD_BINARY_HAPLOTYPE)
 			{
 				//conversion: BINARY hap -> sparse
@@ -149,7 +272,7 @@ void binary2binary::convert(std::string finput, std::string foutput)
 			        if (binary_bit_buf.get(i) == true)
 			        	sparse_int_buf[n_elements++]=i;
 			    }
-				XW.writeRecord(RECORD_SPARSE_HAPLOTYPE, reinterpret_cast<char*>(sparse_int_buf.data()), n_elements * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_HAPLOTYPE, sparse_int_buf.data(), n_elements);
 			}
 			else vrb.error("Converting non-haplotype type to haplotype type!");
 		}
@@ -202,6 +325,9 @@ void binary2binary::convert(std::string finput, std::string foutput)
 	}
 	if (mode == CONV_BCF_BG || mode == CONV_BCF_BH) vrb.bullet("Number of records processed: N=" + stb.str(n_lines_comm));
 	else vrb.bullet("Number of records processed: Nc=" + stb.str(n_lines_comm) + "/ Nr=" + stb.str(n_lines_rare));
+	vrb.bullet("Throughput: " + stb.str((n_lines_comm + n_lines_rare) * 1000.0 / std::max(1u, tac.rel_time()), 0) + " records/s");
+	if (mode == CONV_BCF_AUTO) selector.report();
+	XR.reportBinaryIO();
 
 	if (!drop_info) XW.hts_record = rec;
 
@@ -220,16 +346,19 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 
 	//Opening XCF reader for input
 	xcf_reader XR(region, nthreads);
+	XR.setBinaryIO(bin_io);
 	int32_t idx_file = XR.addFile(finput);
 	const int32_t typef = XR.typeFile(idx_file);
 	if (typef != FILE_BINARY) vrb.error("[" + finput + "] is not a XCF file");
 	uint32_t nsamples_input = XR.ind_names[idx_file].size();
+	mask.set(XR.ind_ploidy[idx_file]);
 
 	std::vector<std::string> sample_names;
 	std::vector<std::string> sample_fathers;
 	std::vector<std::string> sample_mothers;
 	std::vector<std::string> sample_pops;
 	std::vector<int32_t> subs2full;
+	std::vector<int32_t> subs_samples;
 	std::vector<int32_t> full2subs(2*nsamples_input,-1);
 	bitvector subsample_bit;
 
@@ -259,6 +388,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 			sample_fathers.push_back(XR.ind_fathers[idx_file][i]);
 			sample_mothers.push_back(XR.ind_mothers[idx_file][i]);
 			sample_pops.push_back(XR.ind_pops[idx_file][i]);
+			subs_samples.push_back(i);
 
             int32_t full_index = (mode == CONV_BCF_BG || mode == CONV_BCF_SG) ? i : i * 2;
             subs2full.push_back(full_index);
@@ -314,6 +444,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 			sample_fathers.push_back(XR.ind_fathers[idx_file][*it]);
 			sample_mothers.push_back(XR.ind_mothers[idx_file][*it]);
 			sample_pops.push_back(XR.ind_pops[idx_file][*it]);
+			subs_samples.push_back(*it);
 
             int32_t full_index = (mode == CONV_BCF_BG || mode == CONV_BCF_SG) ? *it : (*it) * 2;
             subs2full.push_back(full_index);
@@ -353,6 +484,9 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 
 	vrb.bullet("#samples to subsample = " + stb.str(sample_names.size()));
 
+	//Tiled input records: only the tiles of the kept samples are read
+	XR.setProjection(idx_file, subs_samples);
+
 	subsample_bit.allocate(2*nsamples_input);
 	for (auto i=0; i<subs2full.size(); ++i)
 	{
@@ -371,14 +505,22 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 		case CONV_BCF_BH: vrb.title("Converting from XCF to XCF [Binary/Haplotype]"); break;
 		case CONV_BCF_SG: vrb.title("Converting from XCF to XCF [Sparse/Genotype]"); break;
 		case CONV_BCF_SH: vrb.title("Converting from XCF to XCF [Sparse/Haplotype]"); break;
+		case CONV_BCF_AUTO: vrb.title("Converting from XCF to XCF [Auto]"); break;
 	}
 
 	if (region.empty()) vrb.bullet("Region        : All");
 	else vrb.bullet("Region        : " + stb.str(region));
 
-	if (mode == CONV_BCF_SG || mode == CONV_BCF_SH) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (mode == CONV_BCF_SG || mode == CONV_BCF_SH || mode == CONV_BCF_AUTO) vrb.bullet("Min MAF       : " + stb.str(minmaf));
+	if (sparse_vb) vrb.bullet("Sparse coding : [delta/varint]");
+	if (pbwt) vrb.bullet("Common coding : [PBWT runs]");
 
 	xcf_writer XW(foutput, false, nthreads);
+	if (bin_index) XW.setBinaryIndex();
+	if (async_write) XW.setAsync();
+	if (bin_compress) XW.setCompression();
+	if (pbwt) XW.setPBWT(2 * sample_names.size());
+	if (bin_tiles) XW.setTiling(bin_tiles);
 	bcf1_t* rec = XW.hts_record;
 
 	XW.writeHeader(XR, subs2full, std::string("XCFtools ") + std::string(XCFTLS_VERSION), !drop_info);
@@ -388,6 +530,8 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 	bitvector binary_bit_buf_subs;
 	binary_bit_buf_subs.allocate(2*sample_names.size());
 	std::vector<int32_t> sparse_int_buf_subs(2*sample_names.size());
+	record_selector selector (sample_names.size());
+	const ploidy_mask mask_subs = mask.subset(subs_samples);
 
 	uint32_t n_lines_rare = 0, n_lines_comm = 0;
 
@@ -395,8 +539,71 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 	{
 		const bool minor_full = (XR.getAF() < 0.5f);
 
+		//Haploid-aware records: decoded, subsampled and encoded again on the ploidy of the kept samples
+		const int32_t type_record = XR.typeRecord(idx_file);
+		if (type_record == RECORD_BINARY_MIXED || type_record == RECORD_SPARSE_MIXED)
+		{
+			const char * payload = NULL;
+			const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+			genotype_buf.resize(2 * nsamples_input);
+			if (type_record == RECORD_BINARY_MIXED) mask.decodeBinary(payload, genotype_buf.data());
+			else mask.decodeSparse(reinterpret_cast< const int32_t * > (payload), n_bytes / sizeof(int32_t), !minor_full, genotype_buf.data());
+			uint32_t ac = 0, an = 0;
+			for (uint32_t j = 0 ; j < subs_samples.size() ; j++)
+			{
+				for (uint32_t k = 0 ; k < 2 ; k++)
+				{
+					const int32_t g = genotype_buf[2*subs_samples[j]+k];
+					sparse_int_buf_subs[2*j+k] = g;
+					if (g == bcf_int32_vector_end || bcf_gt_is_missing(g)) continue;
+					an ++;
+					ac += (bcf_gt_allele(g) == 1);
+				}
+			}
+			const float af = an ? ac * 1.0f / an : 0.0f;
+			const bool rare = (std::min(af, 1.0f-af) < minmaf);
+			if (drop_info)
+				XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, ac, an);
+			else
+				XW.hts_record = XR.sync_lines[0];
+			if (mask_subs.mixed()) write_mixed(XW, mask_subs, sparse_int_buf_subs.data(), af < 0.5f, rare);
+			else write_diploid(XW, selector, sparse_int_buf_subs.data(), subs_samples.size(), af, rare);
+			n_lines_comm += !rare;
+			n_lines_rare += rare;
+			continue;
+		}
+
+		//Dosage records: decoded, subsampled and encoded again with the same precision and layout
+		if (type_record == RECORD_DENSE_DOSAGE || type_record == RECORD_SPARSE_DOSAGE)
+		{
+			const char * payload = NULL;
+			const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+			const bool sparse = (type_record == RECORD_SPARSE_DOSAGE);
+			dosages.resize(nsamples_input);
+			dosages_subs.resize(subs_samples.size());
+			dosage_codec::decode(payload, n_bytes, nsamples_input, sparse, dosages.data());
+			float sum = 0.0f;
+			uint32_t an = 0;
+			for (uint32_t j = 0 ; j < subs_samples.size() ; j++)
+			{
+				dosages_subs[j] = dosages[subs_samples[j]];
+				if (bcf_float_is_missing(dosages_subs[j])) continue;
+				sum += dosages_subs[j];
+				an += 2;
+			}
+			if (drop_info)
+				XW.writeInfo(XR.chr, XR.pos, XR.ref, XR.alt, XR.rsid, (uint32_t)lrintf(sum), an);
+			else
+				XW.hts_record = XR.sync_lines[0];
+			const uint32_t n_out = dosage_codec::encode(dosages_subs.data(), subs_samples.size(), (uint8_t)payload[0], sparse, (uint8_t)payload[1], dosage_buf);
+			XW.writeRecord(type_record, dosage_buf.data(), n_out);
+			n_lines_comm += !sparse;
+			n_lines_rare += sparse;
+			continue;
+		}
+
 		int32_t n_elements_full = parse_genotypes(XR,idx_file);
-		const int32_t type = XR.typeRecord(idx_file);
+		const int32_t type = helper_tools::plainType(XR.typeRecord(idx_file));
 		int32_t n_elements_subs = 0;
 		size_t ac = 0;
 
@@ -475,7 +682,13 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 			XW.hts_record = XR.sync_lines[0];
 
 		//Write record
-		if (mode == CONV_BCF_SG && rare)
+		if (mode == CONV_BCF_AUTO)
+		{
+			expand_genotypes(type, binary_bit_buf_subs.bytes, sparse_int_buf_subs.data(), n_elements_subs, sample_names.size(), !minor_full);
+			selector.select(genotype_buf.data(), af, rare);
+			XW.writeRecord(selector.type, selector.payload, selector.n_bytes);
+		}
+		else if (mode == CONV_BCF_SG && rare)
 		{
 			if (type==RECORD_SPARSE_GENOTYPE)//we don't handle conversion //TODO
 			{
@@ -505,7 +718,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 					}
 					n_elements_subs=i;
 				}
-				XW.writeRecord(RECORD_SPARSE_GENOTYPE, reinterpret_cast<char*>(sparse_int_buf_subs.data()), n_elements_subs * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_GENOTYPE, sparse_int_buf_subs.data(), n_elements_subs);
 			}
 			else if (type==RECORD_BINARY_GENOTYPE)
 			{
@@ -518,7 +731,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 			        if ((a0 && !a1) || a0 == minor || a1 == minor) //Binary to sparse. We use current minor.
 			        	sparse_int_buf_subs[n_elements_subs++] = sparse_genotype(i, (a0!=a1), (a0 && !a1), a0, a1, 0).get();//i;
 			    }
-				XW.writeRecord(RECORD_SPARSE_GENOTYPE, reinterpret_cast<char*>(sparse_int_buf_subs.data()), n_elements_subs * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_GENOTYPE, sparse_int_buf_subs.data(), n_elements_subs);
 			}
 			else vrb.error("Converting non-genotype type to genotype type!");
 		}
@@ -548,7 +761,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 					}
 					n_elements_subs=i;
 				}
-				XW.writeRecord(RECORD_SPARSE_HAPLOTYPE, reinterpret_cast<char*>(sparse_int_buf_subs.data()), n_elements_subs * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_HAPLOTYPE, sparse_int_buf_subs.data(), n_elements_subs);
 			}
 			else if (type==RECORD_BINARY_HAPLOTYPE)
 			{
@@ -560,7 +773,7 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 			        if (binary_bit_buf_subs.get(i) == minor)
 			        	sparse_int_buf_subs[n_elements_subs++]=i;
 			    }
-				XW.writeRecord(RECORD_SPARSE_HAPLOTYPE, reinterpret_cast<char*>(sparse_int_buf_subs.data()), n_elements_subs * sizeof(int32_t));
+				write_sparse(XW, RECORD_SPARSE_HAPLOTYPE, sparse_int_buf_subs.data(), n_elements_subs);
 			}
 			else vrb.error("Converting non-haplotype type to haplotype type!");
 		}
@@ -614,6 +827,9 @@ void binary2binary::convert(std::string finput, std::string foutput, const bool
 	}
 	if (mode == CONV_BCF_BG || mode == CONV_BCF_BH) vrb.bullet("Number of records processed: N=" + stb.str(n_lines_comm));
 	else vrb.bullet("Number of records processed: Nc=" + stb.str(n_lines_comm) + "/ Nr=" + stb.str(n_lines_rare));
+	vrb.bullet("Throughput: " + stb.str((n_lines_comm + n_lines_rare) * 1000.0 / std::max(1u, tac.rel_time()), 0) + " records/s");
+	if (mode == CONV_BCF_AUTO) selector.report();
+	XR.reportBinaryIO();
 
 	if (!drop_info) XW.hts_record = rec;
 
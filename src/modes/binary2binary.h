@@ -35,27 +35,52 @@
 #define CONV_BCF_BH	1
 #define CONV_BCF_SG	2
 #define CONV_BCF_SH	3
+#define CONV_BCF_SGV 5		//Sparse/Genotype with delta+varint coded records
+#define CONV_BCF_SHV 6		//Sparse/Haplotype with delta+varint coded records
+#define CONV_BCF_PB 7		//Sparse/Haplotype with common variants coded in PBWT order
+#define CONV_BCF_AUTO 8		//Smallest encoding chosen for each record
+
+class record_selector;
 
 class binary2binary {
 public:
 	//PARAM
 	bitvector binary_bit_buf;
 	std::vector<int32_t> sparse_int_buf;
+	std::vector<char> sparse_vb_buf;
+	std::vector<int32_t> genotype_buf;
+	std::vector<int32_t> mixed_sparse;
+	std::vector<char> mixed_bits;
+	ploidy_mask mask;
+	std::vector<float> dosages;
+	std::vector<float> dosages_subs;
+	std::vector<char> dosage_buf;
 
 	std::string region;
 	int nthreads;
 	int mode;
+	bool sparse_vb;
+	bool pbwt;
 	float minmaf;
 	bool drop_info;
+	int bin_io;
+	bool bin_index;
+	bool async_write;
+	bool bin_compress;
+	uint32_t bin_tiles;
 
 	//CONSTRUCTORS/DESCTRUCTORS
-	binary2binary(std::string, float, int, int, bool);
+	binary2binary(std::string, float, int, int, bool, int = BINIO_STREAM, bool = false, bool = false, bool = false, uint32_t = 0);
 	virtual ~binary2binary();
 
 	//PROCESS
 	void convert(std::string, std::string);
 	void convert(std::string, std::string, const bool exclude, const bool isforce, std::vector<std::string>& smpls);
 	int32_t parse_genotypes(xcf_reader& XR, const uint32_t idx_file);
+	void write_sparse(xcf_writer& XW, const int32_t type, const int32_t * buffer, const int32_t n_elements);
+	void write_mixed(xcf_writer& XW, const ploidy_mask& m, const int32_t * gt, const bool minor, const bool rare);
+	void write_diploid(xcf_writer& XW, record_selector& selector, const int32_t * gt, const uint32_t n, const float af, const bool rare);
+	void expand_genotypes(const int32_t type, const char * bits, const int32_t * sparse, const int32_t n_sparse, const uint32_t nsamples, const bool major);
 
 
 };
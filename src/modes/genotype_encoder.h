@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _GENOTYPE_ENCODER_H
+#define _GENOTYPE_ENCODER_H
+
+#include <utils/otools.h>
+#include <utils/xcf.h>
+#include <utils/sparse_genotype.h>
+
+//Encoders of diploid BCF genotypes [2 int32 per sample] into the payload of one record type. The type is a
+//template parameter so that it is dispatched once per record and the loop over samples carries no test on
+//it: values are computed with boolean arithmetic, sparse entries are always written and the output index
+//moves forward only when the sample is kept.
+//
+//Sparse genotypes are left without random phasing of unphased hets, so that the encoders draw no random
+//number and can run on any thread: sparse_genotype::phaseRandom has to be applied to the entries, in order,
+//before the payload is written [see genotype_encoder::phase].
+
+namespace genotype_encoder
+{
+	struct counts {
+		uint32_t n_sparse;					//Sparse entries written
+		uint32_t n_missing;					//Samples with a missing allele
+		uint32_t n_random;					//Sparse entries to be phased at random
+	};
+
+	//ALLELES OF SAMPLE [i]
+	struct alleles {
+		bool a0, a1, mi, phased;
+		alleles(const int32_t * gt, uint32_t i) {
+			const int32_t g0 = gt[2*i+0], g1 = gt[2*i+1];
+			a0 = (bcf_gt_allele(g0) == 1);
+			a1 = (bcf_gt_allele(g1) == 1);
+			mi = (g0 == bcf_gt_missing) | (g1 == bcf_gt_missing);
+			phased = (bcf_gt_is_phased(g0) | bcf_gt_is_phased(g1)) & !mi;
+		}
+	};
+
+	//ENCODE [n] SAMPLES AS A RECORD OF [TYPE] / [sparse] holds up to 2n entries, [bits] 2n bits
+	template < int32_t TYPE >
+	inline counts encode(const int32_t * gt, const float * probs, uint32_t n, bool minor, int32_t * sparse, float * sparse_probs, char * bits);
+
+	template < >
+	inline counts encode < RECORD_SPARSE_GENOTYPE > (const int32_t * gt, const float *, uint32_t n, bool minor, int32_t * sparse, float *, char *) {
+		counts c = { 0, 0, 0 };
+		for (uint32_t i = 0 ; i < n ; i++) {
+			const alleles A (gt, i);
+			const uint32_t v = sparse_genotype::pack(i, A.a0 != A.a1, A.mi, A.a0, A.a1, A.phased);
+			const bool keep = (A.a0 == minor) | (A.a1 == minor) | A.mi;
+			sparse[c.n_sparse] = v;
+			c.n_random += keep & sparse_genotype::random(v);
+			c.n_missing += A.mi;
+			c.n_sparse += keep;
+		}
+		return c;
+	}
+
+	template < >
+	inline counts encode < RECORD_SPARSE_PHASEPROBS > (const int32_t * gt, const float * probs, uint32_t n, bool minor, int32_t * sparse, float * sparse_probs, char *) {
+		counts c = { 0, 0, 0 };
+		for (uint32_t i = 0 ; i < n ; i++) {
+			const alleles A (gt, i);
+			const uint32_t v = sparse_genotype::pack(i, A.a0 != A.a1, A.mi, A.a0, A.a1, A.phased);
+			const bool keep = (A.a0 == minor) | (A.a1 == minor) | A.mi;
+			sparse[c.n_sparse] = v;
+			sparse_probs[c.n_sparse] = probs[i];
+			c.n_random += keep & sparse_genotype::random(v);
+			c.n_missing += A.mi;
+			c.n_sparse += keep;
+		}
+		return c;
+	}
+
+	template < >
+	inline counts encode < RECORD_SPARSE_HAPLOTYPE > (const int32_t * gt, const float *, uint32_t n, bool minor, int32_t * sparse, float *, char *) {
+		counts c = { 0, 0, 0 };
+		for (uint32_t i = 0 ; i < n ; i++) {
+			const alleles A (gt, i);
+			sparse[c.n_sparse] = 2*i+0;
+			c.n_sparse += (A.a0 == minor);
+			sparse[c.n_sparse] = 2*i+1;
+			c.n_sparse += (A.a1 == minor);
+			c.n_missing += A.mi;
+		}
+		return c;
+	}
+
+	//Binary records: sample i at bits 7-2(i%4) and 6-2(i%4) of byte i/4 [bitvector layout]
+	template < >
+	inline counts encode < RECORD_BINARY_HAPLOTYPE > (const int32_t * gt, const float *, uint32_t n, bool, int32_t *, float *, char * bits) {
+		counts c = { 0, 0, 0 };
+		memset(bits, 0, (2 * n + 7) / 8);
+		for (uint32_t i = 0 ; i < n ; i++) {
+			const alleles A (gt, i);
+			const uint32_t s = 6 - 2 * (i & 3);
+			bits[i >> 2] |= (char)((A.a0 << (s + 1)) | (A.a1 << s));
+			c.n_missing += A.mi;
+		}
+		return c;
+	}
+
+	//Missing: 10 / Homozygous: a0a1 / Heterozygous: 01
+	template < >
+	inline counts encode < RECORD_BINARY_GENOTYPE > (const int32_t * gt, const float *, uint32_t n, bool, int32_t *, float *, char * bits) {
+		counts c = { 0, 0, 0 };
+		memset(bits, 0, (2 * n + 7) / 8);
+		for (uint32_t i = 0 ; i < n ; i++) {
+			const alleles A (gt, i);
+			const uint32_t s = 6 - 2 * (i & 3);
+			const uint32_t hi = A.mi | (A.a0 & A.a1), lo = (!A.mi) & (A.a0 | A.a1);
+			bits[i >> 2] |= (char)((hi << (s + 1)) | (lo << s));
+			c.n_missing += A.mi;
+		}
+		return c;
+	}
+
+	//RANDOM PHASING OF THE SPARSE ENTRIES OF A RECORD, IN ORDER [same draws as sparse_genotype constructors]
+	inline void phase(int32_t * sparse, uint32_t n_sparse) {
+		for (uint32_t e = 0 ; e < n_sparse ; e ++) sparse[e] = sparse_genotype::phaseRandom(sparse[e]);
+	}
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <modes/record_selector.h>
+#include <utils/xcf.h>
+#include <utils/sparse_genotype.h>
+#include <modes/genotype_encoder.h>
+
+using namespace std;
+
+record_selector::record_selector(uint32_t _nsamples) : binary(2 * _nsamples) {
+	nsamples = _nsamples;
+	sparse.resize(2 * nsamples);
+	haplotypes = false;
+	n_sparse = n_random = 0;
+	type = RECORD_VOID;
+	payload = NULL;
+	n_bytes = 0;
+	n_types = vector < uint64_t > (RECORD_NUMBER_TYPES, 0);
+	n_bytes_written = n_bytes_threshold = n_bytes_binary = 0;
+}
+
+record_selector::~record_selector() {
+}
+
+//Choose the encoding of a record given as BCF genotypes [2 per sample]. The payload stays valid until the next call.
+int32_t record_selector::select(const int32_t * genotypes, float af, bool rare) {
+	prepare(genotypes, af);
+	return choose(rare);
+}
+
+//Build the sparse and binary versions of a record, without drawing random numbers [thread safe on its own
+//selector]. Returns the number of sparse genotypes that choose() will phase at random.
+uint32_t record_selector::prepare(const int32_t * genotypes, float af) {
+	const bool minor = (af < 0.5f);
+
+	//Can the record be held as haplotypes?
+	haplotypes = true;
+	for (uint32_t i = 0 ; i < nsamples && haplotypes ; i++) {
+		const bool mi = (genotypes[2*i+0] == bcf_gt_missing || genotypes[2*i+1] == bcf_gt_missing);
+		const bool het = (bcf_gt_allele(genotypes[2*i+0]) != bcf_gt_allele(genotypes[2*i+1]));
+		const bool phased = bcf_gt_is_phased(genotypes[2*i+0]) || bcf_gt_is_phased(genotypes[2*i+1]);
+		haplotypes = !mi && (phased || !het);
+	}
+
+	//Sparse and binary versions of the record
+	genotype_encoder::counts c;
+	if (haplotypes) {
+		c = genotype_encoder::encode < RECORD_SPARSE_HAPLOTYPE > (genotypes, NULL, nsamples, minor, sparse.data(), NULL, NULL);
+		genotype_encoder::encode < RECORD_BINARY_HAPLOTYPE > (genotypes, NULL, nsamples, minor, NULL, NULL, binary.bytes);
+	} else {
+		c = genotype_encoder::encode < RECORD_SPARSE_GENOTYPE > (genotypes, NULL, nsamples, minor, sparse.data(), NULL, NULL);
+		genotype_encoder::encode < RECORD_BINARY_GENOTYPE > (genotypes, NULL, nsamples, minor, NULL, NULL, binary.bytes);
+	}
+	n_sparse = c.n_sparse;
+	n_random = c.n_random;
+	return n_random;
+}
+
+//Pick the smallest version of the prepared record
+int32_t record_selector::choose(bool rare) {
+	//Random phasing of unphased hets, drawn in record order
+	if (n_random) genotype_encoder::phase(sparse.data(), n_sparse);
+	const uint32_t n_bytes_sparse = n_sparse * sizeof(int32_t);
+
+	//Best plain candidate
+	if (n_bytes_sparse < binary.n_bytes) {
+		type = haplotypes ? RECORD_SPARSE_HAPLOTYPE : RECORD_SPARSE_GENOTYPE;
+		payload = reinterpret_cast < char * > (sparse.data());
+		n_bytes = n_bytes_sparse;
+	} else {
+		type = haplotypes ? RECORD_BINARY_HAPLOTYPE : RECORD_BINARY_GENOTYPE;
+		payload = binary.bytes;
+		n_bytes = binary.n_bytes;
+	}
+
+	//Varint candidate, only coded when it can beat the plain one [at least 1 byte per value]
+	if (n_sparse + n_sparse / 4 + sizeof(uint32_t) < n_bytes / AUTO_SLACK) {
+		uint32_t n_bytes_coded = sparse_codec::encode(sparse.data(), n_sparse, coded);
+		if (n_bytes_coded * AUTO_SLACK < n_bytes) {
+			type = haplotypes ? RECORD_SPARSE_HAPLOTYPE_VB : RECORD_SPARSE_GENOTYPE_VB;
+			payload = coded.data();
+			n_bytes = n_bytes_coded;
+		}
+	}
+
+	//Summary
+	n_types[type] ++;
+	n_bytes_written += n_bytes;
+	n_bytes_binary += binary.n_bytes;
+	n_bytes_threshold += rare ? n_bytes_sparse : binary.n_bytes;
+	return type;
+}
+
+//Add the summary of another selector [records encoded on another thread]
+void record_selector::merge(const record_selector & other) {
+	for (uint32_t t = 0 ; t < n_types.size() ; t ++) n_types[t] += other.n_types[t];
+	n_bytes_written += other.n_bytes_written;
+	n_bytes_threshold += other.n_bytes_threshold;
+	n_bytes_binary += other.n_bytes_binary;
+}
+
+void record_selector::report() {
+	vrb.bullet("Auto encoding : [" + stb.str(n_types[RECORD_BINARY_GENOTYPE]) + " G, " +
+		stb.str(n_types[RECORD_BINARY_HAPLOTYPE]) + " H, " +
+		stb.str(n_types[RECORD_SPARSE_GENOTYPE]) + " SG, " +
+		stb.str(n_types[RECORD_SPARSE_HAPLOTYPE]) + " SH, " +
+		stb.str(n_types[RECORD_SPARSE_GENOTYPE_VB]) + " SGV, " +
+		stb.str(n_types[RECORD_SPARSE_HAPLOTYPE_VB]) + " SHV]");
+	vrb.bullet("Auto payload  : " + stb.str(n_bytes_written / 1048576.0, 2) + "Mb / " +
+		stb.str(n_bytes_threshold / 1048576.0, 2) + "Mb with the MAF threshold [saved " + stb.str((int64_t)n_bytes_threshold - (int64_t)n_bytes_written) + " bytes] / " +
+		stb.str(n_bytes_binary / 1048576.0, 2) + "Mb binary only");
+}
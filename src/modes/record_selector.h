@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#ifndef _RECORD_SELECTOR_H
+#define _RECORD_SELECTOR_H
+
+#define AUTO_SLACK	1.05f		//Varint coded records have to be 5% smaller than plain ones to be chosen
+
+#include <utils/otools.h>
+#include <utils/bitvector.h>
+
+//Picks the smallest encoding of each record among the ones able to hold it.
+//Fully phased records without missing data can be written as haplotypes [binary, sparse, sparse varint],
+//others as genotypes [binary, sparse, sparse varint]. Plain types are kept on near ties since they
+//decode faster.
+class record_selector {
+public:
+	uint32_t nsamples;
+	bitvector binary;
+	std::vector < int32_t > sparse;
+	std::vector < char > coded;
+
+	//Record versions [see prepare]
+	bool haplotypes;
+	uint32_t n_sparse;
+	uint32_t n_random;					//Sparse genotypes to be phased at random when chosen
+
+	//Chosen record
+	int32_t type;
+	char * payload;
+	uint32_t n_bytes;
+
+	//Summary
+	std::vector < uint64_t > n_types;
+	uint64_t n_bytes_written;
+	uint64_t n_bytes_threshold;			//Bytes with the fixed MAF threshold rule [sg/sh]
+	uint64_t n_bytes_binary;			//Bytes with binary records only [bg/bh]
+
+	//CONSTRUCTORS/DESCTRUCTORS
+	record_selector(uint32_t);
+	~record_selector();
+
+	//PROCESS
+	int32_t select(const int32_t * genotypes, float af, bool rare);
+	uint32_t prepare(const int32_t * genotypes, float af);
+	int32_t choose(bool rare);
+	void merge(const record_selector &);
+	void report();
+};
+
+#endif
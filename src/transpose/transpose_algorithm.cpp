@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <transpose/transpose_header.h>
+#include <modes/binary2bcf.h>
+
+using namespace std;
+
+void transpose::build() {
+	tac.clock();
+	vrb.title("Building sample-major companion file");
+
+	const int nthreads = options["threads"].as < int > ();
+	xcf_reader XR(nthreads);
+	XR.setBinaryIO(bin_io);
+	const int32_t idx_file = XR.addFile(finput);
+	if (XR.typeFile(idx_file) != FILE_BINARY) vrb.error("[" + finput + "] is not a XCF file");
+	const uint32_t nsamples = XR.ind_names[idx_file].size();
+	vrb.bullet("#samples = " + stb.str(nsamples));
+
+	//Records are decoded into BCF genotypes as in [xcftools view -O bcf]
+	binary2bcf decoder ("", nthreads, true, bin_io);
+	decoder.nsamples = nsamples;
+	decoder.mask.set(XR.ind_ploidy[idx_file]);
+
+	transposed_writer TW;
+	if (!TW.open(ftbin, XR.ind_ploidy[idx_file], block)) vrb.error("Cannot create companion file [" + ftbin + "]");
+
+	vector < int32_t > genotypes (2 * nsamples);
+	vector < float > probabilities (nsamples);
+	uint64_t n_void = 0;
+	while (XR.nextRecord()) {
+		const int32_t type = XR.typeRecord(idx_file);
+
+		//Lines without genotypes keep their slot, so that variants match the lines of the BCF file
+		if (!XR.hasRecord(idx_file) || type == RECORD_VOID || type == RECORD_DENSE_DOSAGE || type == RECORD_SPARSE_DOSAGE) {
+			TW.pushVoid();
+			n_void ++;
+			continue;
+		}
+
+		const char * payload = NULL;
+		const int32_t n_bytes = XR.viewRecord(idx_file, &payload);
+		decoder.decode(type, payload, n_bytes, XR.getAF(), genotypes.data(), probabilities.data(), XR.chr, XR.pos);
+		TW.push(genotypes.data());
+
+		if (TW.n_variants % 100000 == 0) vrb.bullet("Number of records processed: N=" + stb.str(TW.n_variants));
+	}
+	if (!TW.close()) vrb.error("Failed writing companion file [" + ftbin + "]");
+	XR.close();
+
+	vrb.bullet("Number of records processed: N=" + stb.str(TW.n_variants) + " [" + stb.str(n_void) + " without genotypes]");
+	vrb.bullet("Tiles: " + stb.str(TW.tile_offset.size()) + " [" + stb.str((TW.n_variants + block - 1) / block) + " variant blocks x " + stb.str(TW.n_hblocks) + " haplotype blocks]");
+	vrb.bullet("Timing: " + stb.str(tac.rel_time()*1.0/1000, 2) + "s");
+}
+
+void transpose::extract() {
+	tac.clock();
+	vrb.title("Extracting samples from companion file");
+
+	//Companion file
+	transposed_reader TR;
+	if (!TR.open(ftbin)) vrb.error("Cannot open companion file [" + ftbin + "], build it first with [xcftools transpose -i " + finput + "]");
+
+	//Variant information is taken from the BCF file, the binary file is not read
+	xcf_reader XR(options["threads"].as < int > ());
+	const int32_t idx_file = XR.addFile(finput);
+	if (XR.typeFile(idx_file) != FILE_BINARY) vrb.error("[" + finput + "] is not a XCF file");
+	if (XR.ind_names[idx_file].size() != TR.n_samples) vrb.error("Companion file [" + ftbin + "] does not match the samples of [" + finput + "]");
+
+	//Samples to extract
+	map < string, uint32_t > map_samples;
+	for (uint32_t i = 0 ; i < TR.n_samples ; i ++) map_samples[XR.ind_names[idx_file][i]] = i;
+	vector < string > names;
+	vector < uint32_t > indexes;
+	string buffer;
+	input_file fd_samples (options["extract"].as < string > ());
+	while (getline(fd_samples, buffer)) {
+		if (buffer.empty()) continue;
+		auto it = map_samples.find(buffer);
+		if (it == map_samples.end()) vrb.error("Sample [" + buffer + "] not found in [" + finput + "]");
+		names.push_back(buffer);
+		indexes.push_back(it->second);
+	}
+	if (names.empty()) vrb.error("No sample to extract");
+	vrb.bullet("#samples = " + stb.str(names.size()) + " / " + stb.str(TR.n_samples));
+
+	//Genotype streams, one per sample
+	vector < vector < int32_t > > genotypes (names.size());
+	for (uint32_t s = 0 ; s < names.size() ; s ++)
+		if (!TR.readSample(indexes[s], genotypes[s])) vrb.error("Failed reading sample [" + names[s] + "] in [" + ftbin + "]");
+	vrb.bullet("Genotypes read: " + stb.str(TR.n_variants) + " variants (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+
+	//Output
+	output_file fd (options["output"].as < string > ());
+	fd << "#CHROM\tPOS\tID\tREF\tALT";
+	for (uint32_t s = 0 ; s < names.size() ; s ++) fd << "\t" << names[s];
+	fd << endl;
+	uint64_t v = 0;
+	while (XR.nextRecord()) {
+		if (v >= TR.n_variants) vrb.error("Companion file [" + ftbin + "] has fewer variants than [" + finput + "]");
+		fd << XR.chr << "\t" << XR.pos << "\t" << XR.rsid << "\t" << XR.ref << "\t" << XR.alt;
+		for (uint32_t s = 0 ; s < names.size() ; s ++) {
+			const int32_t g0 = genotypes[s][2*v+0], g1 = genotypes[s][2*v+1];
+			fd << "\t";
+			if (bcf_gt_is_missing(g0)) fd << ".";
+			else fd << bcf_gt_allele(g0);
+			if (g1 == bcf_int32_vector_end) continue;
+			fd << (bcf_gt_is_phased(g1) ? "|" : "/");
+			if (bcf_gt_is_missing(g1)) fd << ".";
+			else fd << bcf_gt_allele(g1);
+		}
+		fd << endl;
+		v ++;
+	}
+	if (v != TR.n_variants) vrb.error("Companion file [" + ftbin + "] has more variants than [" + finput + "]");
+	fd.close();
+	XR.close();
+	TR.close();
+	vrb.bullet("Number of records written: N=" + stb.str(v));
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include "../../versions/versions.h"
+
+#include <transpose/transpose_header.h>
+
+using namespace std;
+
+void transpose::declare_options() {
+	bpo::options_description opt_base ("Basic options");
+	opt_base.add_options()
+			("help", "Produce help message")
+			("threads,T", bpo::value<int>()->default_value(1), "Number of threads used for BCF (de-)compression");
+
+	bpo::options_description opt_input ("Input files");
+	opt_input.add_options()
+			("input,i", bpo::value < std::string >(), "Input file in XCF format")
+			("tbin", bpo::value < std::string >(), "Sample-major companion file [default: input prefix with .tbin extension]");
+
+	bpo::options_description opt_par ("Parameters");
+	opt_par.add_options()
+			("block", bpo::value<int>()->default_value(TBIN_BLOCK), "Number of variants per tile [multiple of 64]")
+			("extract", bpo::value < std::string >(), "Text file with the samples to extract from the companion file, one per line")
+			("bin-io", bpo::value< std::string >()->default_value("stream"), "Access to the binary file when building [stream|mmap|prefetch|block[:Mb]|direct[:Mb]|uring]");
+
+	bpo::options_description opt_output ("Output files");
+	opt_output.add_options()
+			("output,o", bpo::value< std::string >(), "Output genotypes of the extracted samples as text [--extract only]")
+			("log", bpo::value< std::string >(), "Log file");
+
+	descriptions.add(opt_base).add(opt_input).add(opt_par).add(opt_output);
+}
+
+void transpose::parse_command_line(vector < string > & args) {
+	try {
+		bpo::store(bpo::command_line_parser(args).options(descriptions).run(), options);
+		bpo::notify(options);
+	} catch ( const boost::program_options::error& e ) { cerr << "Error parsing command line arguments: " << string(e.what()) << endl; exit(0); }
+
+	if (options.count("help")) { cout << descriptions << endl; exit(0); }
+
+	if (options.count("output") && options["output"].as < string > () == "-") vrb.set_silent();
+
+	if (options.count("log") && !vrb.open_log(options["log"].as < string > ()))
+		vrb.error("Impossible to create log file [" + options["log"].as < string > () +"]");
+
+	vrb.title("[XCFtools] Sample-major companion of XCF files");
+	vrb.bullet("Authors       : Olivier DELANEAU and Simone RUBINACCI");
+	vrb.bullet("Contact       : olivier.delaneau@gmail.com");
+	vrb.bullet("Version       : 0." + string(XCFTLS_VERSION) + " / commit = " + string(__COMMIT_ID__) + " / release = " + string (__COMMIT_DATE__));
+	vrb.bullet("Run date      : " + tac.date());
+}
+
+void transpose::check_options() {
+	if (!options.count("input"))
+		vrb.error("You must specify the input XCF file using --input");
+
+	if (options.count("extract") && !options.count("output"))
+		vrb.error("You must specify an output text file with --output when using --extract");
+
+	if (options.count("threads") && options["threads"].as < int > () < 1)
+		vrb.error("You must use at least 1 thread");
+
+	if (options["block"].as < int > () < 64 || options["block"].as < int > () % 64)
+		vrb.error("Number of variants per tile must be a positive multiple of 64");
+
+	finput = options["input"].as < std::string > ();
+	ftbin = options.count("tbin") ? options["tbin"].as < std::string > () : transposed_bin::filename(finput);
+	block = options["block"].as < int > ();
+	bin_io = binary_io::parse_mode(options["bin-io"].as < std::string > ());
+	if (bin_io < 0) vrb.error("Binary file access [" + options["bin-io"].as < std::string > () + "] unrecognized");
+}
+
+void transpose::verbose_files() {
+	vrb.title("Files:");
+	vrb.bullet("Input XCF      : [" + finput + "]");
+	vrb.bullet("Companion TBIN : [" + ftbin + "]");
+	if (options.count("extract")) vrb.bullet("Input SAMPLES  : [" + options["extract"].as < std::string > () + "]");
+	if (options.count("output")) vrb.bullet("Output TXT     : [" + options["output"].as < std::string > () + "]");
+	if (options.count("log")) vrb.bullet("Output LOG     : [" + options["log"].as < std::string > () + "]");
+}
+
+void transpose::verbose_options() {
+	vrb.title("Parameters: ");
+	if (options.count("extract")) vrb.bullet("Mode     : Extract samples");
+	else {
+		vrb.bullet("Mode     : Build companion file");
+		vrb.bullet("Block    : " + stb.str(block) + " variants x " + stb.str(TBIN_TILE_HAPS) + " haplotypes per tile");
+		vrb.bullet("Bin I/O  : " + binary_io::name_mode(bin_io));
+	}
+	vrb.bullet("Threads  : " + stb.str(options["threads"].as < int > ()) + " threads");
+}
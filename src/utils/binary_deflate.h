@@ -0,0 +1 @@
+../../common/src/utils/binary_deflate.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../common/src/utils/binary_index.h
\ No newline at end of file
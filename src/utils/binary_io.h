@@ -0,0 +1 @@
+../../common/src/utils/binary_io.h
\ No newline at end of file
@@ -88,6 +88,11 @@ public:
 		uint32_t idx_bit = idx % 8;
 		return (this->bytes[idx_byt] >> (7 - (idx_bit%8))) & 1;
 	}
+
+	//Same bit layout, read from raw bytes (e.g. a record view from xcf_reader)
+	static inline bool get(const char * bytes, uint32_t idx) {
+		return (bytes[idx / 8] >> (7 - (idx % 8))) & 1;
+	}
 };
 
 
@@ -0,0 +1 @@
+../../common/src/utils/dosage_codec.h
\ No newline at end of file
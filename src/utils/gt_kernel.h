@@ -0,0 +1 @@
+../../common/src/utils/gt_kernel.h
\ No newline at end of file
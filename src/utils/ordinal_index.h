@@ -0,0 +1 @@
+../../common/src/utils/ordinal_index.h
\ No newline at end of file
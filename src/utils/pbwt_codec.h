@@ -0,0 +1 @@
+../../common/src/utils/pbwt_codec.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../common/src/utils/phaseprob_codec.h
\ No newline at end of file
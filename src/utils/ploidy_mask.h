@@ -0,0 +1 @@
+../../common/src/utils/ploidy_mask.h
\ No newline at end of file
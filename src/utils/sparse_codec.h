@@ -0,0 +1 @@
+../../common/src/utils/sparse_codec.h
\ No newline at end of file
@@ -98,6 +98,24 @@ public:
 		return value;
 	}
 
+	//VALUE OF A SPARSE GENOTYPE WITHOUT RANDOM PHASING OF UNPHASED HETS [branch-free, no RNG draw]
+	static inline unsigned int pack(unsigned int _idx, bool _het, bool _mis, bool _al0, bool _al1, bool _pha) {
+		const unsigned int pha = _pha | (!_het & !_mis);
+		return (_idx << 5) | (_het << 4) | (_mis << 3) | (_al0 << 2) | (_al1 << 1) | pha;
+	}
+
+	//DOES THE VALUE NEED RANDOM PHASING? [unphased, alleles differ]
+	static inline bool random(unsigned int value) {
+		return !(value & 1U) && (((value >> 2) ^ (value >> 1)) & 1U);
+	}
+
+	//RANDOM PHASING OF A PACKED VALUE, DRAWS THE SAME COIN AS THE CONSTRUCTOR
+	static inline unsigned int phaseRandom(unsigned int value) {
+		if (!random(value)) return value;
+		value &= ~6U;
+		return value | (rng.flipCoin() ? 2U : 4U);
+	}
+
 	void set(unsigned int value) {
 		idx = (value >> 5);
 		het = GETBIT(value, 4);
@@ -0,0 +1 @@
+../../common/src/utils/tiled_block.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../common/src/utils/transposed_bin.h
\ No newline at end of file
@@ -33,10 +33,17 @@
 using namespace std;
 
 void viewer::view()
+{
+	if (nshards) view_shards();
+	else convert(region, foutput);
+}
+
+//CONVERT [_region] OF THE INPUT INTO [_foutput]
+void viewer::convert(string _region, string _foutput)
 {
 	if (isBCF(format) && !input_fmt_bcf)
 	{
-		binary2bcf (region, nthreads, drop_info).convert(finput, foutput);
+		binary2bcf (_region, nthreads, drop_info, bin_io, decode_thread, async_write).convert(finput, _foutput);
 		return;
 	}
 
@@ -46,16 +53,27 @@ void viewer::view()
     else if (format == "sg") conversion_type = CONV_BCF_SG;
     else if (format == "sh") conversion_type = CONV_BCF_SH;
     else if (format == "pp") conversion_type = CONV_BCF_PP;
+    else if (format == "pp16") conversion_type = CONV_BCF_PP16;
+    else if (format == "pp8") conversion_type = CONV_BCF_PP8;
+    else if (format == "sgv") conversion_type = CONV_BCF_SGV;
+    else if (format == "shv") conversion_type = CONV_BCF_SHV;
+    else if (format == "pb") conversion_type = CONV_BCF_PB;
+    else if (format == "auto") conversion_type = CONV_BCF_AUTO;
+    else if (format == "ds8") conversion_type = CONV_BCF_DS8;
+    else if (format == "ds16") conversion_type = CONV_BCF_DS16;
     else vrb.error("Output format [" + format + "] unrecognized");
 
+    if (!input_fmt_bcf && (conversion_type == CONV_BCF_DS8 || conversion_type == CONV_BCF_DS16))
+    	vrb.error("Dosage formats [ds8|ds16] require a BCF input with FORMAT/DS or FORMAT/GP");
+
     if (input_fmt_bcf)
-    	bcf2binary(region, maf, nthreads, conversion_type, drop_info).convert(finput, foutput);
+    	bcf2binary(_region, maf, nthreads, conversion_type, drop_info, bin_index, decode_thread, async_write, bin_compress, bin_tiles, encode_threads).convert(finput, _foutput);
     else
     {
     	if (subsample)
-    		binary2binary(region, maf, nthreads, conversion_type, drop_info).convert(finput, foutput, subsample_exclude, subsample_isforce, samples_to_keep);
+    		binary2binary(_region, maf, nthreads, conversion_type, drop_info, bin_io, bin_index, async_write, bin_compress, bin_tiles).convert(finput, _foutput, subsample_exclude, subsample_isforce, samples_to_keep);
     	else
-    		binary2binary(region, maf, nthreads, conversion_type, drop_info).convert(finput, foutput);
+    		binary2binary(_region, maf, nthreads, conversion_type, drop_info, bin_io, bin_index, async_write, bin_compress, bin_tiles).convert(finput, _foutput);
 
     }
 }
@@ -53,6 +53,14 @@ public:
 	std::vector<std::string> samples_to_keep;
 
 	uint32_t nthreads;
+	int32_t bin_io;
+	bool bin_index;
+	bool decode_thread;
+	int encode_threads;
+	bool async_write;
+	bool bin_compress;
+	uint32_t bin_tiles;
+	uint32_t nshards;
 
 
 	bool isBCF(std::string);
@@ -60,6 +68,13 @@ public:
 
 	//METHODS
 	void view();
+	void convert(std::string, std::string);
+
+	//SHARDS
+	void shard_regions(std::vector < std::string > &);
+	void view_shards();
+	void stitch_shards(const std::vector < std::string > &);
+	void stitch_fam(const std::vector < std::string > &);
 
 
 	//PARAMETERS
@@ -27,7 +27,7 @@
 
 using namespace std;
 
-viewer::viewer() : input_fmt_bcf(true), drop_info(true), maf(1.0f/32), subsample(false), subsample_exclude(false), subsample_isforce(false), nthreads(1) {
+viewer::viewer() : input_fmt_bcf(true), drop_info(true), maf(1.0f/32), subsample(false), subsample_exclude(false), subsample_isforce(false), nthreads(1), nshards(0) {
 }
 
 viewer::~viewer() {
@@ -49,5 +49,5 @@ bool viewer::isBCF(std::string format) {
 }
 
 bool viewer::isXCF(std::string format) {
-	return (format == "bh" || format == "bg" ||format == "sh" ||format == "sg" || format == "pp");
+	return (format == "bh" || format == "bg" ||format == "sh" ||format == "sg" || format == "pp" || format == "pp16" || format == "pp8" || format == "sgv" || format == "shv" || format == "pb" || format == "auto" || format == "ds8" || format == "ds16");
 }
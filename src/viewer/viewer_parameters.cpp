@@ -26,6 +26,7 @@
 #include "../../versions/versions.h"
 
 #include <viewer/viewer_header.h>
+#include <utils/binary_io.h>
 
 using namespace std;
 
@@ -43,13 +44,21 @@ void viewer::declare_options() {
 			("maf,m", bpo::value< float >()->default_value(0.001), "Threshold to distinguish rare variants from common ones")
 			("samples,s", bpo::value< string >(), "XCF2XCF only: comma separated list of samples to include (or exclude with \"^\" prefix)")
 			("samples-file,S", bpo::value< string >(), "XCF2XCF only: File of samples to include (or exclude with \"^\" prefix)")
-			("force-samples", "Only warn about unknown subset samples");
+			("force-samples", "Only warn about unknown subset samples")
+			("bin-io", bpo::value< string >()->default_value("stream"), "XCF input only: access to the binary file [stream|mmap|prefetch|block[:Mb]|direct[:Mb]|uring]")
+			("decode-thread", "Decode input records in a separate thread [BCF output or BCF input only]")
+			("encode-threads", bpo::value<int>()->default_value(0), "BCF input only: encode records with N worker threads between the reader and an ordered writer [0: single thread]")
+			("shards", bpo::value<int>()->default_value(0), "Split indexed input in regions converted by N concurrent processes, then stitched into the output [0: disabled]. Shard i seeds random phasing with --seed + i, so unphased hets may be phased differently than without --shards or with another N");
 
 	bpo::options_description opt_output ("Output files");
 	opt_output.add_options()
 			("output,o", bpo::value< string >()->default_value("-"), "Output file [- for stdout]")
-			("format,O", bpo::value< string >()->default_value("bcf"), "Output file format [pp|sg|sh|bg|bh|bcf]")
+			("format,O", bpo::value< string >()->default_value("bcf"), "Output file format [pp|pp16|pp8|sg|sh|sgv|shv|pb|auto|ds8|ds16|bg|bh|bcf, pp16/pp8: phase probabilities in 16/8 bits fixed point]")
 			("keep-info","Keep INFO field instead of creating a minimal BCF file")
+			("async-write","Write output records and binary payload from a dedicated I/O thread")
+			("bin-compress","XCF output only: compress the binary file in independent deflate blocks")
+			("bin-tiles", bpo::value< uint32_t >()->default_value(0), "XCF output only: store binary records in 2D tiled blocks of N haplotypes per tile [0: disabled]")
+			("bin-index","XCF output only: also write a .bin.idx sidecar with per-variant SEEK, AC and AN columns")
 			("log", bpo::value< string >(), "Output log file");
 
 	descriptions.add(opt_base).add(opt_input).add(opt_output);
@@ -128,6 +137,21 @@ void viewer::check_options() {
 	nthreads = options["threads"].as < int > ();
 	drop_info = !options.count("keep-info");
 	maf = options["maf"].as < float > ();
+	bin_index = options.count("bin-index");
+	decode_thread = options.count("decode-thread");
+	encode_threads = options["encode-threads"].as < int > ();
+	if (encode_threads < 0) vrb.error("Number of encoding threads [--encode-threads] should be positive");
+	async_write = options.count("async-write");
+	bin_compress = options.count("bin-compress");
+	bin_tiles = options["bin-tiles"].as < uint32_t > ();
+	if (bin_tiles % 8) vrb.error("Number of haplotypes per tile [--bin-tiles] must be a multiple of 8");
+	if (bin_tiles && (bin_compress || async_write || format == "pb")) vrb.error("Option --bin-tiles cannot be combined with --bin-compress, --async-write or PBWT coding");
+	if (options["shards"].as < int > () < 0) vrb.error("Number of shards [--shards] should be positive");
+	nshards = options["shards"].as < int > ();
+	if (nshards && finput == "-") vrb.error("Option --shards requires an indexed input file, not stdin");
+	if (nshards && bin_compress) vrb.error("Option --shards cannot be combined with --bin-compress [SEEK of compressed binary files cannot be shifted]");
+	bin_io = binary_io::parse_mode(options["bin-io"].as < string > ());
+	if (bin_io < 0) vrb.error("Binary file access [" + options["bin-io"].as < string > () + "] unrecognized");
 }
 
 void viewer::verbose_files() {
@@ -165,11 +189,19 @@ void viewer::verbose_options()
 	vrb.title("Parameters:");
 	std::array<std::string,2> no_yes = {"NO","YES"};
 	vrb.bullet("Keep INFO     : [" + no_yes[drop_info] + "]");
+	if (isXCF(format)) vrb.bullet("Bin index     : [" + no_yes[bin_index] + "]");
+	if (isXCF(format)) vrb.bullet("Bin compress  : [" + no_yes[bin_compress] + "]");
+	if (isXCF(format) && bin_tiles) vrb.bullet("Bin tiles     : [" + stb.str(bin_tiles) + " haplotypes]");
 	vrb.bullet("Seed          : [" + stb.str(options["seed"].as < int > ()) + "]");
 	vrb.bullet("Threads       : [" + stb.str(nthreads) + " threads]");
+	if (!input_fmt_bcf) vrb.bullet("Binary I/O    : [" + binary_io::name_mode(bin_io) + "]");
+	vrb.bullet("Decode thread : [" + no_yes[decode_thread] + "]");
+	if (input_fmt_bcf && encode_threads) vrb.bullet("Encode threads: [" + stb.str(encode_threads) + " threads]");
+	if (nshards) vrb.bullet("Shards        : [" + stb.str(nshards) + " processes]");
+	vrb.bullet("Async write   : [" + no_yes[async_write] + "]");
 
 	string format = options["format"].as < string > ();
-	if (format[0] == 's') vrb.bullet("MAF     : " + stb.str(maf));
+	if (format[0] == 's' || format == "pb" || format == "auto" || format[0] == 'd') vrb.bullet("MAF     : " + stb.str(maf));
 
     // Verbose output for samples and samples-file options
     if (!input_fmt_bcf && !isBCF(formatS)) {
@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright (C) 2023-2025 Simone Rubinacci
+ * Copyright (C) 2023-2025 Olivier Delaneau
+ *
+ * MIT Licence
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+
+#include <filesystem>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <htslib/tbx.h>
+
+#include <viewer/viewer_header.h>
+#include <utils/xcf.h>
+
+using namespace std;
+
+//SPLIT THE INPUT INTO SHARD REGIONS
+// Contigs get a number of shards proportional to their variants [ordinal index when available, index statistics
+// otherwise]. A whole contig is cut at the positions of variants i*count/n found by jumping to them with the
+// ordinal index, an interval of --region at checkpoints of the ordinal index, so that shards hold about the same
+// number of variants. Without ordinal index, contigs are cut in intervals of equal length. Regions act as targets
+// in xcf_reader, so each variant falls in exactly one shard.
+void viewer::shard_regions(vector < string > & regions) {
+	htsFile * fp = hts_open(finput.c_str(), "r");
+	if (!fp) vrb.error("Failed to open file: " + finput);
+	bcf_hdr_t * hdr = bcf_hdr_read(fp);
+	if (!hdr) vrb.error("Failed to parse header: " + finput);
+
+	//Regions given with --region [sorted as in the file]
+	vector < string > region_chr;
+	vector < uint64_t > region_beg, region_end;
+	if (!region.empty()) {
+		if (!helper_tools::parseRegions(region, region_chr, region_beg, region_end)) vrb.error("Malformed region [" + region + "], expected chr, chr:beg-end or a comma separated list of these");
+		for (string & chr : region_chr) if (bcf_hdr_name2id(hdr, chr.c_str()) < 0) vrb.error("Contig [" + chr + "] not found in [" + finput + "]");
+	}
+
+	//Variants per contig [contigs with records in the index]
+	ordinal_index oidx;
+	bool ordinal = oidx.load(finput);
+	hts_idx_t * idx = bcf_index_load(finput.c_str());
+	tbx_t * tbx = (idx == NULL) ? tbx_index_load(finput.c_str()) : NULL;
+	if (!idx && !tbx) vrb.error("Option --shards requires an indexed input [.csi or .tbi of " + finput + "]");
+	const int32_t n_contigs = hdr->n[BCF_DT_CTG];
+	vector < uint64_t > counts (n_contigs, 0);
+	int n_seqs = 0;
+	const char ** seqs = idx ? bcf_index_seqnames(idx, hdr, &n_seqs) : tbx_seqnames(tbx, &n_seqs);
+	for (int i = 0 ; i < n_seqs ; i ++) {
+		string chr = seqs[i];
+		int32_t c = bcf_hdr_name2id(hdr, seqs[i]);
+		if (c < 0) continue;
+		uint64_t mapped = 0, unmapped = 0;
+		if (ordinal) mapped = oidx.count(chr);
+		else if (hts_idx_get_stat(idx ? idx : tbx->idx, idx ? c : tbx_name2id(tbx, seqs[i]), &mapped, &unmapped) < 0) mapped = 1;	//No statistics, contig kept
+		counts[c] = mapped;
+	}
+	free(seqs);
+
+	//Intervals to shard [whole contigs without --region]
+	vector < tuple < int32_t, uint64_t, uint64_t > > targets;
+	if (region_chr.empty()) {
+		for (int32_t c = 0 ; c < n_contigs ; c ++) if (counts[c]) targets.emplace_back(c, 1, 0);
+	} else {
+		for (uint32_t r = 0 ; r < region_chr.size() ; r ++) {
+			int32_t c = bcf_hdr_name2id(hdr, region_chr[r].c_str());
+			if (counts[c]) targets.emplace_back(c, region_beg[r], region_end[r]);
+		}
+		sort(targets.begin(), targets.end());
+	}
+	uint64_t total = 0;
+	for (auto & t : targets) total += counts[get < 0 > (t)];
+
+	//Position of the k-th variant of a contig
+	auto variant_pos = [&] (const string & chr, uint64_t k) {
+		xcf_reader XR(1);
+		XR.addFile(finput);
+		XR.ord_index[0] = oidx;
+		XR.seekVariant(chr, k);
+		uint64_t p = XR.nextRecord() ? XR.pos : 0;
+		XR.close();
+		return p;
+	};
+
+	//Cut intervals into regions
+	for (auto & t : targets) {
+		int32_t c = get < 0 > (t);
+		string chr = hdr->id[BCF_DT_CTG][c].key;
+		uint64_t n = max(1.0, round(1.0 * nshards * counts[c] / total));
+		uint64_t beg = get < 1 > (t);
+		uint64_t region_end = get < 2 > (t);
+		uint64_t end = region_end ? region_end : hdr->id[BCF_DT_CTG][c].val->info[0];		//0 when the contig length is unknown
+
+		vector < uint64_t > cuts;
+		int32_t oc = ordinal ? oidx.contig(chr) : -1;
+		vector < uint64_t > candidates;
+		if (oc >= 0 && beg == 1 && !region_end) {
+			for (uint64_t i = 1 ; i < n ; i ++) if (uint64_t p = variant_pos(chr, i * oidx.counts[oc] / n)) cuts.push_back(p);
+		} else if (oc >= 0) {
+			for (uint32_t p : oidx.cp_pos[oc]) if (p > beg && (!end || p <= end)) candidates.push_back(p);
+			for (uint64_t i = 1 ; i < n && !candidates.empty() ; i ++) cuts.push_back(candidates[i * candidates.size() / n]);
+		} else if (end > beg) for (uint64_t i = 1 ; i < n ; i ++) cuts.push_back(beg + i * (end - beg + 1) / n);
+		cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+
+		//Last region left open when the end of the contig comes from the header
+		uint64_t start = beg;
+		for (uint64_t cut : cuts) if (cut > start) {
+			regions.push_back(chr + ":" + stb.str(start) + "-" + stb.str(cut - 1));
+			start = cut;
+		}
+		if (region_end) regions.push_back(chr + ":" + stb.str(start) + "-" + stb.str(region_end));
+		else if (start == 1) regions.push_back(chr);
+		else regions.push_back(chr + ":" + stb.str(start) + "-");
+	}
+
+	if (idx) hts_idx_destroy(idx);
+	if (tbx) tbx_destroy(tbx);
+	bcf_hdr_destroy(hdr);
+	hts_close(fp);
+	if (regions.empty()) vrb.error("No variant to convert in [" + finput + "]");
+}
+
+//CONVERT SHARDS IN CONCURRENT PROCESSES, THEN STITCH THEM
+// Processes keep the global state of the program [random number generator, verbose, exit on error] apart. Each
+// shard seeds its generator with --seed plus its rank and logs in a file next to its output.
+void viewer::view_shards() {
+	tac.clock();
+	vector < string > regions;
+	shard_regions(regions);
+
+	//Shard files next to the output
+	string prefix = (foutput == "-") ? ("xcftools_" + stb.str(getpid())) : helper_tools::get_name_from_vcf(foutput);
+	vector < string > files;
+	for (uint32_t s = 0 ; s < regions.size() ; s ++) files.push_back(prefix + ".shard" + stb.str(s) + ".bcf");
+
+	vrb.title("Sharded conversion:");
+	vrb.bullet("#shards = " + stb.str(regions.size()) + " / #processes = " + stb.str(min((uint32_t)regions.size(), nshards)));
+
+	//Process pool
+	const int seed = options["seed"].as < int > ();
+	vector < pid_t > pids (regions.size(), -1);
+	vector < int > status (regions.size(), 0);
+	uint32_t n_running = 0;
+	auto reap = [&] () {
+		int st = 0;
+		pid_t pid = wait(&st);
+		if (pid < 0) vrb.error("Lost track of shard processes");
+		for (uint32_t s = 0 ; s < pids.size() ; s ++) if (pids[s] == pid) status[s] = st;
+		n_running --;
+	};
+	cout.flush();
+	for (uint32_t s = 0 ; s < regions.size() ; s ++) {
+		if (n_running == nshards) reap();
+		pid_t pid = fork();
+		if (pid < 0) vrb.error("Cannot start the process of shard [" + regions[s] + "]");
+		if (pid == 0) {
+			vrb.set_silent();
+			vrb.close_log();
+			vrb.open_log(helper_tools::get_name_from_vcf(files[s]) + ".log");
+			rng.setSeed(seed + s);
+			convert(regions[s], files[s]);
+			exit(EXIT_SUCCESS);
+		}
+		pids[s] = pid;
+		n_running ++;
+	}
+	while (n_running) reap();
+	for (uint32_t s = 0 ; s < regions.size() ; s ++)
+		if (!WIFEXITED(status[s]) || WEXITSTATUS(status[s]) != EXIT_SUCCESS)
+			vrb.error("Conversion of shard [" + regions[s] + "] failed, see [" + helper_tools::get_name_from_vcf(files[s]) + ".log]");
+	vrb.bullet("Shards converted (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+
+	tac.clock();
+	stitch_shards(files);
+	for (uint32_t s = 0 ; s < files.size() ; s ++) {
+		string name = helper_tools::get_name_from_vcf(files[s]);
+		for (string f : { files[s], files[s] + ".csi", ordinal_index::filename(files[s]), name + ".bin", binary_index::filename(name + ".bin"), name + ".fam", name + ".log" })
+			filesystem::remove(f);
+	}
+	vrb.bullet("Shards stitched (" + stb.str(tac.rel_time()*1.0/1000, 2) + "s)");
+}
+
+//STITCH SHARDS INTO THE OUTPUT [as concat --naive]
+// Shards share the header of the input so records are copied as they are. XCF records get their SEEK shifted by
+// the size of the binary files before them.
+void viewer::stitch_shards(const vector < string > & files) {
+	const bool binary = isXCF(format);
+	xcf_writer XW(foutput, !binary, nthreads);
+	if (binary && bin_index) XW.setBinaryIndex();
+	uint64_t offset_seek = 0, n_records = 0;
+	int32_t * vSK = NULL, nSK = 0;
+
+	for (uint32_t s = 0 ; s < files.size() ; s ++) {
+		htsFile * fp = hts_open(files[s].c_str(), "r"); if (!fp) vrb.error("Failed to open: " + files[s]);
+		bcf_hdr_t * hdr = bcf_hdr_read(fp); if (!hdr) vrb.error("Failed to parse header: " + files[s]);
+		if (s == 0) {
+			XW.hts_hdr = bcf_hdr_dup(hdr);
+			XW.writeHeader_terminate();
+		}
+		bcf1_t * rec = bcf_init();
+		while (bcf_read(fp, hdr, rec) == 0) {
+			if (binary) {
+				bcf_unpack(rec, BCF_UN_INFO);
+				if (bcf_get_info_int32(hdr, rec, "SEEK", &vSK, &nSK) < 0) vrb.error("Could not find INFO/SEEK fields in [" + files[s] + "]");
+				if (nSK != 4) vrb.error("INFO/SEEK field should contain 4 numbers");
+				uint64_t bin_seek = vSK[1] * (uint64_t)MOD30BITS + vSK[2] + offset_seek;
+				vSK[1] = bin_seek / MOD30BITS;
+				vSK[2] = bin_seek % MOD30BITS;
+				bcf_update_info_int32(hdr, rec, "SEEK", vSK, 4);
+				if (XW.bin_index.isOpen()) XW.indexRecord(rec, vSK[0], bin_seek, vSK[3]);
+			}
+			XW.writeRecord(rec);
+			n_records ++;
+		}
+		bcf_destroy(rec);
+		bcf_hdr_destroy(hdr);
+		hts_close(fp);
+
+		//Binary payload, in full: tiled records point into blocks of the file
+		if (binary) {
+			string name = helper_tools::get_name_from_vcf(files[s]);
+			uint64_t bin_size = filesystem::file_size(name + ".bin");
+			if (bin_size) {
+				ifstream bin_ifile(name + ".bin", ios::in | ios::binary);
+				if (!bin_ifile.is_open()) vrb.error("Failed to open file: " + name + ".bin");
+				XW.bin_fds << bin_ifile.rdbuf();
+			}
+			offset_seek += bin_size;
+		}
+	}
+	free(vSK);
+	if (binary) {
+		XW.bin_fds.close();
+		stitch_fam(files);
+	}
+	XW.close();
+	vrb.bullet("#records = " + stb.str(n_records));
+}
+
+//MERGE THE PED FILES OF THE SHARDS
+// Shards only carry the ploidy column when they hold haploid-aware records [e.g. chrX, chrY or chrMT], so the
+// output takes its ploidy from these shards. Shards disagreeing on samples or ploidy cannot be stitched.
+void viewer::stitch_fam(const vector < string > & files) {
+	vector < string > samples, ploidy;
+	string ploidy_file = "";
+	for (uint32_t s = 0 ; s < files.size() ; s ++) {
+		string fname = helper_tools::get_name_from_vcf(files[s]) + ".fam";
+		ifstream fd (fname);
+		if (!fd.is_open()) vrb.error("Failed to open file: " + fname);
+		string buffer;
+		vector < string > tokens, shard_samples, shard_ploidy;
+		while (getline(fd, buffer)) {
+			if (helper_tools::split(buffer, tokens) < 4) vrb.error("Malformed line in [" + fname + "]");
+			shard_samples.push_back(tokens[0] + "\t" + tokens[1] + "\t" + tokens[2] + "\t" + tokens[3]);
+			if (tokens.size() > 4) shard_ploidy.push_back(tokens[4]);
+		}
+		fd.close();
+		if (!shard_ploidy.empty() && shard_ploidy.size() != shard_samples.size()) vrb.error("Incomplete ploidy column in [" + fname + "]");
+		if (s == 0) samples = shard_samples;
+		else if (shard_samples != samples) vrb.error("Samples in [" + fname + "] differ from the other shards");
+		if (shard_ploidy.empty()) continue;
+		if (ploidy.empty()) { ploidy = shard_ploidy; ploidy_file = fname; }
+		else if (shard_ploidy != ploidy) vrb.error("Ploidy in [" + fname + "] differs from [" + ploidy_file + "], convert these regions separately");
+	}
+
+	string ffname = helper_tools::get_name_from_vcf(foutput) + ".fam";
+	ofstream fd (ffname);
+	if (!fd.is_open()) vrb.error("Cannot open [" + ffname + "] for writing");
+	for (uint32_t i = 0 ; i < samples.size() ; i ++) {
+		fd << samples[i];
+		if (!ploidy.empty()) fd << "\t" << ploidy[i];
+		fd << endl;
+	}
+	fd.close();
+}
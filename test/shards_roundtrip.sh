@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+#Round-trip check of view --shards on a chr20 + chrX panel [haploid males on chrX]
+#Usage: test/shards_roundtrip.sh [xcftools binary], requires bcftools in PATH
+set -euo pipefail
+
+XCFTOOLS=$(realpath "${1:-bin/xcftools}")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cd "$TMP"
+
+#Panel: 20 samples, odd ones are males; 3000 variants on chr20, 2000 on chrX
+awk 'BEGIN {
+	srand(42); n = 20;
+	print "##fileformat=VCFv4.2";
+	print "##contig=<ID=chr20,length=64444167>";
+	print "##contig=<ID=chrX,length=156040895>";
+	print "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">";
+	printf "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+	for (i = 0 ; i < n ; i ++) printf "\tS%d", i;
+	printf "\n";
+	for (c = 0 ; c < 2 ; c ++) {
+		chr = c ? "chrX" : "chr20"; m = c ? 2000 : 3000; pos = 1000;
+		for (v = 0 ; v < m ; v ++) {
+			pos += 1 + int(rand() * 5000); af = (v % 10 == 0) ? 0.3 : 0.02;
+			printf "%s\t%d\t.\tA\tG\t.\tPASS\t.\tGT", chr, pos;
+			for (i = 0 ; i < n ; i ++) {
+				a0 = (rand() < af); a1 = (rand() < af);
+				if (c && i % 2) printf "\t%d", a0;
+				else printf "\t%d|%d", a0, a1;
+			}
+			printf "\n";
+		}
+	}
+}' > panel.vcf
+bcftools view -Ob -o panel.bcf panel.vcf
+bcftools index -f panel.bcf
+
+#Sharded and single process conversions
+"$XCFTOOLS" view -i panel.bcf -o sharded.bcf -O sg --shards 4 > sharded.out
+"$XCFTOOLS" view -i panel.bcf -o single.bcf -O sg -r chr20,chrX > single.out
+cmp sharded.fam single.fam || { echo "FAIL: sharded .fam differs from single process .fam"; exit 1; }
+[ "$(awk 'NR % 2 == 0 && $5 != 1' sharded.fam | wc -l)" -eq 0 ] || { echo "FAIL: males are not haploid in sharded.fam"; exit 1; }
+
+#Back to BCF, genotypes must match the panel
+bcftools query -f '%CHROM\t%POS[\t%GT]\n' panel.bcf > panel.txt
+for prefix in sharded single ; do
+	bcftools index -f $prefix.bcf
+	"$XCFTOOLS" view -i $prefix.bcf -o $prefix.back.bcf -O bcf -r chr20,chrX > $prefix.back.out
+	bcftools query -f '%CHROM\t%POS[\t%GT]\n' $prefix.back.bcf > $prefix.txt
+	cmp panel.txt $prefix.txt || { echo "FAIL: genotypes of $prefix.bcf differ from the panel"; exit 1; }
+done
+echo "PASS: shards round-trip"